@@ -0,0 +1,466 @@
+/**
+ * SIMD kernels of the compiled cascades.
+ *
+ * Author:  David Qiu.
+ * Email:   david@davidqiu.com
+ * Email:   dicong.qiu@intel.com
+ * Website: http://www.davidqiu.com/
+ *
+ * Copyright (C) 2014, David Qiu. All rights reserved.
+ */
+
+#include "CascadeSimd.hpp"
+#include "CompiledCascade.hpp"
+
+#include "opencv2/imgproc/imgproc.hpp"
+
+#include <algorithm>
+#include <cstring>
+
+#if defined(__x86_64__) || defined(__i386__)
+#define CASCADE_SIMD_X86 1
+#include <immintrin.h>
+#endif
+using namespace cv;
+using namespace std;
+
+
+/**
+ * @param src Row of the image.
+ * @param x First pixel of the row left.
+ * @param width Width of the image.
+ * @param s Sum of the row up to the pixel.
+ * @param sq Sum of squares of the row up to the pixel.
+ * @param prevSum Previous row of the integral image.
+ * @param sum Row of the integral image.
+ * @param prevSqsum Previous row of the squared integral image.
+ * @param sqsum Row of the squared integral image.
+ *
+ * @brief
+ *    Build the rest of a row of the integral images one pixel at a
+ *    time, as "cv::integral" does.
+ */
+static void integrateRowTail(const uchar* src, int x, int width, int s, double sq, const int* prevSum, int* sum, const double* prevSqsum, double* sqsum)
+{
+  for (; x<width; ++x)
+  {
+    int it = src[x];
+    s += it;
+    sq += (double)it * it;
+    sum[x + 1] = prevSum[x + 1] + s;
+    sqsum[x + 1] = prevSqsum[x + 1] + sq;
+  }
+}
+
+
+#ifdef CASCADE_SIMD_X86
+
+/**
+ * @brief
+ *    The integral kernels below sum the pixels of a block within the
+ *    vector and add the sum of the row before the block. The squared
+ *    sums are integers far below 2^53, so that they are exact in
+ *    double precision whatever the order of the additions.
+ */
+__attribute__((target("sse4.2")))
+static void integrateRowSSE42(const uchar* src, int width, const int* prevSum, int* sum, const double* prevSqsum, double* sqsum)
+{
+  __m128i s = _mm_setzero_si128();
+  __m128d sq = _mm_setzero_pd();
+  int x = 0;
+  for (; x+4<=width; x+=4)
+  {
+    int packed;
+    memcpy(&packed, src + x, sizeof(packed));
+    __m128i v = _mm_cvtepu8_epi32(_mm_cvtsi32_si128(packed));
+    __m128i v2 = _mm_mullo_epi32(v, v);
+    v = _mm_add_epi32(v, _mm_slli_si128(v, 4));
+    v = _mm_add_epi32(v, _mm_slli_si128(v, 8));
+    v2 = _mm_add_epi32(v2, _mm_slli_si128(v2, 4));
+    v2 = _mm_add_epi32(v2, _mm_slli_si128(v2, 8));
+
+    v = _mm_add_epi32(v, s);
+    _mm_storeu_si128((__m128i*)(sum + x + 1), _mm_add_epi32(v, _mm_loadu_si128((const __m128i*)(prevSum + x + 1))));
+    s = _mm_shuffle_epi32(v, 0xFF);
+
+    __m128d lo = _mm_add_pd(_mm_cvtepi32_pd(v2), sq);
+    __m128d hi = _mm_add_pd(_mm_cvtepi32_pd(_mm_unpackhi_epi64(v2, v2)), sq);
+    _mm_storeu_pd(sqsum + x + 1, _mm_add_pd(lo, _mm_loadu_pd(prevSqsum + x + 1)));
+    _mm_storeu_pd(sqsum + x + 3, _mm_add_pd(hi, _mm_loadu_pd(prevSqsum + x + 3)));
+    sq = _mm_unpackhi_pd(hi, hi);
+  }
+  integrateRowTail(src, x, width, _mm_cvtsi128_si32(s), _mm_cvtsd_f64(sq), prevSum, sum, prevSqsum, sqsum);
+}
+
+
+__attribute__((target("avx2")))
+static inline __m256i prefixSumAVX2(__m256i v)
+{
+  v = _mm256_add_epi32(v, _mm256_slli_si256(v, 4));
+  v = _mm256_add_epi32(v, _mm256_slli_si256(v, 8));
+  return _mm256_add_epi32(v, _mm256_shuffle_epi32(_mm256_permute2x128_si256(v, v, 0x08), 0xFF));
+}
+
+
+__attribute__((target("avx2")))
+static void integrateRowAVX2(const uchar* src, int width, const int* prevSum, int* sum, const double* prevSqsum, double* sqsum)
+{
+  const __m256i last = _mm256_set1_epi32(7);
+  __m256i s = _mm256_setzero_si256();
+  __m256d sq = _mm256_setzero_pd();
+  int x = 0;
+  for (; x+8<=width; x+=8)
+  {
+    __m256i v = _mm256_cvtepu8_epi32(_mm_loadl_epi64((const __m128i*)(src + x)));
+    __m256i v2 = prefixSumAVX2(_mm256_mullo_epi32(v, v));
+    v = _mm256_add_epi32(prefixSumAVX2(v), s);
+    _mm256_storeu_si256((__m256i*)(sum + x + 1), _mm256_add_epi32(v, _mm256_loadu_si256((const __m256i*)(prevSum + x + 1))));
+    s = _mm256_permutevar8x32_epi32(v, last);
+
+    __m256d lo = _mm256_add_pd(_mm256_cvtepi32_pd(_mm256_castsi256_si128(v2)), sq);
+    __m256d hi = _mm256_add_pd(_mm256_cvtepi32_pd(_mm256_extracti128_si256(v2, 1)), sq);
+    _mm256_storeu_pd(sqsum + x + 1, _mm256_add_pd(lo, _mm256_loadu_pd(prevSqsum + x + 1)));
+    _mm256_storeu_pd(sqsum + x + 5, _mm256_add_pd(hi, _mm256_loadu_pd(prevSqsum + x + 5)));
+    sq = _mm256_permute4x64_pd(hi, 0xFF);
+  }
+  integrateRowTail(src, x, width, _mm_cvtsi128_si32(_mm256_castsi256_si128(s)), _mm_cvtsd_f64(_mm256_castpd256_pd128(sq)),
+                   prevSum, sum, prevSqsum, sqsum);
+}
+
+
+__attribute__((target("avx512f")))
+static inline __m512i prefixSumAVX512(__m512i v)
+{
+  const __m512i zero = _mm512_setzero_si512();
+  v = _mm512_add_epi32(v, _mm512_alignr_epi32(v, zero, 15));
+  v = _mm512_add_epi32(v, _mm512_alignr_epi32(v, zero, 14));
+  v = _mm512_add_epi32(v, _mm512_alignr_epi32(v, zero, 12));
+  return _mm512_add_epi32(v, _mm512_alignr_epi32(v, zero, 8));
+}
+
+
+__attribute__((target("avx512f")))
+static void integrateRowAVX512(const uchar* src, int width, const int* prevSum, int* sum, const double* prevSqsum, double* sqsum)
+{
+  const __m512i last = _mm512_set1_epi32(15);
+  const __m512i lastPd = _mm512_set1_epi64(7);
+  __m512i s = _mm512_setzero_si512();
+  __m512d sq = _mm512_setzero_pd();
+  int x = 0;
+  for (; x+16<=width; x+=16)
+  {
+    __m512i v = _mm512_cvtepu8_epi32(_mm_loadu_si128((const __m128i*)(src + x)));
+    __m512i v2 = prefixSumAVX512(_mm512_mullo_epi32(v, v));
+    v = _mm512_add_epi32(prefixSumAVX512(v), s);
+    _mm512_storeu_si512(sum + x + 1, _mm512_add_epi32(v, _mm512_loadu_si512(prevSum + x + 1)));
+    s = _mm512_permutexvar_epi32(last, v);
+
+    __m512d lo = _mm512_add_pd(_mm512_cvtepi32_pd(_mm512_castsi512_si256(v2)), sq);
+    __m512d hi = _mm512_add_pd(_mm512_cvtepi32_pd(_mm512_extracti64x4_epi64(v2, 1)), sq);
+    _mm512_storeu_pd(sqsum + x + 1, _mm512_add_pd(lo, _mm512_loadu_pd(prevSqsum + x + 1)));
+    _mm512_storeu_pd(sqsum + x + 9, _mm512_add_pd(hi, _mm512_loadu_pd(prevSqsum + x + 9)));
+    sq = _mm512_permutexvar_pd(lastPd, hi);
+  }
+  integrateRowTail(src, x, width, _mm_cvtsi128_si32(_mm512_castsi512_si128(s)), _mm_cvtsd_f64(_mm512_castpd512_pd128(sq)),
+                   prevSum, sum, prevSqsum, sqsum);
+}
+
+#endif // CASCADE_SIMD_X86
+
+
+void computeCascadeIntegral(const Mat& gray, Mat& sum, Mat& sqsum, SimdLevel level)
+{
+  CV_Assert(gray.type() == CV_8UC1);
+  if (level == SIMD_NONE)
+  {
+    cv::integral(gray, sum, sqsum, CV_32S);
+    return;
+  }
+
+  // The first row and the first column are zeros
+  sum.create(gray.rows + 1, gray.cols + 1, CV_32S);
+  sqsum.create(gray.rows + 1, gray.cols + 1, CV_64F);
+  std::fill(sum.ptr<int>(0), sum.ptr<int>(0) + gray.cols + 1, 0);
+  std::fill(sqsum.ptr<double>(0), sqsum.ptr<double>(0) + gray.cols + 1, 0.0);
+
+  for (int y=0; y<gray.rows; ++y)
+  {
+    const uchar* src = gray.ptr<uchar>(y);
+    const int* prevSum = sum.ptr<int>(y);
+    int* rowSum = sum.ptr<int>(y + 1);
+    const double* prevSqsum = sqsum.ptr<double>(y);
+    double* rowSqsum = sqsum.ptr<double>(y + 1);
+    rowSum[0] = 0;
+    rowSqsum[0] = 0.0;
+    switch (level)
+    {
+#ifdef CASCADE_SIMD_X86
+      case SIMD_SSE42: integrateRowSSE42(src, gray.cols, prevSum, rowSum, prevSqsum, rowSqsum); break;
+      case SIMD_AVX2: integrateRowAVX2(src, gray.cols, prevSum, rowSum, prevSqsum, rowSqsum); break;
+      case SIMD_AVX512: integrateRowAVX512(src, gray.cols, prevSum, rowSum, prevSqsum, rowSqsum); break;
+#endif
+      default: integrateRowTail(src, 0, gray.cols, 0, 0.0, prevSum, rowSum, prevSqsum, rowSqsum); break;
+    }
+  }
+}
+
+
+#ifdef CASCADE_SIMD_X86
+
+/**
+ * @brief
+ *    The window kernels below evaluate the first stages over several
+ *    windows at once, one window per lane, with exactly the operations
+ *    of the unrolled evaluation: the rectangle sums in integers, the
+ *    products by the weights in single precision, the feature sums in
+ *    single or double precision as the kind of the stump requires, and
+ *    the stage sums in double precision. No operation is fused, so
+ *    that every lane rounds as the unrolled evaluation does.
+ */
+static inline int obtainWindowResult(int l, int rejectedFirst, int alive)
+{
+  if ((rejectedFirst >> l) & 1) return 0;
+  return ((alive >> l) & 1) ? 1 : -1;
+}
+
+
+__attribute__((target("sse4.2")))
+static inline __m128 sumRectsSSE42(const int* p, int x0, int x1, const int* o, float weight)
+{
+  __m128i sums = _mm_set_epi32(0, 0, sumCompiledRect(p + x1, o), sumCompiledRect(p + x0, o));
+  return _mm_mul_ps(_mm_cvtepi32_ps(sums), _mm_set1_ps(weight));
+}
+
+
+__attribute__((target("sse4.2")))
+static inline __m128d gatherSqsumSSE42(const double* pq, int x0, int x1, int offset)
+{
+  return _mm_set_pd(pq[x1 + offset], pq[x0 + offset]);
+}
+
+
+__attribute__((target("sse4.2")))
+static void evaluateRowSSE42(const CompiledCascade& cascade, const CascadeSimdRow& row, int numStages, int* results)
+{
+  const __m128d invArea = _mm_set1_pd(row.invWindowArea);
+  for (int j=0; j<row.count; j+=2)
+  {
+    int x0 = row.xs[j];
+    int x1 = row.xs[j + 1];
+
+    // Normalize the windows by their standard deviation
+    __m128d mean = _mm_mul_pd(_mm_set_pd(sumCompiledRect(row.sum + x1, row.normOffsets), sumCompiledRect(row.sum + x0, row.normOffsets)), invArea);
+    __m128d nf = _mm_sub_pd(gatherSqsumSSE42(row.sqsum, x0, x1, row.sqnormOffsets[0]), gatherSqsumSSE42(row.sqsum, x0, x1, row.sqnormOffsets[1]));
+    nf = _mm_add_pd(_mm_sub_pd(nf, gatherSqsumSSE42(row.sqsum, x0, x1, row.sqnormOffsets[2])), gatherSqsumSSE42(row.sqsum, x0, x1, row.sqnormOffsets[3]));
+    nf = _mm_sub_pd(_mm_mul_pd(nf, invArea), _mm_mul_pd(mean, mean));
+    nf = _mm_blendv_pd(_mm_set1_pd(1.), _mm_sqrt_pd(nf), _mm_cmpge_pd(nf, _mm_setzero_pd()));
+
+    // Evaluate the first stages
+    int alive = 3;
+    int rejectedFirst = 0;
+    const int* o = row.offsets;
+    const float* w = row.weights;
+    const CompiledHaarStump* stump = cascade.stumps;
+    for (int i=0; i<numStages && alive; ++i)
+    {
+      __m128d stageSum = _mm_setzero_pd();
+      for (int k=0; k<cascade.stages[i].count; ++k, ++stump, o+=COMPILED_FEATURE_OFFSETS, w+=COMPILED_FEATURE_WEIGHTS)
+      {
+        __m128 a = sumRectsSSE42(row.sum, x0, x1, o, w[0]);
+        __m128 b = sumRectsSSE42(row.sum, x0, x1, o + 4, w[1]);
+        __m128d sum;
+        if (stump->kind == COMPILED_STUMP_F2)
+        {
+          sum = _mm_cvtps_pd(_mm_add_ps(a, b));
+        }
+        else
+        {
+          sum = _mm_add_pd(_mm_cvtps_pd(a), _mm_cvtps_pd(b));
+          if (stump->kind == COMPILED_STUMP_D3) sum = _mm_add_pd(sum, _mm_cvtps_pd(sumRectsSSE42(row.sum, x0, x1, o + 8, w[2])));
+        }
+        __m128d t = _mm_mul_pd(_mm_set1_pd(stump->threshold), nf);
+        __m128d ge = _mm_cmpge_pd(sum, t);
+        stageSum = _mm_add_pd(stageSum, _mm_blendv_pd(_mm_set1_pd(stump->left), _mm_set1_pd(stump->right), ge));
+      }
+      int lt = _mm_movemask_pd(_mm_cmplt_pd(stageSum, _mm_set1_pd(cascade.stages[i].threshold)));
+      if (i == 0) rejectedFirst = lt & alive;
+      alive &= ~lt;
+    }
+
+    int lanes = std::min(2, row.count - j);
+    for (int l=0; l<lanes; ++l) results[j + l] = obtainWindowResult(l, rejectedFirst, alive);
+  }
+}
+
+
+__attribute__((target("avx2")))
+static inline __m128i sumRectsAVX2(const int* p, __m128i xs, const int* o)
+{
+  __m128i a = _mm_i32gather_epi32(p, _mm_add_epi32(xs, _mm_set1_epi32(o[0])), 4);
+  __m128i b = _mm_i32gather_epi32(p, _mm_add_epi32(xs, _mm_set1_epi32(o[1])), 4);
+  __m128i c = _mm_i32gather_epi32(p, _mm_add_epi32(xs, _mm_set1_epi32(o[2])), 4);
+  __m128i d = _mm_i32gather_epi32(p, _mm_add_epi32(xs, _mm_set1_epi32(o[3])), 4);
+  return _mm_add_epi32(_mm_sub_epi32(_mm_sub_epi32(a, b), c), d);
+}
+
+
+__attribute__((target("avx2")))
+static inline __m128 weightRectsAVX2(const int* p, __m128i xs, const int* o, float weight)
+{
+  return _mm_mul_ps(_mm_cvtepi32_ps(sumRectsAVX2(p, xs, o)), _mm_set1_ps(weight));
+}
+
+
+__attribute__((target("avx2")))
+static inline __m256d gatherSqsumAVX2(const double* pq, __m128i xs, int offset)
+{
+  return _mm256_i32gather_pd(pq, _mm_add_epi32(xs, _mm_set1_epi32(offset)), 8);
+}
+
+
+__attribute__((target("avx2")))
+static void evaluateRowAVX2(const CompiledCascade& cascade, const CascadeSimdRow& row, int numStages, int* results)
+{
+  const __m256d invArea = _mm256_set1_pd(row.invWindowArea);
+  for (int j=0; j<row.count; j+=4)
+  {
+    __m128i xs = _mm_loadu_si128((const __m128i*)(row.xs + j));
+
+    // Normalize the windows by their standard deviation
+    __m256d mean = _mm256_mul_pd(_mm256_cvtepi32_pd(sumRectsAVX2(row.sum, xs, row.normOffsets)), invArea);
+    __m256d nf = _mm256_sub_pd(gatherSqsumAVX2(row.sqsum, xs, row.sqnormOffsets[0]), gatherSqsumAVX2(row.sqsum, xs, row.sqnormOffsets[1]));
+    nf = _mm256_add_pd(_mm256_sub_pd(nf, gatherSqsumAVX2(row.sqsum, xs, row.sqnormOffsets[2])), gatherSqsumAVX2(row.sqsum, xs, row.sqnormOffsets[3]));
+    nf = _mm256_sub_pd(_mm256_mul_pd(nf, invArea), _mm256_mul_pd(mean, mean));
+    nf = _mm256_blendv_pd(_mm256_set1_pd(1.), _mm256_sqrt_pd(nf), _mm256_cmp_pd(nf, _mm256_setzero_pd(), _CMP_GE_OQ));
+
+    // Evaluate the first stages
+    int alive = 15;
+    int rejectedFirst = 0;
+    const int* o = row.offsets;
+    const float* w = row.weights;
+    const CompiledHaarStump* stump = cascade.stumps;
+    for (int i=0; i<numStages && alive; ++i)
+    {
+      __m256d stageSum = _mm256_setzero_pd();
+      for (int k=0; k<cascade.stages[i].count; ++k, ++stump, o+=COMPILED_FEATURE_OFFSETS, w+=COMPILED_FEATURE_WEIGHTS)
+      {
+        __m128 a = weightRectsAVX2(row.sum, xs, o, w[0]);
+        __m128 b = weightRectsAVX2(row.sum, xs, o + 4, w[1]);
+        __m256d sum;
+        if (stump->kind == COMPILED_STUMP_F2)
+        {
+          sum = _mm256_cvtps_pd(_mm_add_ps(a, b));
+        }
+        else
+        {
+          sum = _mm256_add_pd(_mm256_cvtps_pd(a), _mm256_cvtps_pd(b));
+          if (stump->kind == COMPILED_STUMP_D3) sum = _mm256_add_pd(sum, _mm256_cvtps_pd(weightRectsAVX2(row.sum, xs, o + 8, w[2])));
+        }
+        __m256d t = _mm256_mul_pd(_mm256_set1_pd(stump->threshold), nf);
+        __m256d ge = _mm256_cmp_pd(sum, t, _CMP_GE_OQ);
+        stageSum = _mm256_add_pd(stageSum, _mm256_blendv_pd(_mm256_set1_pd(stump->left), _mm256_set1_pd(stump->right), ge));
+      }
+      int lt = _mm256_movemask_pd(_mm256_cmp_pd(stageSum, _mm256_set1_pd(cascade.stages[i].threshold), _CMP_LT_OQ));
+      if (i == 0) rejectedFirst = lt & alive;
+      alive &= ~lt;
+    }
+
+    int lanes = std::min(4, row.count - j);
+    for (int l=0; l<lanes; ++l) results[j + l] = obtainWindowResult(l, rejectedFirst, alive);
+  }
+}
+
+
+__attribute__((target("avx512f")))
+static inline __m256i sumRectsAVX512(const int* p, __m256i xs, const int* o)
+{
+  __m256i a = _mm256_i32gather_epi32(p, _mm256_add_epi32(xs, _mm256_set1_epi32(o[0])), 4);
+  __m256i b = _mm256_i32gather_epi32(p, _mm256_add_epi32(xs, _mm256_set1_epi32(o[1])), 4);
+  __m256i c = _mm256_i32gather_epi32(p, _mm256_add_epi32(xs, _mm256_set1_epi32(o[2])), 4);
+  __m256i d = _mm256_i32gather_epi32(p, _mm256_add_epi32(xs, _mm256_set1_epi32(o[3])), 4);
+  return _mm256_add_epi32(_mm256_sub_epi32(_mm256_sub_epi32(a, b), c), d);
+}
+
+
+__attribute__((target("avx512f")))
+static inline __m256 weightRectsAVX512(const int* p, __m256i xs, const int* o, float weight)
+{
+  return _mm256_mul_ps(_mm256_cvtepi32_ps(sumRectsAVX512(p, xs, o)), _mm256_set1_ps(weight));
+}
+
+
+__attribute__((target("avx512f")))
+static inline __m512d gatherSqsumAVX512(const double* pq, __m256i xs, int offset)
+{
+  return _mm512_i32gather_pd(_mm256_add_epi32(xs, _mm256_set1_epi32(offset)), pq, 8);
+}
+
+
+__attribute__((target("avx512f")))
+static void evaluateRowAVX512(const CompiledCascade& cascade, const CascadeSimdRow& row, int numStages, int* results)
+{
+  const __m512d invArea = _mm512_set1_pd(row.invWindowArea);
+  for (int j=0; j<row.count; j+=8)
+  {
+    __m256i xs = _mm256_loadu_si256((const __m256i*)(row.xs + j));
+
+    // Normalize the windows by their standard deviation
+    __m512d mean = _mm512_mul_pd(_mm512_cvtepi32_pd(sumRectsAVX512(row.sum, xs, row.normOffsets)), invArea);
+    __m512d nf = _mm512_sub_pd(gatherSqsumAVX512(row.sqsum, xs, row.sqnormOffsets[0]), gatherSqsumAVX512(row.sqsum, xs, row.sqnormOffsets[1]));
+    nf = _mm512_add_pd(_mm512_sub_pd(nf, gatherSqsumAVX512(row.sqsum, xs, row.sqnormOffsets[2])), gatherSqsumAVX512(row.sqsum, xs, row.sqnormOffsets[3]));
+    nf = _mm512_sub_pd(_mm512_mul_pd(nf, invArea), _mm512_mul_pd(mean, mean));
+    nf = _mm512_mask_blend_pd(_mm512_cmp_pd_mask(nf, _mm512_setzero_pd(), _CMP_GE_OQ), _mm512_set1_pd(1.), _mm512_sqrt_pd(nf));
+
+    // Evaluate the first stages
+    int alive = 255;
+    int rejectedFirst = 0;
+    const int* o = row.offsets;
+    const float* w = row.weights;
+    const CompiledHaarStump* stump = cascade.stumps;
+    for (int i=0; i<numStages && alive; ++i)
+    {
+      __m512d stageSum = _mm512_setzero_pd();
+      for (int k=0; k<cascade.stages[i].count; ++k, ++stump, o+=COMPILED_FEATURE_OFFSETS, w+=COMPILED_FEATURE_WEIGHTS)
+      {
+        __m256 a = weightRectsAVX512(row.sum, xs, o, w[0]);
+        __m256 b = weightRectsAVX512(row.sum, xs, o + 4, w[1]);
+        __m512d sum;
+        if (stump->kind == COMPILED_STUMP_F2)
+        {
+          sum = _mm512_cvtps_pd(_mm256_add_ps(a, b));
+        }
+        else
+        {
+          sum = _mm512_add_pd(_mm512_cvtps_pd(a), _mm512_cvtps_pd(b));
+          if (stump->kind == COMPILED_STUMP_D3) sum = _mm512_add_pd(sum, _mm512_cvtps_pd(weightRectsAVX512(row.sum, xs, o + 8, w[2])));
+        }
+        __m512d t = _mm512_mul_pd(_mm512_set1_pd(stump->threshold), nf);
+        __mmask8 ge = _mm512_cmp_pd_mask(sum, t, _CMP_GE_OQ);
+        stageSum = _mm512_add_pd(stageSum, _mm512_mask_blend_pd(ge, _mm512_set1_pd(stump->left), _mm512_set1_pd(stump->right)));
+      }
+      int lt = (int)_mm512_cmp_pd_mask(stageSum, _mm512_set1_pd(cascade.stages[i].threshold), _CMP_LT_OQ);
+      if (i == 0) rejectedFirst = lt & alive;
+      alive &= ~lt;
+    }
+
+    int lanes = std::min(8, row.count - j);
+    for (int l=0; l<lanes; ++l) results[j + l] = obtainWindowResult(l, rejectedFirst, alive);
+  }
+}
+
+#endif // CASCADE_SIMD_X86
+
+
+void evaluateCascadeRow(const CompiledCascade& cascade, const CascadeSimdRow& row, SimdLevel level, int* results)
+{
+  int numStages = std::min(CASCADE_SIMD_STAGES, cascade.stageCount);
+  switch (level)
+  {
+#ifdef CASCADE_SIMD_X86
+    case SIMD_SSE42: evaluateRowSSE42(cascade, row, numStages, results); break;
+    case SIMD_AVX2: evaluateRowAVX2(cascade, row, numStages, results); break;
+    case SIMD_AVX512: evaluateRowAVX512(cascade, row, numStages, results); break;
+#endif
+    default: std::fill(results, results + row.count, 1); break;
+  }
+}
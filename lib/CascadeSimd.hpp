@@ -0,0 +1,91 @@
+/**
+ * SIMD kernels of the compiled cascades. The integral images are
+ * built and the first stages of a row of detection windows are
+ * evaluated with hand-vectorized kernels for SSE4.2, AVX2 and
+ * AVX-512, chosen at runtime from the instruction sets of the CPU.
+ * The kernels perform exactly the operations of the unrolled
+ * evaluation, lane by lane, so that the faces detected are the same.
+ *
+ * Author:  David Qiu.
+ * Email:   david@davidqiu.com
+ * Email:   dicong.qiu@intel.com
+ * Website: http://www.davidqiu.com/
+ *
+ * Copyright (C) 2014, David Qiu. All rights reserved.
+ */
+
+#ifndef FACEREC_CASCADE_SIMD_HPP
+#define FACEREC_CASCADE_SIMD_HPP
+
+#include "opencv2/core/core.hpp"
+
+#include "SimdLevel.hpp"
+
+
+struct CompiledCascade;
+
+
+/**
+ * @brief
+ *   Number of the first stages evaluated by the SIMD kernels. Most
+ *   windows are rejected by them, and the windows left are evaluated
+ *   one at a time.
+ */
+const int CASCADE_SIMD_STAGES = 2;
+
+
+/**
+ * @brief
+ *   Number of windows the kernels may read past the last window of a
+ *   row, which the positions of the windows must be padded with.
+ */
+const int CASCADE_SIMD_PADDING = 8;
+
+
+/**
+ * @brief
+ *   Row of detection windows at the same scale for the SIMD kernels.
+ */
+struct CascadeSimdRow
+{
+  const int* sum;           // Integral image at the row of the windows
+  const double* sqsum;      // Squared integral image at the row of the windows
+  const int* xs;            // Positions of the windows, padded with the last one
+  int count;                // Number of windows
+  const int* offsets;       // Offsets of the features at the scale
+  const float* weights;     // Weights of the features at the scale
+  int normOffsets[4];       // Offsets of the normalization window in the integral image
+  int sqnormOffsets[4];     // Offsets of the normalization window in the squared integral image
+  double invWindowArea;     // Inverse area of the normalization window
+};
+
+
+/**
+ * @param gray Image in grayscale.
+ * @param sum Variable to store the integral image, in "CV_32S".
+ * @param sqsum Variable to store the squared integral image, in "CV_64F".
+ * @param level SIMD kernels, which must be supported by the CPU.
+ *
+ * @brief
+ *    Build the integral images of an image, the same as
+ *    "cv::integral" does.
+ */
+void computeCascadeIntegral(const cv::Mat& gray, cv::Mat& sum, cv::Mat& sqsum, SimdLevel level);
+
+
+/**
+ * @param cascade Compiled cascade.
+ * @param row Row of detection windows.
+ * @param level SIMD kernels, which must be supported by the CPU.
+ * @param results Array to store, for each window, "0" if the first
+ *        stage rejects it, "-1" if another of the first stages rejects
+ *        it, and "1" if it passes the first stages.
+ *
+ * @brief
+ *    Evaluate the first "CASCADE_SIMD_STAGES" stages of a compiled
+ *    cascade over a row of windows, several windows at once.
+ */
+void evaluateCascadeRow(const CompiledCascade& cascade, const CascadeSimdRow& row, SimdLevel level, int* results);
+
+
+#endif // FACEREC_CASCADE_SIMD_HPP
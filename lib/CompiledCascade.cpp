@@ -0,0 +1,243 @@
+/**
+ * Compiled cascade.
+ *
+ * Author:  David Qiu.
+ * Email:   david@davidqiu.com
+ * Email:   dicong.qiu@intel.com
+ * Website: http://www.davidqiu.com/
+ *
+ * Copyright (C) 2014, David Qiu. All rights reserved.
+ */
+
+#include "CompiledCascade.hpp"
+#include "FaceDatabase.hpp"
+
+#include "opencv2/imgproc/imgproc.hpp"
+
+#include <algorithm>
+#include <cmath>
+using namespace cv;
+using namespace std;
+
+
+/**
+ * @brief
+ *   Epsilon of the grouping of the detections, the same as the
+ *   generic face detecter.
+ */
+const double COMPILED_GROUP_EPS = 0.2;
+
+
+uint64 hashHaarCascade(const CvHaarClassifierCascade* cascade)
+{
+  uint64 hash = hashFNV1a(&cascade->orig_window_size, sizeof(cascade->orig_window_size));
+  hash = hashFNV1a(&cascade->count, sizeof(cascade->count), hash);
+  for (int i=0; i<cascade->count; ++i)
+  {
+    const CvHaarStageClassifier& stage = cascade->stage_classifier[i];
+    hash = hashFNV1a(&stage.count, sizeof(stage.count), hash);
+    hash = hashFNV1a(&stage.threshold, sizeof(stage.threshold), hash);
+    hash = hashFNV1a(&stage.next, sizeof(stage.next), hash);
+    for (int j=0; j<stage.count; ++j)
+    {
+      const CvHaarClassifier& classifier = stage.classifier[j];
+      hash = hashFNV1a(&classifier.count, sizeof(classifier.count), hash);
+      hash = hashFNV1a(classifier.haar_feature, classifier.count * sizeof(classifier.haar_feature[0]), hash);
+      hash = hashFNV1a(classifier.threshold, classifier.count * sizeof(classifier.threshold[0]), hash);
+      hash = hashFNV1a(classifier.left, classifier.count * sizeof(classifier.left[0]), hash);
+      hash = hashFNV1a(classifier.right, classifier.count * sizeof(classifier.right[0]), hash);
+      hash = hashFNV1a(classifier.alpha, (classifier.count + 1) * sizeof(classifier.alpha[0]), hash);
+    }
+  }
+  return hash;
+}
+
+
+bool isCompilableHaarCascade(const CvHaarClassifierCascade* cascade)
+{
+  if (cascade == NULL || cascade->count <= 0) return false;
+  for (int i=0; i<cascade->count; ++i)
+  {
+    const CvHaarStageClassifier& stage = cascade->stage_classifier[i];
+    if (stage.next != -1) return false;
+    for (int j=0; j<stage.count; ++j)
+    {
+      const CvHaarClassifier& classifier = stage.classifier[j];
+      if (classifier.count != 1 || classifier.haar_feature[0].tilted) return false;
+    }
+  }
+  return true;
+}
+
+
+const CompiledCascade* findCompiledCascade(uint64 hash)
+{
+  for (int i=0; i<COMPILED_CASCADE_COUNT; ++i)
+  {
+    if (COMPILED_CASCADES[i]->hash == hash) return COMPILED_CASCADES[i];
+  }
+  return NULL;
+}
+
+
+/**
+ * @param cascade Compiled cascade.
+ * @param scale Scale of the detection window.
+ * @param sumStep Step of the integral image in elements.
+ * @param offsets Array to store the offsets of the features.
+ * @param weights Array to store the weights of the features.
+ *
+ * @brief
+ *    Scale the features of a compiled cascade to a detection window,
+ *    rounding the rectangles and normalizing the weights as the
+ *    generic face detecter does.
+ */
+static void scaleCompiledFeatures(const CompiledCascade& cascade, double scale, int sumStep, vector<int>& offsets, vector<float>& weights)
+{
+  int equWidth = cvRound((cascade.windowWidth - 2) * scale);
+  int equHeight = cvRound((cascade.windowHeight - 2) * scale);
+  double weightScale = 1. / (equWidth * equHeight);
+
+  offsets.assign(cascade.featureCount * COMPILED_FEATURE_OFFSETS, 0);
+  weights.assign(cascade.featureCount * COMPILED_FEATURE_WEIGHTS, 0.0f);
+  for (int f=0; f<cascade.featureCount; ++f)
+  {
+    const CompiledHaarFeature& feature = cascade.features[f];
+    int* o = &offsets[f * COMPILED_FEATURE_OFFSETS];
+    float* w = &weights[f * COMPILED_FEATURE_WEIGHTS];
+    double sum0 = 0, area0 = 0;
+    for (int k=0; k<3; ++k)
+    {
+      const CompiledHaarRect& r = feature.rects[k];
+      if (k == 2 && r.weight == 0.0f) break;
+
+      Rect tr;
+      tr.x = cvRound(r.x * scale);
+      tr.width = cvRound(r.width * scale);
+      tr.y = cvRound(r.y * scale);
+      tr.height = cvRound(r.height * scale);
+
+      o[k * 4 + 0] = tr.y * sumStep + tr.x;
+      o[k * 4 + 1] = tr.y * sumStep + tr.x + tr.width;
+      o[k * 4 + 2] = (tr.y + tr.height) * sumStep + tr.x;
+      o[k * 4 + 3] = (tr.y + tr.height) * sumStep + tr.x + tr.width;
+
+      w[k] = (float)(r.weight * weightScale);
+      if (k == 0) area0 = tr.width * tr.height;
+      else sum0 += w[k] * tr.width * tr.height;
+    }
+    w[0] = (float)(-sum0 / area0);
+  }
+}
+
+
+void detectCompiledCascade(const CompiledCascade& cascade, const Mat& gray, vector<Rect>& faces, double scaleFactor, int minNeighbors, Size minSize, Size maxSize, SimdLevel simd)
+{
+  faces.clear();
+  if (gray.empty()) return;
+  CV_Assert(gray.type() == CV_8UC1 && scaleFactor > 1.0);
+  if (maxSize.height == 0 || maxSize.width == 0) maxSize = gray.size();
+
+  // Compute the integral images of the image
+  Mat sum;
+  Mat sqsum;
+  computeCascadeIntegral(gray, sum, sqsum, simd);
+  int sumStep = (int)(sum.step / sizeof(int));
+  int sqsumStep = (int)(sqsum.step / sizeof(double));
+
+  // Count the pyramid levels as the generic face detecter does
+  int numFactors = 0;
+  for (double factor = 1; factor * cascade.windowWidth < gray.cols - 10 && factor * cascade.windowHeight < gray.rows - 10; factor *= scaleFactor)
+  {
+    numFactors++;
+  }
+
+  // Scan the windows of each pyramid level
+  vector<Rect> candidates;
+  vector<int> offsets;
+  vector<float> weights;
+  vector<int> xs;
+  vector<int> rowResults;
+  double factor = 1;
+  for (; numFactors-- > 0; factor *= scaleFactor)
+  {
+    double ystep = std::max(2., factor);
+    Size winSize(cvRound(cascade.windowWidth * factor), cvRound(cascade.windowHeight * factor));
+    if (winSize.width < minSize.width || winSize.height < minSize.height) continue;
+    if (winSize.width > maxSize.width || winSize.height > maxSize.height) break;
+
+    // Scale the features and the normalization window
+    scaleCompiledFeatures(cascade, factor, sumStep, offsets, weights);
+    int equX = cvRound(factor);
+    int equWidth = cvRound((cascade.windowWidth - 2) * factor);
+    int equHeight = cvRound((cascade.windowHeight - 2) * factor);
+    CascadeSimdRow row;
+    row.offsets = &offsets[0];
+    row.weights = &weights[0];
+    row.invWindowArea = 1. / (equWidth * equHeight);
+    row.normOffsets[0] = equX * sumStep + equX;
+    row.normOffsets[1] = equX * sumStep + equX + equWidth;
+    row.normOffsets[2] = (equX + equHeight) * sumStep + equX;
+    row.normOffsets[3] = (equX + equHeight) * sumStep + equX + equWidth;
+    row.sqnormOffsets[0] = equX * sqsumStep + equX;
+    row.sqnormOffsets[1] = equX * sqsumStep + equX + equWidth;
+    row.sqnormOffsets[2] = (equX + equHeight) * sqsumStep + equX;
+    row.sqnormOffsets[3] = (equX + equHeight) * sqsumStep + equX + equWidth;
+    const int* p0 = row.normOffsets;
+    const int* pq0 = row.sqnormOffsets;
+
+    // List the windows of a row which fit the image, padded with the 
+    // last one for the SIMD kernels
+    int endX = cvRound((gray.cols - winSize.width) / ystep);
+    int endY = cvRound((gray.rows - winSize.height) / ystep);
+    xs.clear();
+    for (int ix=0; ix<endX && cvRound(ix * ystep) + winSize.width < sum.cols; ++ix) xs.push_back(cvRound(ix * ystep));
+    if (xs.empty()) continue;
+    row.count = (int)xs.size();
+    xs.resize(row.count + CASCADE_SIMD_PADDING, xs.back());
+    row.xs = &xs[0];
+    rowResults.assign(row.count, 1);
+
+    for (int iy=0; iy<endY; ++iy)
+    {
+      int y = cvRound(iy * ystep);
+      if (y + winSize.height >= sum.rows) continue;
+
+      // Evaluate the first stages of the row at once
+      row.sum = sum.ptr<int>(y);
+      row.sqsum = sqsum.ptr<double>(y);
+      if (simd != SIMD_NONE) evaluateCascadeRow(cascade, row, simd, &rowResults[0]);
+
+      int ixstep = 1;
+      for (int ix=0; ix<row.count; ix+=ixstep)
+      {
+        int x = xs[ix];
+        int result = rowResults[ix];
+        if (result > 0)
+        {
+          // Normalize the window by its standard deviation
+          const int* p = row.sum + x;
+          const double* pq = row.sqsum + x;
+          double mean = (p[p0[0]] - p[p0[1]] - p[p0[2]] + p[p0[3]]) * row.invWindowArea;
+          double nf = pq[pq0[0]] - pq[pq0[1]] - pq[pq0[2]] + pq[pq0[3]];
+          nf = nf * row.invWindowArea - mean * mean;
+          nf = (nf >= 0.) ? std::sqrt(nf) : 1.;
+
+          result = cascade.evaluate(p, row.offsets, row.weights, nf);
+          if (result > 0) candidates.push_back(Rect(x, y, winSize.width, winSize.height));
+        }
+
+        // Skip the next window if the first stage rejects this one
+        ixstep = (result != 0) ? 1 : 2;
+      }
+    }
+  }
+
+  // Group the detections
+  faces.swap(candidates);
+  if (minNeighbors != 0)
+  {
+    vector<int> neighbors;
+    groupRectangles(faces, neighbors, std::max(minNeighbors, 1), COMPILED_GROUP_EPS);
+  }
+}
@@ -0,0 +1,270 @@
+/**
+ * Compiled cascade. A face detecter specialized for a single Haar
+ * cascade at build time, with the cascade turned into C++ source by
+ * "tools/CascadeCodegen.cpp": constant feature tables and an
+ * evaluation fully unrolled stage by stage, instead of the stages,
+ * trees and features walked through pointers by the generic face
+ * detecter.
+ *
+ * Author:  David Qiu.
+ * Email:   david@davidqiu.com
+ * Email:   dicong.qiu@intel.com
+ * Website: http://www.davidqiu.com/
+ *
+ * Copyright (C) 2014, David Qiu. All rights reserved.
+ */
+
+#ifndef FACEREC_COMPILED_CASCADE_HPP
+#define FACEREC_COMPILED_CASCADE_HPP
+
+#include "opencv2/core/core.hpp"
+#include "opencv2/core/core_c.h"
+#include "opencv2/objdetect/objdetect.hpp"
+
+#include "CascadeSimd.hpp"
+
+#include <vector>
+
+
+/**
+ * @brief
+ *   Rectangle of a Haar feature, in pixels of the detection window.
+ */
+struct CompiledHaarRect
+{
+  int x, y, width, height;  // Rectangle in the detection window
+  float weight;             // Weight of the rectangle sum
+};
+
+
+/**
+ * @brief
+ *   Haar feature of a compiled cascade. The third rectangle is unused
+ *   if its weight is "0".
+ */
+struct CompiledHaarFeature
+{
+  CompiledHaarRect rects[3];
+};
+
+
+/**
+ * @brief
+ *   Kinds of stump evaluations, matching the arithmetic of the generic 
+ *   face detecter.
+ */
+enum CompiledStumpKind
+{
+  COMPILED_STUMP_F2 = 0,    // Two rectangles summed in single precision
+  COMPILED_STUMP_D2 = 1,    // Two rectangles summed in double precision
+  COMPILED_STUMP_D3 = 2     // Three rectangles summed in double precision
+};
+
+
+/**
+ * @brief
+ *   Stump of a compiled cascade, on the feature of the same index.
+ */
+struct CompiledHaarStump
+{
+  float threshold;          // Threshold of the feature, relative to the standard deviation
+  float left;               // Value below the threshold
+  float right;              // Value at or above the threshold
+  int kind;                 // Kind of the evaluation, a CompiledStumpKind
+};
+
+
+/**
+ * @brief
+ *   Stage of a compiled cascade, with its stumps in sequence.
+ */
+struct CompiledHaarStage
+{
+  int count;                // Number of stumps
+  float threshold;          // Threshold of the stage sum, with the bias subtracted
+};
+
+
+/**
+ * @brief
+ *   Number of offsets per feature into the integral image, four
+ *   corners for each of the three rectangles.
+ */
+const int COMPILED_FEATURE_OFFSETS = 12;
+
+
+/**
+ * @brief
+ *   Number of weights per feature, one for each rectangle.
+ */
+const int COMPILED_FEATURE_WEIGHTS = 3;
+
+
+/**
+ * @param p Integral image at the top left corner of the window.
+ * @param o Offsets of the features from the corner at the current
+ *        scale, "COMPILED_FEATURE_OFFSETS" per feature.
+ * @param w Weights of the features at the current scale,
+ *        "COMPILED_FEATURE_WEIGHTS" per feature.
+ * @param nf Standard deviation of the window.
+ * @return "1" if the window passes all the stages, or minus the index
+ *         of the stage rejecting it.
+ *
+ * @brief
+ *    Unrolled evaluation of a compiled cascade at a window.
+ */
+typedef int (*CompiledCascadeEvaluator)(const int* p, const int* o, const float* w, double nf);
+
+
+/**
+ * @brief
+ *   Cascade compiled into the binary. The hash identifies the values
+ *   of the cascade it is generated from, so that it only replaces the
+ *   generic face detecter for exactly the same cascade.
+ */
+struct CompiledCascade
+{
+  const char* name;                     // Name of the cascade file
+  uint64 hash;                          // Hash of the cascade values
+  int windowWidth;                      // Width of the detection window
+  int windowHeight;                     // Height of the detection window
+  int featureCount;                     // Number of features
+  const CompiledHaarFeature* features;  // Features in evaluation order
+  const CompiledHaarStump* stumps;      // Stumps on the features
+  int stageCount;                       // Number of stages
+  const CompiledHaarStage* stages;      // Stages
+  CompiledCascadeEvaluator evaluate;    // Unrolled evaluation
+};
+
+
+/**
+ * @brief
+ *   Cascades compiled into the binary, generated at build time.
+ */
+extern const CompiledCascade* const COMPILED_CASCADES[];
+
+
+/**
+ * @brief
+ *   Number of cascades compiled into the binary.
+ */
+extern const int COMPILED_CASCADE_COUNT;
+
+
+/**
+ * @brief
+ *   Bias subtracted from the stage thresholds, as the generic face
+ *   detecter does.
+ */
+const float COMPILED_STAGE_THRESHOLD_BIAS = 0.0001f;
+
+
+/**
+ * @param p Integral image at the top left corner of the window.
+ * @param o Offsets of the corners of the rectangle.
+ * @return Sum of the pixels of the rectangle.
+ */
+inline int sumCompiledRect(const int* p, const int* o)
+{
+  return p[o[0]] - p[o[1]] - p[o[2]] + p[o[3]];
+}
+
+
+/**
+ * @brief
+ *    The stump evaluations below reproduce the arithmetic of the
+ *    generic face detecter exactly, including where it rounds to
+ *    single precision, so that the faces detected are the same. The
+ *    generic face detecter sums the two rectangles of the stages
+ *    with only two-rectangle features in single precision when it is
+ *    built with SSE2, and in double precision otherwise.
+ */
+inline double evaluateCompiledStumpF2(const int* p, const int* o, const float* w, double nf, float threshold, float left, float right)
+{
+  double t = threshold * nf;
+#if defined(__SSE2__) || defined(_M_X64)
+  double sum = (float)sumCompiledRect(p, o) * w[0] + (float)sumCompiledRect(p, o + 4) * w[1];
+#else
+  double sum = sumCompiledRect(p, o) * w[0];
+  sum += sumCompiledRect(p, o + 4) * w[1];
+#endif
+  return (sum >= t) ? right : left;
+}
+
+
+/**
+ * @brief
+ *    Two-rectangle stump in a stage with three-rectangle features.
+ */
+inline double evaluateCompiledStumpD2(const int* p, const int* o, const float* w, double nf, float threshold, float left, float right)
+{
+  double t = threshold * nf;
+  double sum = sumCompiledRect(p, o) * w[0];
+  sum += sumCompiledRect(p, o + 4) * w[1];
+  return (sum >= t) ? right : left;
+}
+
+
+/**
+ * @brief
+ *    Three-rectangle stump.
+ */
+inline double evaluateCompiledStumpD3(const int* p, const int* o, const float* w, double nf, float threshold, float left, float right)
+{
+  double t = threshold * nf;
+  double sum = sumCompiledRect(p, o) * w[0];
+  sum += sumCompiledRect(p, o + 4) * w[1];
+  sum += sumCompiledRect(p, o + 8) * w[2];
+  return (sum >= t) ? right : left;
+}
+
+
+/**
+ * @param cascade Cascade in the old Haar format.
+ * @return Hash of the values of the cascade.
+ *
+ * @brief
+ *    Hash the values of a cascade which determine the faces detected.
+ */
+uint64 hashHaarCascade(const CvHaarClassifierCascade* cascade);
+
+
+/**
+ * @param cascade Cascade in the old Haar format.
+ * @return True if the cascade can be compiled, which requires stumps
+ *         on upright features in a linear sequence of stages.
+ */
+bool isCompilableHaarCascade(const CvHaarClassifierCascade* cascade);
+
+
+/**
+ * @param hash Hash of the values of a cascade.
+ * @return The cascade compiled into the binary with the hash, or
+ *         NULL if there is none.
+ */
+const CompiledCascade* findCompiledCascade(uint64 hash);
+
+
+/**
+ * @param cascade Compiled cascade.
+ * @param gray Image in grayscale.
+ * @param faces Array to store the positions of the faces.
+ * @param scaleFactor Scale between the levels of the detection pyramid.
+ * @param minNeighbors Neighbor detections to keep a face, "0" for the
+ *        ungrouped detections.
+ * @param minSize Smallest face size, or empty for no bound.
+ * @param maxSize Largest face size, or empty for no bound.
+ * @param simd SIMD kernels to use, which must be supported by the CPU.
+ *
+ * @brief
+ *    Detect the faces with a compiled cascade, scanning the windows
+ *    and grouping the detections exactly as the generic face detecter
+ *    does with the same cascade. With SIMD kernels, the integral
+ *    images are built and the first stages of a row of windows are
+ *    evaluated several windows at once, before the windows left are
+ *    evaluated by the unrolled evaluation, and the faces are the same.
+ */
+void detectCompiledCascade(const CompiledCascade& cascade, const cv::Mat& gray, std::vector<cv::Rect>& faces, double scaleFactor, int minNeighbors, cv::Size minSize, cv::Size maxSize, SimdLevel simd = SIMD_NONE);
+
+
+#endif // FACEREC_COMPILED_CASCADE_HPP
@@ -0,0 +1,404 @@
+/**
+ * Face cascade.
+ *
+ * Author:  David Qiu.
+ * Email:   david@davidqiu.com
+ * Email:   dicong.qiu@intel.com
+ * Website: http://www.davidqiu.com/
+ *
+ * Copyright (C) 2014, David Qiu. All rights reserved.
+ */
+
+#include "FaceCascade.hpp"
+#include "FaceDatabase.hpp"
+
+#include <cstdio>
+#include <cstring>
+#include <fcntl.h>
+#include <stdint.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+using namespace cv;
+using namespace std;
+
+
+const char* const FACE_CASCADE_BINARY_SUFFIX = ".bin";
+
+
+/**
+ * @brief
+ *   Magic number, version and byte order mark of the binary cascade 
+ *   format.
+ */
+static const char FACE_CASCADE_MAGIC[8] = { 'F', 'A', 'C', 'E', 'C', 'A', 'S', 'C' };
+static const uint32_t FACE_CASCADE_VERSION = 2;
+static const uint32_t FACE_CASCADE_BYTE_ORDER = 0x01020304;
+
+
+/**
+ * @brief
+ *   Header of the binary cascade. It is followed by the stage table, 
+ *   the tree count of every tree, and the node block of every tree. 
+ *   A node block has the layout of the block OpenCV allocates for a 
+ *   tree of the old Haar format, so that it is loaded by a single 
+ *   copy: the features, the node thresholds, the left and right 
+ *   children of the nodes, and the leaf values.
+ */
+struct FaceCascadeHeader
+{
+  char magic[8];            // Magic number "FACECASC"
+  uint32_t version;         // Version of the binary cascade format
+  uint32_t headerSize;      // Size of this header in bytes
+  uint32_t byteOrder;       // Byte order mark, 0x01020304 in native order
+  int32_t windowWidth;      // Width of the detection window
+  int32_t windowHeight;     // Height of the detection window
+  int32_t stageCount;       // Number of stages
+  int32_t treeCount;        // Number of trees of all the stages
+  int32_t featureSize;      // Size of a feature in bytes
+  int64_t sourceSize;       // Size of the XML cascade precompiled
+  uint64_t sourceHash;      // FNV-1a hash of the content of the XML cascade precompiled
+  uint64_t stagesOffset;    // Offset of the stage table
+  uint64_t treesOffset;     // Offset of the tree counts
+  uint64_t nodesOffset;     // Offset of the node blocks
+  uint64_t fileSize;        // Size of the whole binary cascade file
+};
+
+
+/**
+ * @brief
+ *   Entry of the stage table of the binary cascade.
+ */
+struct FaceCascadeStage
+{
+  int32_t count;            // Number of trees of the stage
+  float threshold;          // Threshold of the stage
+  int32_t next;             // Index of the next stage
+  int32_t child;            // Index of the child stage
+  int32_t parent;           // Index of the parent stage
+};
+
+
+/**
+ * @param count Number of nodes of a tree.
+ * @return Size of the node block of the tree in bytes.
+ *
+ * @brief
+ *    Compute the size of the node block of a tree.
+ */
+static size_t computeNodeBlockSize(int count)
+{
+  return count * (sizeof(CvHaarFeature) + sizeof(float) + sizeof(int) + sizeof(int)) + (count + 1) * sizeof(float);
+}
+
+
+/**
+ * @param classifier Tree to point into its node block.
+ *
+ * @brief
+ *    Point the arrays of a tree into its node block, as OpenCV does 
+ *    for a tree read from an XML cascade.
+ */
+static void assignNodeBlock(CvHaarClassifier* classifier)
+{
+  classifier->threshold = (float*)(classifier->haar_feature + classifier->count);
+  classifier->left = (int*)(classifier->threshold + classifier->count);
+  classifier->right = (int*)(classifier->left + classifier->count);
+  classifier->alpha = (float*)(classifier->right + classifier->count);
+}
+
+
+FaceCascade::FaceCascade()
+  : _binary(false), 
+    _compiled(NULL)
+{
+}
+
+
+bool FaceCascade::load(const string& filename)
+{
+  // Load the precompiled binary cascade if it is up to date
+  if (loadBinary(filename + FACE_CASCADE_BINARY_SUFFIX, filename)) return true;
+
+  // Load the cascade itself, either binary or XML
+  if (loadBinary(filename, "")) return true;
+  return loadXML(filename);
+}
+
+
+bool FaceCascade::loadXML(const string& filename)
+{
+  _binary = false;
+  bool loaded = CascadeClassifier::load(filename);
+  findCompiled();
+  return loaded;
+}
+
+
+/**
+ * @param filename Path to the file.
+ * @param hash Variable to store the hash of the file content.
+ * @return True if the file is read, and false otherwise.
+ *
+ * @brief
+ *    Hash the content of an XML cascade, so that a binary cascade is 
+ *    only used with the exact XML cascade it is precompiled from, 
+ *    whatever the modification times.
+ */
+static bool hashSourceFile(const string& filename, uint64_t& hash)
+{
+  FILE* fp = fopen(filename.c_str(), "rb");
+  if (fp == NULL) return false;
+  hash = hashFNV1a(NULL, 0);
+  unsigned char chunk[65536];
+  size_t n;
+  while ((n = fread(chunk, 1, sizeof(chunk), fp)) > 0)
+  {
+    hash = hashFNV1a(chunk, n, hash);
+  }
+  bool success = !ferror(fp);
+  fclose(fp);
+  return success;
+}
+
+
+bool FaceCascade::loadBinary(const string& filename, const string& source)
+{
+  struct stat st;
+
+  // Open the binary cascade file
+  int fd = open(filename.c_str(), O_RDONLY);
+  if (fd < 0) return false;
+  if (fstat(fd, &st) == -1 || st.st_size < (off_t)sizeof(FaceCascadeHeader))
+  {
+    close(fd);
+    return false;
+  }
+
+  // Map the binary cascade file
+  size_t mapSize = (size_t)st.st_size;
+  void* mapAddr = mmap(NULL, mapSize, PROT_READ, MAP_PRIVATE, fd, 0);
+  close(fd);
+  if (mapAddr == MAP_FAILED) return false;
+  const unsigned char* base = (const unsigned char*)mapAddr;
+
+  // Validate the header
+  const FaceCascadeHeader* header = (const FaceCascadeHeader*)base;
+  bool valid = 
+    memcmp(header->magic, FACE_CASCADE_MAGIC, sizeof(FACE_CASCADE_MAGIC)) == 0 &&
+    header->version == FACE_CASCADE_VERSION &&
+    header->headerSize == sizeof(FaceCascadeHeader) &&
+    header->byteOrder == FACE_CASCADE_BYTE_ORDER &&
+    header->featureSize == (int32_t)sizeof(CvHaarFeature) &&
+    header->fileSize == (uint64_t)mapSize &&
+    header->stageCount > 0 && header->treeCount > 0 &&
+    header->stagesOffset + (uint64_t)header->stageCount * sizeof(FaceCascadeStage) <= mapSize &&
+    header->treesOffset + (uint64_t)header->treeCount * sizeof(int32_t) <= mapSize &&
+    header->nodesOffset <= mapSize;
+
+  // Check that the binary cascade is precompiled from the source
+  if (valid && !source.empty())
+  {
+    struct stat sourceSt;
+    uint64_t sourceHash;
+    valid = stat(source.c_str(), &sourceSt) == 0 &&
+            header->sourceSize == (int64_t)sourceSt.st_size &&
+            hashSourceFile(source, sourceHash) && header->sourceHash == sourceHash;
+  }
+
+  // Check that the stages and the trees fit the file
+  const FaceCascadeStage* stages = (const FaceCascadeStage*)(base + header->stagesOffset);
+  const int32_t* trees = (const int32_t*)(base + header->treesOffset);
+  if (valid)
+  {
+    int64_t treeCount = 0;
+    uint64_t nodesSize = 0;
+    for (int i=0; i<header->stageCount && valid; ++i)
+    {
+      valid = stages[i].count > 0 && treeCount + stages[i].count <= header->treeCount;
+      treeCount += stages[i].count;
+    }
+    for (int j=0; j<header->treeCount && valid; ++j)
+    {
+      valid = trees[j] > 0;
+      nodesSize += computeNodeBlockSize(trees[j]);
+    }
+    valid = valid && treeCount == header->treeCount && header->nodesOffset + nodesSize <= mapSize;
+  }
+  if (!valid)
+  {
+    munmap(mapAddr, mapSize);
+    return false;
+  }
+
+  // Build the cascade by copying the node blocks
+  CvHaarClassifierCascade* cascade = cvCreateHaarClassifierCascade(header->stageCount);
+  cascade->orig_window_size.width = header->windowWidth;
+  cascade->orig_window_size.height = header->windowHeight;
+  const unsigned char* nodePtr = base + header->nodesOffset;
+  int treeIndex = 0;
+  for (int i=0; i<header->stageCount; ++i)
+  {
+    CvHaarStageClassifier* stage = &cascade->stage_classifier[i];
+    stage->threshold = stages[i].threshold;
+    stage->next = stages[i].next;
+    stage->child = stages[i].child;
+    stage->parent = stages[i].parent;
+    stage->classifier = (CvHaarClassifier*)cvAlloc(stages[i].count * sizeof(CvHaarClassifier));
+    memset(stage->classifier, 0, stages[i].count * sizeof(CvHaarClassifier));
+    stage->count = stages[i].count;
+    for (int j=0; j<stage->count; ++j, ++treeIndex)
+    {
+      CvHaarClassifier* classifier = &stage->classifier[j];
+      size_t blockSize = computeNodeBlockSize(trees[treeIndex]);
+      classifier->count = trees[treeIndex];
+      classifier->haar_feature = (CvHaarFeature*)cvAlloc(blockSize);
+      memcpy(classifier->haar_feature, nodePtr, blockSize);
+      assignNodeBlock(classifier);
+      nodePtr += blockSize;
+    }
+  }
+  munmap(mapAddr, mapSize);
+
+  oldCascade = Ptr<CvHaarClassifierCascade>(cascade);
+  _binary = true;
+  findCompiled();
+  return true;
+}
+
+
+bool FaceCascade::saveBinary(const string& filename, const string& source) const
+{
+  // Only the cascades in the old Haar format can be precompiled
+  if (!isOldFormatCascade()) return false;
+  const CvHaarClassifierCascade* cascade = oldCascade;
+
+  // Collect the stage table and the tree counts
+  vector<FaceCascadeStage> stages(cascade->count);
+  vector<int32_t> trees;
+  uint64_t nodesSize = 0;
+  for (int i=0; i<cascade->count; ++i)
+  {
+    const CvHaarStageClassifier* stage = &cascade->stage_classifier[i];
+    stages[i].count = stage->count;
+    stages[i].threshold = stage->threshold;
+    stages[i].next = stage->next;
+    stages[i].child = stage->child;
+    stages[i].parent = stage->parent;
+    for (int j=0; j<stage->count; ++j)
+    {
+      trees.push_back(stage->classifier[j].count);
+      nodesSize += computeNodeBlockSize(stage->classifier[j].count);
+    }
+  }
+
+  // Obtain the size and the hash of the XML cascade
+  struct stat sourceSt;
+  uint64_t sourceHash;
+  if (stat(source.c_str(), &sourceSt) != 0 || !hashSourceFile(source, sourceHash)) return false;
+
+  // Prepare the header
+  FaceCascadeHeader header;
+  memset(&header, 0, sizeof(header));
+  memcpy(header.magic, FACE_CASCADE_MAGIC, sizeof(FACE_CASCADE_MAGIC));
+  header.version = FACE_CASCADE_VERSION;
+  header.headerSize = sizeof(FaceCascadeHeader);
+  header.byteOrder = FACE_CASCADE_BYTE_ORDER;
+  header.windowWidth = cascade->orig_window_size.width;
+  header.windowHeight = cascade->orig_window_size.height;
+  header.stageCount = cascade->count;
+  header.treeCount = (int32_t)trees.size();
+  header.featureSize = sizeof(CvHaarFeature);
+  header.sourceSize = (int64_t)sourceSt.st_size;
+  header.sourceHash = sourceHash;
+  header.stagesOffset = sizeof(FaceCascadeHeader);
+  header.treesOffset = header.stagesOffset + stages.size() * sizeof(FaceCascadeStage);
+  header.nodesOffset = header.treesOffset + trees.size() * sizeof(int32_t);
+  header.fileSize = header.nodesOffset + nodesSize;
+
+  // Write the binary cascade to a temporary file
+  string tmpFilename = format("%s.%d.tmp", filename.c_str(), (int)getpid());
+  FILE* fp = fopen(tmpFilename.c_str(), "wb");
+  if (fp == NULL) return false;
+  bool success = fwrite(&header, sizeof(header), 1, fp) == 1;
+  success = success && fwrite(&stages[0], sizeof(FaceCascadeStage), stages.size(), fp) == stages.size();
+  success = success && fwrite(&trees[0], sizeof(int32_t), trees.size(), fp) == trees.size();
+  for (int i=0; i<cascade->count && success; ++i)
+  {
+    const CvHaarStageClassifier* stage = &cascade->stage_classifier[i];
+    for (int j=0; j<stage->count && success; ++j)
+    {
+      const CvHaarClassifier* classifier = &stage->classifier[j];
+      int count = classifier->count;
+      success = fwrite(classifier->haar_feature, sizeof(CvHaarFeature), count, fp) == (size_t)count &&
+                fwrite(classifier->threshold, sizeof(float), count, fp) == (size_t)count &&
+                fwrite(classifier->left, sizeof(int), count, fp) == (size_t)count &&
+                fwrite(classifier->right, sizeof(int), count, fp) == (size_t)count &&
+                fwrite(classifier->alpha, sizeof(float), count + 1, fp) == (size_t)(count + 1);
+    }
+  }
+  success = (fclose(fp) == 0) && success;
+
+  // Replace the binary cascade
+  if (!success || rename(tmpFilename.c_str(), filename.c_str()) != 0)
+  {
+    remove(tmpFilename.c_str());
+    return false;
+  }
+
+  return true;
+}
+
+
+bool FaceCascade::isBinary() const
+{
+  return _binary;
+}
+
+
+Size FaceCascade::getWindowSize() const
+{
+  if (isOldFormatCascade())
+  {
+    const CvHaarClassifierCascade* cascade = oldCascade;
+    return Size(cascade->orig_window_size.width, cascade->orig_window_size.height);
+  }
+  return getOriginalWindowSize();
+}
+
+
+int FaceCascade::getFeatureType() const
+{
+  if (empty()) return -1;
+  if (isOldFormatCascade()) return FeatureEvaluator::HAAR;
+  return CascadeClassifier::getFeatureType();
+}
+
+
+const CvHaarClassifierCascade* FaceCascade::getHaarCascade() const
+{
+  if (!isOldFormatCascade()) return NULL;
+  return oldCascade;
+}
+
+
+const CompiledCascade* FaceCascade::getCompiledCascade() const
+{
+  return _compiled;
+}
+
+
+/**
+ * @brief
+ *    Find the cascade compiled into the binary from the same values as 
+ *    the cascade loaded.
+ */
+void FaceCascade::findCompiled()
+{
+  _compiled = NULL;
+  const CvHaarClassifierCascade* cascade = getHaarCascade();
+  if (cascade != NULL && isCompilableHaarCascade(cascade))
+  {
+    _compiled = findCompiledCascade(hashHaarCascade(cascade));
+  }
+}
@@ -0,0 +1,131 @@
+/**
+ * Face cascade. A face detecter which loads a precompiled binary 
+ * cascade by mapping it into memory, without parsing the XML cascade, 
+ * and falls back to the XML cascade when no up-to-date binary 
+ * cascade exists.
+ *
+ * Author:  David Qiu.
+ * Email:   david@davidqiu.com
+ * Email:   dicong.qiu@intel.com
+ * Website: http://www.davidqiu.com/
+ *
+ * Copyright (C) 2014, David Qiu. All rights reserved.
+ */
+
+#ifndef FACEREC_FACE_CASCADE_HPP
+#define FACEREC_FACE_CASCADE_HPP
+
+#include "opencv2/core/core.hpp"
+#include "opencv2/core/core_c.h"
+#include "opencv2/objdetect/objdetect.hpp"
+
+#include "CompiledCascade.hpp"
+
+#include <string>
+
+
+/**
+ * @brief
+ *   Suffix of the binary cascade precompiled from an XML cascade.
+ */
+extern const char* const FACE_CASCADE_BINARY_SUFFIX;
+
+
+/**
+ * @brief
+ *   Face detecter with precompiled binary cascades. Only the cascades 
+ *   in the old Haar format, such as "haarcascade_frontalface_alt.xml", 
+ *   can be precompiled, and the binary cascade holds exactly the 
+ *   values read from the XML cascade, so that the faces detected are 
+ *   the same. A cascade compiled into the binary from the same values 
+ *   is found on loading, whichever way the cascade is loaded.
+ */
+class FaceCascade : public cv::CascadeClassifier
+{
+public:
+  FaceCascade();
+
+  /**
+   * @param filename Path to the cascade.
+   * @return True if the cascade is loaded, and false otherwise.
+   *
+   * @brief
+   *    Load the binary cascade "<filename>.bin" if it is precompiled 
+   *    from the current cascade, or the cascade itself otherwise, 
+   *    which may be either a binary or an XML cascade.
+   */
+  bool load(const std::string& filename);
+
+  /**
+   * @param filename Path to the XML cascade.
+   * @return True if the cascade is loaded, and false otherwise.
+   *
+   * @brief
+   *    Load and parse an XML cascade, ignoring any binary cascade.
+   */
+  bool loadXML(const std::string& filename);
+
+  /**
+   * @param filename Path to the binary cascade.
+   * @param source Path to the XML cascade it must be precompiled 
+   *        from, or empty to accept any.
+   * @return True if the cascade is loaded, and false otherwise.
+   *
+   * @brief
+   *    Load a binary cascade by mapping it into memory.
+   */
+  bool loadBinary(const std::string& filename, const std::string& source);
+
+  /**
+   * @param filename Path to the binary cascade.
+   * @param source Path to the XML cascade loaded, whose size and 
+   *        content hash are recorded so that a binary cascade is not 
+   *        used once its XML cascade is modified.
+   * @return True if the binary cascade is written, and false if the 
+   *         cascade cannot be precompiled or written.
+   *
+   * @brief
+   *    Write the cascade loaded as a binary cascade.
+   */
+  bool saveBinary(const std::string& filename, const std::string& source) const;
+
+  /**
+   * @return True if the cascade is loaded from a binary cascade.
+   */
+  bool isBinary() const;
+
+  /**
+   * @return Size of the detection window of the cascade.
+   */
+  cv::Size getWindowSize() const;
+
+  /**
+   * @return Type of the features of the cascade, 
+   *         "cv::FeatureEvaluator::HAAR" for the cascades in both Haar 
+   *         formats, "cv::FeatureEvaluator::LBP" or 
+   *         "cv::FeatureEvaluator::HOG", or "-1" if no cascade is 
+   *         loaded.
+   */
+  int getFeatureType() const;
+
+  /**
+   * @return The cascade in the old Haar format, or NULL if the cascade 
+   *         is in the new format.
+   */
+  const CvHaarClassifierCascade* getHaarCascade() const;
+
+  /**
+   * @return The cascade compiled into the binary from the same values 
+   *         as the cascade loaded, or NULL if there is none.
+   */
+  const CompiledCascade* getCompiledCascade() const;
+
+private:
+  void findCompiled();
+
+  bool _binary;                       // Whether the cascade is loaded from a binary cascade
+  const CompiledCascade* _compiled;   // Compiled cascade of the same values
+};
+
+
+#endif // FACEREC_FACE_CASCADE_HPP
@@ -0,0 +1,853 @@
+/**
+ * Face database shared by the face recognition applications.
+ *
+ * Author:  David Qiu.
+ * Email:   david@davidqiu.com
+ * Email:   dicong.qiu@intel.com
+ * Website: http://www.davidqiu.com/
+ *
+ * Copyright (C) 2014, David Qiu. All rights reserved.
+ */
+
+#include "FaceDatabase.hpp"
+
+#include "opencv2/highgui/highgui.hpp"
+#include "opencv2/imgproc/imgproc.hpp"
+
+#include <iostream>
+#include <cstdio>
+#include <cstring>
+#include <dirent.h>
+#include <fcntl.h>
+#include <pthread.h>
+#include <stdint.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+using namespace cv;
+using namespace std;
+
+
+/**
+ * @brief
+ *   Magic number and version of the face snapshot file.
+ */
+static const char FACE_SNAPSHOT_MAGIC[8] = { 'F', 'A', 'C', 'E', 'S', 'N', 'A', 'P' };
+static const uint32_t FACE_SNAPSHOT_VERSION = 2;
+
+
+/**
+ * @brief
+ *   Header of the face snapshot file. The header is followed by 
+ *   the label array, the name table, the manifest and the pixel 
+ *   data, at the offsets recorded in the header. Each name table 
+ *   entry is an int32 label, a uint32 length and the name 
+ *   characters. Each manifest entry is the int64 size, the int64 
+ *   modification time and the uint64 content hash of the image 
+ *   file, a uint32 length and the characters of the image path. 
+ *   The pixel data holds the faces one after another, row by row, 
+ *   and starts at a 64-byte boundary. All the values are in the 
+ *   native byte order of the machine writing the snapshot.
+ */
+struct FaceSnapshotHeader
+{
+  char magic[8];            // Magic number "FACESNAP"
+  uint32_t version;         // Version of the snapshot format
+  uint32_t headerSize;      // Size of this header in bytes
+  char fingerprint[32];     // Fingerprint of the face database
+  int32_t count;            // Number of faces
+  int32_t rows;             // Number of rows of each face
+  int32_t cols;             // Number of columns of each face
+  int32_t nameCount;        // Number of entries in the name table
+  uint64_t labelsOffset;    // Offset of the label array
+  uint64_t namesOffset;     // Offset of the name table
+  uint64_t namesSize;       // Size of the name table in bytes
+  uint64_t recordsOffset;   // Offset of the manifest
+  uint64_t recordsSize;     // Size of the manifest in bytes
+  uint64_t pixelsOffset;    // Offset of the pixel data
+  uint64_t fileSize;        // Size of the whole snapshot file
+};
+
+
+/**
+ * @param offset An offset in bytes.
+ * @param alignment Alignment in bytes, a power of two.
+ * @return The offset rounded up to the alignment.
+ *
+ * @brief
+ *    Align an offset in the face snapshot file.
+ */
+static uint64_t alignOffset(uint64_t offset, uint64_t alignment)
+{
+  return (offset + alignment - 1) & ~(alignment - 1);
+}
+
+
+/**
+ * @param buffer Buffer to append to.
+ * @param value Value to append.
+ *
+ * @brief
+ *    Append a value to a serialized table of the face snapshot.
+ */
+template<typename T> static void appendBytes(vector<unsigned char>& buffer, const T& value)
+{
+  const unsigned char* bytes = (const unsigned char*)&value;
+  buffer.insert(buffer.end(), bytes, bytes + sizeof(T));
+}
+
+
+/**
+ * @param ptr Current position in a serialized table, advanced past 
+ *        the value read.
+ * @param end End of the serialized table.
+ * @param value Value to read.
+ * @return True if the value is read, and false if the table ends.
+ *
+ * @brief
+ *    Read a value from a serialized table of the face snapshot.
+ */
+template<typename T> static bool readBytes(const unsigned char*& ptr, const unsigned char* end, T& value)
+{
+  if (end - ptr < (ptrdiff_t)sizeof(T)) return false;
+  memcpy(&value, ptr, sizeof(T));
+  ptr += sizeof(T);
+  return true;
+}
+
+
+/**
+ * @param ptr Current position in a serialized table, advanced past 
+ *        the string read.
+ * @param end End of the serialized table.
+ * @param value String to read.
+ * @return True if the string is read, and false if the table ends.
+ *
+ * @brief
+ *    Read a length-prefixed string from a serialized table of the 
+ *    face snapshot.
+ */
+static bool readString(const unsigned char*& ptr, const unsigned char* end, string& value)
+{
+  uint32_t length;
+  if (!readBytes(ptr, end, length) || (uint64_t)(end - ptr) < length) return false;
+  value.assign((const char*)ptr, length);
+  ptr += length;
+  return true;
+}
+
+
+/**
+ * @brief
+ *   Memory shared by the face images of a snapshot. The reference 
+ *   count of the images is the first member, so that the memory is 
+ *   found from the reference count when the last image is released.
+ */
+struct FaceSnapshotMemory
+{
+  int refcount;             // Reference count of the images over the memory
+  void* addr;               // Start of the memory
+  size_t size;              // Size of the memory
+  bool mapped;              // True if the memory maps a snapshot file
+};
+
+
+/**
+ * @brief
+ *   Allocator of the face images of a snapshot, which unmaps the 
+ *   snapshot file when the last face image over it is released. An 
+ *   image created again through it is given a buffer of its own.
+ */
+class FaceSnapshotAllocator : public MatAllocator
+{
+public:
+  void allocate(int dims, const int* sizes, int type, int*& refcount, uchar*& datastart, uchar*& data, size_t* step)
+  {
+    // Lay out the image continuously
+    size_t total = CV_ELEM_SIZE(type);
+    for (int i=dims-1; i>=0; --i)
+    {
+      step[i] = total;
+      total *= sizes[i];
+    }
+
+    FaceSnapshotMemory* memory = new FaceSnapshotMemory;
+    memory->refcount = 1;
+    memory->addr = fastMalloc(total);
+    memory->size = total;
+    memory->mapped = false;
+    refcount = &memory->refcount;
+    datastart = data = (uchar*)memory->addr;
+  }
+
+  void deallocate(int* refcount, uchar* datastart, uchar* data)
+  {
+    FaceSnapshotMemory* memory = (FaceSnapshotMemory*)refcount;
+    if (memory->mapped) munmap(memory->addr, memory->size);
+    else fastFree(memory->addr);
+    delete memory;
+  }
+};
+
+static FaceSnapshotAllocator g_faceSnapshotAllocator;
+
+
+/**
+ * @param filename Path to the file.
+ * @param content Buffer to store the file content.
+ * @return True if the file is read, and false otherwise.
+ *
+ * @brief
+ *    Read the whole content of a file.
+ */
+static bool readFileContent(const string& filename, vector<uchar>& content)
+{
+  content.clear();
+  FILE* fp = fopen(filename.c_str(), "rb");
+  if (fp == NULL) return false;
+  unsigned char chunk[65536];
+  size_t n;
+  while ((n = fread(chunk, 1, sizeof(chunk), fp)) > 0)
+  {
+    content.insert(content.end(), chunk, chunk + n);
+  }
+  bool success = !ferror(fp);
+  fclose(fp);
+  return success;
+}
+
+
+int traverseDirectory(string dirpath, vector<string>& items, vector<DirectoryItemType>& types)
+{
+  DIR* dp;
+  struct dirent* dirp;
+  struct stat st;
+
+  // Clear the vectors
+  items.clear();
+  types.clear();
+
+  // Open dirent directory
+  if ((dp = opendir(dirpath.c_str())) == NULL)
+  {
+    cerr << "[ERROR] traverseDirectory(string, vector<string>&, vector<DirectoryItemType>&): " 
+         << "Cannot open the directory " << dirpath << "." << endl;
+    return -1;
+  }
+
+  // Read all files in this dir
+  while ((dirp = readdir(dp)) != NULL)
+  {
+    // Ignore hidden files
+    if (dirp->d_name[0] == '.') continue;
+
+    // Obtain the full name of the item
+    string fullname = dirpath + string("/") + string(dirp->d_name);
+
+    // Obtain the item status
+    if (stat(fullname.c_str(), &st) == -1)
+    {
+      cerr << "[ERROR] traverseDirectory(string, vector<string>&, vector<DirectoryItemType>&): " 
+           << "Cannot obtain the status of the item " << fullname << "." << endl;
+      closedir(dp);
+      return -1;
+    }
+
+    // Obtain the item type
+    DirectoryItemType itemType = DIRITEM_OTHER;
+    if (S_ISREG(st.st_mode)) itemType = DIRITEM_FILE;
+    if (S_ISDIR(st.st_mode)) itemType = DIRITEM_DIR;
+    
+    // Push to the vectors
+    items.push_back(dirp->d_name);
+    types.push_back(itemType);
+  }
+
+  // Close dirent directory
+  closedir(dp);
+
+  return 0;
+}
+
+
+uint64 hashFNV1a(const void* data, size_t size, uint64 hash)
+{
+  const unsigned char* bytes = (const unsigned char*)data;
+  for (size_t i=0; i<size; ++i)
+  {
+    hash ^= (uint64)bytes[i];
+    hash *= 1099511628211ULL;
+  }
+  return hash;
+}
+
+
+void scanFaceData(const string& datapath, vector<FaceFileRecord>& records, map<int, string>& names)
+{
+  vector<string> items_data;
+  vector<DirectoryItemType> types_data;
+  vector<string> items_face;
+  vector<DirectoryItemType> types_face;
+  struct stat st;
+
+  // Clear the result containers
+  records.clear();
+  names.clear();
+
+  // Obtain the face data path
+  string faceDataPath = datapath + "/faces";
+
+  // Traverse the data directory
+  if (traverseDirectory(faceDataPath, items_data, types_data) < 0)
+  {
+    string error_message = "Cannot read the face database directory " + faceDataPath + ".";
+    cerr << "[ERROR] scanFaceData(const string&, vector<FaceFileRecord>&, map<int, string>&): "
+         << error_message << endl;
+    CV_Error(CV_StsBadArg, error_message);
+  }
+
+  // Traverse each face directory
+  for (int i=0; i<items_data.size(); ++i)
+  {
+    // Check if the current item is a directory
+    if ( !(types_data[i]==DIRITEM_DIR) ) continue;
+
+    // Obtain the face image directory path
+    string faceImagePath = faceDataPath + "/" + items_data[i];
+
+    // Traverse the face image directory
+    if (traverseDirectory(faceImagePath, items_face, types_face) < 0)
+    {
+      string error_message = "Cannot read the face image directory " + faceImagePath + ".";
+      cerr << "[ERROR] scanFaceData(const string&, vector<FaceFileRecord>&, map<int, string>&): "
+           << error_message << endl;
+      CV_Error(CV_StsBadArg, error_message);
+    }
+
+    // Push the record of each face image
+    for (int j=0; j<items_face.size(); ++j)
+    {
+      // Check if the current item is a normal file
+      if ( !(types_face[j]==DIRITEM_FILE) ) continue;
+
+      // Obtain the image status
+      string imagePath = faceImagePath + "/" + items_face[j];
+      if (stat(imagePath.c_str(), &st) == -1)
+      {
+        string error_message = "Cannot obtain the status of the face image " + imagePath + ".";
+        cerr << "[ERROR] scanFaceData(const string&, vector<FaceFileRecord>&, map<int, string>&): "
+             << error_message << endl;
+        CV_Error(CV_StsBadArg, error_message);
+      }
+
+      // Push to the result containers
+      FaceFileRecord record;
+      record.path = items_data[i] + "/" + items_face[j];
+      record.label = i;
+      record.size = (int64)st.st_size;
+      record.mtime = (int64)st.st_mtime;
+      record.hash = 0;
+      records.push_back(record);
+      names.insert( pair<int, string>(i, items_data[i]) );
+    }
+  }
+}
+
+
+string computeFaceDataFingerprint(const vector<FaceFileRecord>& records)
+{
+  uint64 hash = hashFNV1a(NULL, 0);
+  for (int i=0; i<records.size(); ++i)
+  {
+    const FaceFileRecord& record = records[i];
+    hash = hashFNV1a(record.path.c_str(), record.path.size() + 1, hash);
+    hash = hashFNV1a(&record.label, sizeof(record.label), hash);
+    hash = hashFNV1a(&record.size, sizeof(record.size), hash);
+    hash = hashFNV1a(&record.mtime, sizeof(record.mtime), hash);
+  }
+  return format("%016llx", (unsigned long long)hash);
+}
+
+
+string computeFaceDataFingerprint(const string& datapath)
+{
+  vector<FaceFileRecord> records;
+  map<int, string> names;
+  scanFaceData(datapath, records, names);
+  return computeFaceDataFingerprint(records);
+}
+
+
+bool loadFaceSnapshot(const string& filename, string& fingerprint, vector<Mat>& images, vector<int>& labels, map<int, string>& names, vector<FaceFileRecord>& records)
+{
+  struct stat st;
+
+  // Clear the result containers
+  fingerprint.clear();
+  images.clear();
+  labels.clear();
+  names.clear();
+  records.clear();
+
+  // Open the snapshot file
+  int fd = open(filename.c_str(), O_RDONLY);
+  if (fd < 0) return false;
+  if (fstat(fd, &st) == -1 || st.st_size < (off_t)sizeof(FaceSnapshotHeader))
+  {
+    close(fd);
+    return false;
+  }
+
+  // Map the snapshot file read-only, so that the faces are never 
+  // written through to the file
+  size_t mapSize = (size_t)st.st_size;
+  void* mapAddr = mmap(NULL, mapSize, PROT_READ, MAP_PRIVATE, fd, 0);
+  close(fd);
+  if (mapAddr == MAP_FAILED) return false;
+  unsigned char* base = (unsigned char*)mapAddr;
+
+  // Validate the header
+  const FaceSnapshotHeader* header = (const FaceSnapshotHeader*)base;
+  bool valid = 
+    memcmp(header->magic, FACE_SNAPSHOT_MAGIC, sizeof(FACE_SNAPSHOT_MAGIC)) == 0 &&
+    header->version == FACE_SNAPSHOT_VERSION &&
+    header->headerSize == sizeof(FaceSnapshotHeader) &&
+    header->fileSize == (uint64_t)mapSize &&
+    header->count > 0 && header->rows > 0 && header->cols > 0 && header->nameCount >= 0 &&
+    header->labelsOffset + (uint64_t)header->count * sizeof(int32_t) <= mapSize &&
+    header->namesOffset + header->namesSize <= mapSize &&
+    header->recordsOffset + header->recordsSize <= mapSize &&
+    header->pixelsOffset + (uint64_t)header->count * header->rows * header->cols <= mapSize;
+  if (!valid)
+  {
+    munmap(mapAddr, mapSize);
+    return false;
+  }
+
+  // Read the name table
+  const unsigned char* namePtr = base + header->namesOffset;
+  const unsigned char* nameEnd = namePtr + header->namesSize;
+  for (int i=0; i<header->nameCount; ++i)
+  {
+    int32_t label;
+    string name;
+    if (!readBytes(namePtr, nameEnd, label) || !readString(namePtr, nameEnd, name)) break;
+    names.insert( pair<int, string>(label, name) );
+  }
+
+  // Read the manifest
+  const unsigned char* recordPtr = base + header->recordsOffset;
+  const unsigned char* recordEnd = recordPtr + header->recordsSize;
+  const int32_t* labelPtr = (const int32_t*)(base + header->labelsOffset);
+  records.resize(header->count);
+  for (int i=0; i<header->count; ++i)
+  {
+    int64_t size, mtime;
+    uint64_t hash;
+    if (!readBytes(recordPtr, recordEnd, size) || !readBytes(recordPtr, recordEnd, mtime) ||
+        !readBytes(recordPtr, recordEnd, hash) || !readString(recordPtr, recordEnd, records[i].path))
+    {
+      records.clear();
+      break;
+    }
+    records[i].label = labelPtr[i];
+    records[i].size = size;
+    records[i].mtime = mtime;
+    records[i].hash = hash;
+  }
+  if (names.size() != (size_t)header->nameCount || records.size() != (size_t)header->count)
+  {
+    names.clear();
+    records.clear();
+    munmap(mapAddr, mapSize);
+    return false;
+  }
+
+  // Build the face images over the mapped pixels, sharing the 
+  // mapping so that it is unmapped with the last of them
+  FaceSnapshotMemory* memory = new FaceSnapshotMemory;
+  memory->refcount = 1;
+  memory->addr = mapAddr;
+  memory->size = mapSize;
+  memory->mapped = true;
+  Mat pixels(header->count * header->rows, header->cols, CV_8UC1, base + header->pixelsOffset);
+  pixels.allocator = &g_faceSnapshotAllocator;
+  pixels.refcount = &memory->refcount;
+  images.reserve(header->count);
+  labels.reserve(header->count);
+  for (int i=0; i<header->count; ++i)
+  {
+    images.push_back(pixels.rowRange(i * header->rows, (i + 1) * header->rows));
+    labels.push_back(labelPtr[i]);
+  }
+  fingerprint.assign(header->fingerprint, strnlen(header->fingerprint, sizeof(header->fingerprint)));
+
+  return true;
+}
+
+
+bool saveFaceSnapshot(const string& filename, const string& fingerprint, const vector<Mat>& images, const vector<int>& labels, const map<int, string>& names, const vector<FaceFileRecord>& records)
+{
+  // Check the face data
+  if (images.empty() || images.size() != labels.size() || images.size() != records.size()) return false;
+  int rows = images[0].rows;
+  int cols = images[0].cols;
+  for (int i=0; i<images.size(); ++i)
+  {
+    if (images[i].rows != rows || images[i].cols != cols || images[i].type() != CV_8UC1) return false;
+  }
+
+  // Serialize the name table
+  vector<unsigned char> nameTable;
+  for (map<int, string>::const_iterator it=names.begin(); it!=names.end(); ++it)
+  {
+    appendBytes(nameTable, (int32_t)it->first);
+    appendBytes(nameTable, (uint32_t)it->second.size());
+    nameTable.insert(nameTable.end(), it->second.begin(), it->second.end());
+  }
+
+  // Serialize the manifest
+  vector<unsigned char> recordTable;
+  for (int i=0; i<records.size(); ++i)
+  {
+    appendBytes(recordTable, (int64_t)records[i].size);
+    appendBytes(recordTable, (int64_t)records[i].mtime);
+    appendBytes(recordTable, (uint64_t)records[i].hash);
+    appendBytes(recordTable, (uint32_t)records[i].path.size());
+    recordTable.insert(recordTable.end(), records[i].path.begin(), records[i].path.end());
+  }
+
+  // Lay out the snapshot file
+  FaceSnapshotHeader header;
+  memset(&header, 0, sizeof(header));
+  memcpy(header.magic, FACE_SNAPSHOT_MAGIC, sizeof(FACE_SNAPSHOT_MAGIC));
+  header.version = FACE_SNAPSHOT_VERSION;
+  header.headerSize = sizeof(FaceSnapshotHeader);
+  strncpy(header.fingerprint, fingerprint.c_str(), sizeof(header.fingerprint));
+  header.count = (int32_t)images.size();
+  header.rows = rows;
+  header.cols = cols;
+  header.nameCount = (int32_t)names.size();
+  header.labelsOffset = alignOffset(sizeof(FaceSnapshotHeader), 8);
+  header.namesOffset = header.labelsOffset + (uint64_t)header.count * sizeof(int32_t);
+  header.namesSize = nameTable.size();
+  header.recordsOffset = header.namesOffset + header.namesSize;
+  header.recordsSize = recordTable.size();
+  header.pixelsOffset = alignOffset(header.recordsOffset + header.recordsSize, 64);
+  header.fileSize = header.pixelsOffset + (uint64_t)header.count * rows * cols;
+
+  // Open the temporary snapshot file
+  string tmpFilename = format("%s.%d.tmp", filename.c_str(), (int)getpid());
+  FILE* fp = fopen(tmpFilename.c_str(), "wb");
+  if (fp == NULL) return false;
+
+  // Write the header, the label array, the name table and the manifest
+  bool success = fwrite(&header, sizeof(header), 1, fp) == 1;
+  vector<unsigned char> padding(64, 0);
+  success = success && fwrite(&padding[0], 1, header.labelsOffset - sizeof(header), fp) == header.labelsOffset - sizeof(header);
+  for (int i=0; success && i<labels.size(); ++i)
+  {
+    int32_t label = labels[i];
+    success = fwrite(&label, sizeof(label), 1, fp) == 1;
+  }
+  if (success && !nameTable.empty())
+  {
+    success = fwrite(&nameTable[0], 1, nameTable.size(), fp) == nameTable.size();
+  }
+  if (success && !recordTable.empty())
+  {
+    success = fwrite(&recordTable[0], 1, recordTable.size(), fp) == recordTable.size();
+  }
+  uint64_t paddingSize = header.pixelsOffset - header.recordsOffset - header.recordsSize;
+  success = success && fwrite(&padding[0], 1, paddingSize, fp) == paddingSize;
+
+  // Write the pixel data row by row
+  for (int i=0; success && i<images.size(); ++i)
+  {
+    for (int r=0; success && r<rows; ++r)
+    {
+      success = fwrite(images[i].ptr(r), 1, cols, fp) == (size_t)cols;
+    }
+  }
+
+  // Replace the snapshot file
+  success = (fclose(fp) == 0) && success;
+  if (!success || rename(tmpFilename.c_str(), filename.c_str()) != 0)
+  {
+    remove(tmpFilename.c_str());
+    return false;
+  }
+
+  return true;
+}
+
+
+/**
+ * @brief
+ *   A face image to be read by the face loader.
+ */
+struct FaceLoaderItem
+{
+  string path;              // Full path to the face image
+  Mat* image;               // Face image to store the result to
+  uint64* hash;             // Content hash to store the result to
+  Mat cachedImage;          // Cached face of a previous content, if any
+  uint64 cachedHash;        // Content hash of the cached face
+  bool reused;              // Whether the content is unchanged
+};
+
+
+/**
+ * @brief
+ *   Face images shared by the worker threads of the face loader. 
+ *   Each worker takes the next face image by an atomic increment 
+ *   and writes the face to the image of the item, so the result 
+ *   does not depend on the scheduling of the workers.
+ */
+struct FaceLoaderTask
+{
+  vector<FaceLoaderItem>* items;      // Face images to read
+  int nextIndex;                      // Index of the next item to read
+};
+
+
+/**
+ * @brief
+ *   State of a worker thread of the face loader.
+ */
+struct FaceLoaderWorker
+{
+  FaceLoaderTask* task;     // Shared face images to read
+  pthread_t thread;         // Thread of the worker
+  bool started;             // Whether the thread is started
+  int loadedCount;          // Number of faces read by the worker
+  double loadSeconds;       // Time spent by the worker in seconds
+  string errorPath;         // Path to the first image failed to read
+};
+
+
+/**
+ * @param arg Pointer to the FaceLoaderWorker.
+ * @return NULL.
+ *
+ * @brief
+ *    Read, hash and normalize face images until none remains. A 
+ *    face image whose content hash matches its cached face is not 
+ *    decoded.
+ */
+static void* runFaceLoaderWorker(void* arg)
+{
+  FaceLoaderWorker* worker = (FaceLoaderWorker*)arg;
+  FaceLoaderTask* task = worker->task;
+  int count = (int)task->items->size();
+  int64 startTick = getTickCount();
+  vector<uchar> content;
+
+  for (;;)
+  {
+    // Take the next face image
+    int index = CV_XADD(&task->nextIndex, 1);
+    if (index >= count) break;
+    FaceLoaderItem& item = (*task->items)[index];
+
+    // Read and hash the image file
+    if (!readFileContent(item.path, content))
+    {
+      if (worker->errorPath.empty()) worker->errorPath = item.path;
+      continue;
+    }
+    *item.hash = content.empty() ? hashFNV1a(NULL, 0) : hashFNV1a(&content[0], content.size());
+    worker->loadedCount++;
+
+    // Reuse the cached face if the content is unchanged
+    if (!item.cachedImage.empty() && item.cachedHash == *item.hash)
+    {
+      *item.image = item.cachedImage.clone();
+      item.reused = true;
+      continue;
+    }
+
+    // Decode and normalize the face image
+    Mat img_original = content.empty() ? Mat() : imdecode(Mat(content), 0);
+    if (img_original.empty())
+    {
+      if (worker->errorPath.empty()) worker->errorPath = item.path;
+      continue;
+    }
+    cv::resize(img_original, *item.image, Size(STD_FACE_REC_SIZE, STD_FACE_REC_SIZE), 1.0, 1.0, INTER_CUBIC);
+  }
+
+  worker->loadSeconds = (double)(getTickCount() - startTick) / getTickFrequency();
+  return NULL;
+}
+
+
+/**
+ * @param items Face images to read.
+ * @param numThreads Number of worker threads, "0" for one per CPU.
+ *
+ * @brief
+ *    Read the face images by a pool of worker threads, and inform 
+ *    the throughput of each worker.
+ */
+static void loadFaceImages(vector<FaceLoaderItem>& items, int numThreads)
+{
+  // Obtain the number of worker threads
+  if (numThreads <= 0) numThreads = getNumberOfCPUs();
+  numThreads = std::max(1, std::min(numThreads, (int)items.size()));
+
+  // Prepare the shared task
+  FaceLoaderTask task;
+  task.items = &items;
+  task.nextIndex = 0;
+
+  // Start the worker threads
+  vector<FaceLoaderWorker> workers(numThreads);
+  int64 startTick = getTickCount();
+  for (int i=0; i<numThreads; ++i)
+  {
+    workers[i].task = &task;
+    workers[i].loadedCount = 0;
+    workers[i].loadSeconds = 0.0;
+    workers[i].started = (pthread_create(&workers[i].thread, NULL, runFaceLoaderWorker, &workers[i]) == 0);
+
+    // Fall back to read in the current thread
+    if (!workers[i].started) runFaceLoaderWorker(&workers[i]);
+  }
+
+  // Wait for the worker threads
+  for (int i=0; i<numThreads; ++i)
+  {
+    if (workers[i].started) pthread_join(workers[i].thread, NULL);
+  }
+  double totalSeconds = (double)(getTickCount() - startTick) / getTickFrequency();
+
+  // Inform the throughput of each worker
+  cout << "[INFO] " << items.size() << " face images read by " << numThreads << " threads in " 
+       << totalSeconds * 1000.0 << " ms (" << items.size() / std::max(totalSeconds, 1e-9) << " images/s):" << endl;
+  for (int i=0; i<numThreads; ++i)
+  {
+    cout << "\t- Thread " << i << ": " << workers[i].loadedCount << " images in " << workers[i].loadSeconds * 1000.0
+         << " ms (" << workers[i].loadedCount / std::max(workers[i].loadSeconds, 1e-9) << " images/s)" << endl;
+  }
+
+  // Check the face images failed to read
+  for (int i=0; i<numThreads; ++i)
+  {
+    if (!workers[i].errorPath.empty())
+    {
+      string error_message = "Cannot read the face image " + workers[i].errorPath + ".";
+      cerr << "[ERROR] loadFaceImages(vector<FaceLoaderItem>&, int): " << error_message << endl;
+      CV_Error(CV_StsBadArg, error_message);
+    }
+  }
+}
+
+
+void loadFaceData(const string& datapath, vector<Mat>& images, vector<int>& labels, map<int, string>& names, int numThreads)
+{
+  vector<FaceFileRecord> records;
+  vector<Mat> cachedImages;
+  vector<int> cachedLabels;
+  map<int, string> cachedNames;
+  vector<FaceFileRecord> cachedRecords;
+  string cachedFingerprint;
+  
+  // Clear the result containers
+  images.clear();
+  labels.clear();
+  names.clear();
+
+  // Obtain the face data path
+  string faceDataPath = datapath + "/faces";
+  string faceSnapshotPath = datapath + "/faces.snapshot";
+
+  // Scan the face database directory
+  scanFaceData(datapath, records, names);
+  string fingerprint = computeFaceDataFingerprint(records);
+
+  // Load the face data from the snapshot if it is up to date
+  bool hasSnapshot = loadFaceSnapshot(faceSnapshotPath, cachedFingerprint, cachedImages, cachedLabels, cachedNames, cachedRecords);
+  if (hasSnapshot && cachedFingerprint == fingerprint)
+  {
+    images.swap(cachedImages);
+    labels.swap(cachedLabels);
+    names.swap(cachedNames);
+    cout << "[INFO] Load " << images.size() << " faces from snapshot \"" << faceSnapshotPath << "\"." << endl;
+    return;
+  }
+
+  // Index the cached faces by path
+  map<string, int> cachedIndices;
+  if (hasSnapshot && !cachedImages.empty() && cachedImages[0].size() == Size(STD_FACE_REC_SIZE, STD_FACE_REC_SIZE))
+  {
+    for (int i=0; i<cachedRecords.size(); ++i)
+    {
+      cachedIndices.insert( pair<string, int>(cachedRecords[i].path, i) );
+    }
+  }
+
+  // Inform the loading state
+  cout << "[INFO] Open face data directory \"" << faceDataPath << "\". Now loading: " << endl;
+
+  // Reuse the cached faces of the unchanged face images and collect 
+  // the rest to read. The reused faces are copied out of the stale 
+  // snapshot, so that its mapping is released with this function
+  vector<FaceLoaderItem> items;
+  int unchangedCount = 0;
+  int matchedCount = 0;
+  images.resize(records.size());
+  labels.resize(records.size());
+  for (int i=0; i<records.size(); ++i)
+  {
+    labels[i] = records[i].label;
+    map<string, int>::const_iterator it = cachedIndices.find(records[i].path);
+    if (it != cachedIndices.end()) matchedCount++;
+
+    // Reuse the cached face if the file status is unchanged
+    if (it != cachedIndices.end() && 
+        cachedRecords[it->second].size == records[i].size && 
+        cachedRecords[it->second].mtime == records[i].mtime)
+    {
+      images[i] = cachedImages[it->second].clone();
+      records[i].hash = cachedRecords[it->second].hash;
+      unchangedCount++;
+      continue;
+    }
+
+    // Read the new or modified face image
+    FaceLoaderItem item;
+    item.path = faceDataPath + "/" + records[i].path;
+    item.image = &images[i];
+    item.hash = &records[i].hash;
+    item.cachedHash = 0;
+    item.reused = false;
+    if (it != cachedIndices.end())
+    {
+      item.cachedImage = cachedImages[it->second];
+      item.cachedHash = cachedRecords[it->second].hash;
+    }
+    items.push_back(item);
+
+    // Inform the loading state
+    cout << "\t- " << records[i].path << ((it != cachedIndices.end())?(" (modified)"):(" (new)")) << endl;
+  }
+
+  // Read the face images
+  if (!items.empty()) loadFaceImages(items, numThreads);
+  int reusedCount = 0;
+  for (int i=0; i<items.size(); ++i)
+  {
+    if (items[i].reused) reusedCount++;
+  }
+  int removedCount = (int)cachedIndices.size() - matchedCount;
+  cout << "[INFO] " << records.size() << " faces loaded: " << unchangedCount << " unchanged, "
+       << reusedCount << " touched but identical, " << items.size() - reusedCount << " decoded, "
+       << removedCount << " removed." << endl;
+
+  // Update the snapshot for the later runs
+  if (saveFaceSnapshot(faceSnapshotPath, fingerprint, images, labels, names, records))
+  {
+    cout << "[INFO] Face data packed into snapshot \"" << faceSnapshotPath << "\"." << endl;
+  }
+}
@@ -0,0 +1,185 @@
+/**
+ * Face database shared by the face recognition applications. It 
+ * provides the traversal of the face database directory, the 
+ * fingerprint of its state, and the loading of the face images 
+ * for training, either from the images directly or from a packed 
+ * snapshot of the normalized faces.
+ *
+ * Author:  David Qiu.
+ * Email:   david@davidqiu.com
+ * Email:   dicong.qiu@intel.com
+ * Website: http://www.davidqiu.com/
+ *
+ * Copyright (C) 2014, David Qiu. All rights reserved.
+ */
+
+#ifndef FACEREC_FACE_DATABASE_HPP
+#define FACEREC_FACE_DATABASE_HPP
+
+#include "opencv2/core/core.hpp"
+
+#include <map>
+#include <string>
+#include <vector>
+
+
+const int STD_FACE_REC_SIZE = 64;
+
+
+/**
+ * @brief
+ *   Type of directory item.
+ */ 
+enum DirectoryItemType
+{
+  DIRITEM_OTHER = 0,  // Other directory item type
+  DIRITEM_FILE = 1,   // Normal file
+  DIRITEM_DIR = 2     // Directory item
+};
+
+
+/**
+ * @brief
+ *   Manifest record of a face image in the face database.
+ */
+struct FaceFileRecord
+{
+  std::string path;         // Path relative to the "faces" directory
+  int label;                // Label of the face
+  int64 size;               // Size of the image file in bytes
+  int64 mtime;              // Modification time of the image file
+  uint64 hash;              // FNV-1a hash of the image file content
+};
+
+
+/**
+ * @param dirpath Path to the directory.
+ * @param items Item names from the directory
+ * @param types Directory types of corresponding items.
+ * @return An int indicating the operation state. "0" indicates 
+ *         success and negative numbers indicate failure.
+ *
+ * @brief
+ *    Traverse a directory and obtain all the items. Hidden files 
+ *    will be ignored.
+ */
+int traverseDirectory(std::string dirpath, std::vector<std::string>& items, std::vector<DirectoryItemType>& types);
+
+
+/**
+ * @param data Pointer to the data to hash.
+ * @param size Size of the data in bytes.
+ * @param hash Hash value to continue from.
+ * @return The updated hash value.
+ *
+ * @brief
+ *    Accumulate data to a 64-bit FNV-1a hash.
+ */
+uint64 hashFNV1a(const void* data, size_t size, uint64 hash = 14695981039346656037ULL);
+
+
+/**
+ * @param datapath Path to face database directory.
+ * @param records Array to store the manifest records of the face 
+ *        images, in the order of labeling. The content hashes are 
+ *        not computed and left as "0".
+ * @param names Mapping from label to name of the face.
+ *
+ * @brief
+ *    Scan the face database directory without reading any image. 
+ *    The label of a face is the index of its face directory in the 
+ *    face database directory.
+ */
+void scanFaceData(const std::string& datapath, std::vector<FaceFileRecord>& records, std::map<int, std::string>& names);
+
+
+/**
+ * @param records Manifest records of the face images.
+ * @return A hexadecimal string identifying the state of the face 
+ *         database.
+ *
+ * @brief
+ *    Compute the fingerprint of the face database. The fingerprint 
+ *    covers the path, label, size and modification time of every 
+ *    face image, so it changes whenever a retrain would give a 
+ *    different model.
+ */
+std::string computeFaceDataFingerprint(const std::vector<FaceFileRecord>& records);
+
+
+/**
+ * @param datapath Path to face database directory.
+ * @return A hexadecimal string identifying the current state of the 
+ *         face database.
+ *
+ * @brief
+ *    Scan the face database and compute its fingerprint. No image 
+ *    is read.
+ */
+std::string computeFaceDataFingerprint(const std::string& datapath);
+
+
+/**
+ * @param filename Path to the face snapshot file.
+ * @param fingerprint Fingerprint of the face database recorded in 
+ *        the snapshot.
+ * @param images Array to store face image data.
+ * @param labels Array to store corresponding labels for face images.
+ * @param names Mapping from label to name of the face.
+ * @param records Array to store the manifest records of the faces.
+ * @return True if the snapshot exists and is valid, and false 
+ *         otherwise.
+ *
+ * @brief
+ *    Load the face data from a snapshot written by 
+ *    saveFaceSnapshot(). The snapshot file is memory-mapped and the 
+ *    face images are read-only headers over the mapped pixels, so 
+ *    no pixel is copied or decoded. The file is unmapped when the 
+ *    last face image over it is released.
+ */
+bool loadFaceSnapshot(const std::string& filename, std::string& fingerprint, std::vector<cv::Mat>& images, std::vector<int>& labels, std::map<int, std::string>& names, std::vector<FaceFileRecord>& records);
+
+
+/**
+ * @param filename Path to the face snapshot file.
+ * @param fingerprint Fingerprint of the face database.
+ * @param images Face image data, all of the same size and of type 
+ *        CV_8UC1.
+ * @param labels Corresponding labels for face images.
+ * @param names Mapping from label to name of the face.
+ * @param records Manifest records of the faces.
+ * @return True if the snapshot is written successfully, and false 
+ *         otherwise.
+ *
+ * @brief
+ *    Pack the face data and its manifest into a single snapshot 
+ *    file. The snapshot is written to a temporary file first and 
+ *    then renamed, so that concurrent runs never read a partially 
+ *    written snapshot.
+ */
+bool saveFaceSnapshot(const std::string& filename, const std::string& fingerprint, const std::vector<cv::Mat>& images, const std::vector<int>& labels, const std::map<int, std::string>& names, const std::vector<FaceFileRecord>& records);
+
+
+/**
+ * @param datapath Path to face database directory.
+ * @param images Array to store face image data.
+ * @param labels Array to store corresponding labels for face images.
+ * @param names Mapping from label to name of the face.
+ * @param numThreads Number of worker threads to read the face 
+ *        images. "0" indicates one worker thread per CPU.
+ *
+ * @brief
+ *    Load face data from face database directory. The normalized 
+ *    faces are cached in the snapshot "<datapath>/faces.snapshot" 
+ *    together with the manifest of the face images. The snapshot 
+ *    is used as it is if the face database is unchanged. Otherwise 
+ *    only the new face images and the face images whose content 
+ *    changed are read, by a pool of worker threads, the deleted 
+ *    face images are dropped, and the snapshot is updated for the 
+ *    later runs. The order of the faces and their labels do not 
+ *    depend on the number of worker threads.
+ */
+void loadFaceData(const std::string& datapath, std::vector<cv::Mat>& images, std::vector<int>& labels, std::map<int, std::string>& names, int numThreads = 0);
+
+
+#endif // FACEREC_FACE_DATABASE_HPP
@@ -0,0 +1,619 @@
+/**
+ * Face detection.
+ *
+ * Author:  David Qiu.
+ * Email:   david@davidqiu.com
+ * Email:   dicong.qiu@intel.com
+ * Website: http://www.davidqiu.com/
+ *
+ * Copyright (C) 2014, David Qiu. All rights reserved.
+ */
+
+#include "FaceDetection.hpp"
+#include "FaceCascade.hpp"
+
+#include "opencv2/imgproc/imgproc.hpp"
+
+#include <iostream>
+#include <algorithm>
+#include <cmath>
+#include <pthread.h>
+using namespace cv;
+using namespace std;
+
+
+/**
+ * @brief
+ *   Detection window size assumed when the face detecter does not 
+ *   report it, which is the case for the cascades in the old format 
+ *   not loaded by FaceCascade.
+ */
+const int DEFAULT_DETECTION_WINDOW_SIZE = 24;
+
+
+/**
+ * @param backend Name of a detection backend.
+ * @return Type of the features of the cascades of the backend.
+ */
+static int obtainBackendFeatureType(const string& backend)
+{
+  if (backend == "haar") return FeatureEvaluator::HAAR;
+  if (backend == "lbp") return FeatureEvaluator::LBP;
+  CV_Error(CV_StsBadArg, "Unknown detection backend " + backend + ", expected haar or lbp.");
+  return -1;
+}
+
+
+string obtainDetectionCascadePath(const string& fn_cascade, const FaceRecConfig& config)
+{
+  if (obtainBackendFeatureType(config.detectBackend) == FeatureEvaluator::HAAR) return fn_cascade;
+
+  // Find the LBP cascade next to the Haar cascade
+  const string& fn_lbp = config.detectLbpCascade;
+  if (fn_lbp.empty() || fn_lbp[0] == '/') return fn_lbp;
+  size_t pos = fn_cascade.find_last_of('/');
+  return (pos == string::npos) ? fn_lbp : fn_cascade.substr(0, pos + 1) + fn_lbp;
+}
+
+
+bool loadDetectionCascade(FaceCascade& cascade, const string& fn_cascade, const FaceRecConfig& config)
+{
+  string fn_backend = obtainDetectionCascadePath(fn_cascade, config);
+  if (!cascade.load(fn_backend)) return false;
+  if (cascade.getFeatureType() != obtainBackendFeatureType(config.detectBackend))
+  {
+    cerr << "[ERROR] The cascade \"" << fn_backend << "\" is not a cascade of the detection backend " << config.detectBackend << "." << endl;
+    return false;
+  }
+  return true;
+}
+
+
+Size obtainDetectionWindowSize(const CascadeClassifier& cascade)
+{
+  const FaceCascade* faceCascade = dynamic_cast<const FaceCascade*>(&cascade);
+  Size windowSize = faceCascade ? faceCascade->getWindowSize() : cascade.getOriginalWindowSize();
+  if (windowSize.width <= 0 || windowSize.height <= 0)
+  {
+    windowSize = Size(DEFAULT_DETECTION_WINDOW_SIZE, DEFAULT_DETECTION_WINDOW_SIZE);
+  }
+  return windowSize;
+}
+
+
+double computeDetectionScale(const Size& imageSize, const Size& windowSize, const FaceRecConfig& config)
+{
+  double scale = 1.0;
+  int longestSide = std::max(imageSize.width, imageSize.height);
+
+  // Limit the longest side of the image
+  double maxSideScale = 0.0;
+  if (config.detectMaxSide > 0 && longestSide > 0)
+  {
+    maxSideScale = (double)config.detectMaxSide / longestSide;
+  }
+
+  // Scale the smallest face down to the detection window
+  double minFaceScale = 0.0;
+  if (config.detectMinFace > 0)
+  {
+    minFaceScale = (double)std::max(windowSize.width, windowSize.height) / config.detectMinFace;
+  }
+
+  if (maxSideScale > 0.0 && minFaceScale > 0.0) scale = std::max(maxSideScale, minFaceScale);
+  else if (maxSideScale > 0.0) scale = maxSideScale;
+  else if (minFaceScale > 0.0) scale = minFaceScale;
+
+  return std::min(scale, 1.0);
+}
+
+
+/**
+ * @param fscale Scale from the original image to the image.
+ * @param config Configuration with the detection parameters.
+ * @param minSize Variable to store the smallest face size.
+ * @param maxSize Variable to store the largest face size.
+ *
+ * @brief
+ *    Scale the face size bounds of the configuration with the image.
+ */
+static void computeDetectionSizeBounds(double fscale, const FaceRecConfig& config, Size& minSize, Size& maxSize)
+{
+  minSize = Size();
+  maxSize = Size();
+  if (config.detectMinSize > 0)
+  {
+    int size = cvRound(config.detectMinSize * fscale);
+    minSize = Size(size, size);
+  }
+  if (config.detectMaxSize > 0)
+  {
+    int size = std::max(cvRound(config.detectMaxSize * fscale), 1);
+    maxSize = Size(size, size);
+  }
+}
+
+
+/**
+ * @param cascade Face detecter.
+ * @param gray Image in grayscale.
+ * @param faces Array to store the positions of the faces.
+ * @param scaleFactor Scale between the pyramid levels.
+ * @param minNeighbors Neighbor detections to keep a face.
+ * @param minSize Smallest face size.
+ * @param maxSize Largest face size.
+ * @param compiled Whether to detect with the compiled cascade of the 
+ *        face detecter, if it has one.
+ * @param simd SIMD kernels of the compiled cascade.
+ *
+ * @brief
+ *    Run a face detecter over the pyramid levels of an image.
+ */
+static void runFaceDetecter(CascadeClassifier& cascade, const Mat& gray, vector<Rect>& faces, double scaleFactor, int minNeighbors, Size minSize, Size maxSize, bool compiled, SimdLevel simd)
+{
+  const FaceCascade* faceCascade = compiled ? dynamic_cast<const FaceCascade*>(&cascade) : NULL;
+  if (faceCascade != NULL && faceCascade->getCompiledCascade() != NULL)
+  {
+    detectCompiledCascade(*faceCascade->getCompiledCascade(), gray, faces, scaleFactor, minNeighbors, minSize, maxSize, simd);
+  }
+  else
+  {
+    cascade.detectMultiScale(gray, faces, scaleFactor, minNeighbors, 0, minSize, maxSize);
+  }
+}
+
+
+/**
+ * @brief
+ *   Band of the pyramid levels of a parallel detection, detected by 
+ *   its own thread with its own face detecter.
+ */
+struct DetectionBand
+{
+  CascadeClassifier* cascade;   // Face detecter of the band
+  const Mat* gray;              // Image to detect
+  double scaleFactor;           // Scale between the pyramid levels
+  Size minSize;                 // Smallest window of the band
+  Size maxSize;                 // Largest window of the band
+  bool compiled;                // Whether to detect with the compiled cascade
+  SimdLevel simd;               // SIMD kernels of the compiled cascade
+  vector<Rect> candidates;      // Ungrouped detections of the band
+  bool failed;                  // Whether the detection failed
+  string error;                 // Reason of the failure
+  pthread_t thread;             // Thread of the band
+};
+
+
+/**
+ * @param arg Pointer to the DetectionBand.
+ * @return NULL.
+ *
+ * @brief
+ *    Detect the ungrouped candidates of a band of pyramid levels.
+ */
+static void* runDetectionBand(void* arg)
+{
+  DetectionBand* band = (DetectionBand*)arg;
+  try
+  {
+    runFaceDetecter(*band->cascade, *band->gray, band->candidates, band->scaleFactor, 0, band->minSize, band->maxSize, band->compiled, band->simd);
+  }
+  catch (cv::Exception& e)
+  {
+    band->failed = true;
+    band->error = e.msg;
+  }
+  return NULL;
+}
+
+
+void detectFacesInScaledImage(const vector<CascadeClassifier*>& cascades, const Mat& gray, double fscale, const FaceRecConfig& config, vector<Rect>& faces)
+{
+  Size minSize;
+  Size maxSize;
+  computeDetectionSizeBounds(fscale, config, minSize, maxSize);
+  double scaleFactor = (config.detectScaleFactor > 1.0) ? config.detectScaleFactor : 1.1;
+  SimdLevel simd = obtainSimdLevel(config.detectSimd);
+
+  // Detect serially with a single face detecter
+  if (cascades.size() <= 1)
+  {
+    runFaceDetecter(*cascades[0], gray, faces, scaleFactor, config.detectMinNeighbors, minSize, maxSize, config.detectCompiled != 0, simd);
+    return;
+  }
+
+  // List the window widths of the pyramid levels as the face detecter 
+  // does, from the detection window up to the image or the largest 
+  // face size, with the number of windows of each level as its cost
+  Size windowSize = obtainDetectionWindowSize(*cascades[0]);
+  int lowestWidth = std::max(minSize.width, 1);
+  int highestWidth = (maxSize.width > 0) ? std::min(maxSize.width, gray.cols) : gray.cols;
+  vector<int> levelWidths;
+  vector<double> levelCosts;
+  double totalCost = 0.0;
+  for (double factor = 1.0; ; factor *= scaleFactor)
+  {
+    int width = cvRound(windowSize.width * factor);
+    int height = cvRound(windowSize.height * factor);
+    if (width > highestWidth || height > gray.rows) break;
+    if (width < lowestWidth) continue;
+    if (!levelWidths.empty() && width <= levelWidths.back()) continue;
+    levelWidths.push_back(width);
+    levelCosts.push_back((double)(gray.cols - width + 1) * (gray.rows - height + 1) / (factor * factor));
+    totalCost += levelCosts.back();
+  }
+
+  // Split the levels into bands of about the same cost, one per face 
+  // detecter. The bands bound the window width only and cover every 
+  // width once, so that each level is detected by exactly one band 
+  // whatever the window size of the face detecter is.
+  vector<int> bandStarts(1, lowestWidth);
+  double bandCost = 0.0;
+  for (int k=0; k<levelWidths.size(); ++k)
+  {
+    if (bandCost >= totalCost / cascades.size() && bandStarts.size() < cascades.size())
+    {
+      bandStarts.push_back(levelWidths[k]);
+      bandCost = 0.0;
+    }
+    bandCost += levelCosts[k];
+  }
+
+  // Detect the ungrouped candidates of each band in its own thread
+  int numBands = (int)bandStarts.size();
+  vector<DetectionBand> bands(numBands);
+  for (int b=0; b<numBands; ++b)
+  {
+    DetectionBand& band = bands[b];
+    band.cascade = cascades[b];
+    band.gray = &gray;
+    band.scaleFactor = scaleFactor;
+    band.minSize = Size(bandStarts[b], std::max(minSize.height, 1));
+    band.maxSize = Size((b + 1 < numBands) ? bandStarts[b + 1] - 1 : highestWidth, 
+                        (maxSize.height > 0) ? maxSize.height : gray.rows);
+    band.compiled = (config.detectCompiled != 0);
+    band.simd = simd;
+    band.failed = false;
+  }
+  vector<bool> started(numBands, false);
+  for (int b=1; b<numBands; ++b)
+  {
+    started[b] = (pthread_create(&bands[b].thread, NULL, runDetectionBand, &bands[b]) == 0);
+  }
+  for (int b=0; b<numBands; ++b)
+  {
+    if (!started[b]) runDetectionBand(&bands[b]);
+  }
+  for (int b=1; b<numBands; ++b)
+  {
+    if (started[b]) pthread_join(bands[b].thread, NULL);
+  }
+
+  // Group the candidates of all the bands at once, as the face 
+  // detecter groups the candidates of all the levels
+  faces.clear();
+  for (int b=0; b<numBands; ++b)
+  {
+    if (bands[b].failed) CV_Error(CV_StsError, bands[b].error);
+    faces.insert(faces.end(), bands[b].candidates.begin(), bands[b].candidates.end());
+  }
+  if (config.detectMinNeighbors > 0) groupRectangles(faces, config.detectMinNeighbors, 0.2);
+}
+
+
+void detectFacesInScaledImage(CascadeClassifier& cascade, const Mat& gray, double fscale, const FaceRecConfig& config, vector<Rect>& faces)
+{
+  detectFacesInScaledImage(vector<CascadeClassifier*>(1, &cascade), gray, fscale, config, faces);
+}
+
+
+/**
+ * @brief
+ *   Bytes of working memory of the face detecter per pixel of a tile, 
+ *   for the integral images and the image pyramid.
+ */
+const int TILE_BYTES_PER_PIXEL = 24;
+
+
+void mergeDuplicateFaces(vector<Rect>& faces)
+{
+  // Sort the faces from the largest to the smallest
+  vector< pair<int, int> > order;
+  for (int i=0; i<faces.size(); ++i) order.push_back(make_pair(-faces[i].area(), i));
+  std::sort(order.begin(), order.end());
+
+  // Keep the faces not mostly covered by a larger face kept
+  vector<Rect> merged;
+  for (int i=0; i<order.size(); ++i)
+  {
+    const Rect& face = faces[order[i].second];
+    bool duplicate = false;
+    for (int j=0; j<merged.size() && !duplicate; ++j)
+    {
+      int intersection = (face & merged[j]).area();
+      duplicate = (intersection * 10 >= face.area() * 7);
+    }
+    if (!duplicate) merged.push_back(face);
+  }
+  faces.swap(merged);
+}
+
+
+/**
+ * @brief
+ *   Shared state of the threads detecting the tiles of an image. Each 
+ *   thread takes the next tile by an atomic increment.
+ */
+struct DetectionTiles
+{
+  const Mat* gray;                  // Image to detect
+  FaceRecConfig config;             // Detection parameters in pixels of the image
+  vector<Rect> tiles;               // Tiles of the image
+  vector< vector<Rect> > faces;     // Faces detected in each tile
+  int nextIndex;                    // Index of the next tile
+  bool failed;                      // Whether the detection failed
+  string error;                     // Reason of the failure
+};
+
+
+/**
+ * @brief
+ *   State of a thread detecting the tiles of an image.
+ */
+struct DetectionTileWorker
+{
+  DetectionTiles* tiles;            // Shared state of the tiles
+  CascadeClassifier* cascade;       // Face detecter of the thread
+  pthread_t thread;                 // Thread of the worker
+};
+
+
+/**
+ * @param arg Pointer to the DetectionTileWorker.
+ * @return NULL.
+ *
+ * @brief
+ *    Detect the tiles until none remains.
+ */
+static void* runDetectionTileWorker(void* arg)
+{
+  DetectionTileWorker* worker = (DetectionTileWorker*)arg;
+  DetectionTiles* tiles = worker->tiles;
+  int count = (int)tiles->tiles.size();
+
+  for (;;)
+  {
+    int index = CV_XADD(&tiles->nextIndex, 1);
+    if (index >= count) break;
+
+    // Detect the faces in the tile, without copying it
+    const Rect& tile = tiles->tiles[index];
+    vector<Rect>& faces = tiles->faces[index];
+    try
+    {
+      detectFacesInScaledImage(*worker->cascade, (*tiles->gray)(tile), 1.0, tiles->config, faces);
+    }
+    catch (cv::Exception& e)
+    {
+      tiles->failed = true;
+      tiles->error = e.msg;
+      break;
+    }
+
+    // Move the faces to the image
+    for (int i=0; i<faces.size(); ++i)
+    {
+      faces[i].x += tile.x;
+      faces[i].y += tile.y;
+    }
+  }
+
+  return NULL;
+}
+
+
+/**
+ * @param cascades Face detecters, one per thread.
+ * @param gray Image in grayscale.
+ * @param config Detection parameters, with the face size bounds in 
+ *        pixels of the image.
+ * @param tileSize Side of the tiles.
+ * @param faces Array to store the positions of the faces.
+ *
+ * @brief
+ *    Detect the faces in an image tile by tile. The tiles overlap by 
+ *    a quarter of their side and find the faces up to the overlap, 
+ *    which lie entirely in at least one tile. The larger faces are 
+ *    found in a copy of the image downscaled until they fit the 
+ *    detection window, tiled again if it is still larger than a 
+ *    tile. The working memory is bounded by the tiles, whatever the 
+ *    image size.
+ */
+static void detectFacesTiled(const vector<CascadeClassifier*>& cascades, const Mat& gray, const FaceRecConfig& config, int tileSize, vector<Rect>& faces)
+{
+  faces.clear();
+
+  // Detect the image at once if it fits a tile
+  if (gray.cols <= tileSize && gray.rows <= tileSize)
+  {
+    detectFacesInScaledImage(cascades, gray, 1.0, config, faces);
+    return;
+  }
+
+  Size windowSize = obtainDetectionWindowSize(*cascades[0]);
+  int windowSide = std::max(windowSize.width, windowSize.height);
+  int overlap = tileSize / 4;
+  int stride = tileSize - overlap;
+
+  // Detect the faces up to the overlap in the tiles
+  if (config.detectMinSize <= overlap)
+  {
+    DetectionTiles tiles;
+    tiles.gray = &gray;
+    tiles.config = config;
+    tiles.config.detectMaxSize = (config.detectMaxSize > 0) ? std::min(config.detectMaxSize, overlap) : overlap;
+    int tileWidth = std::min(tileSize, gray.cols);
+    int tileHeight = std::min(tileSize, gray.rows);
+    for (int y=0; ; y+=stride)
+    {
+      // Align the last row and column of tiles to the image border
+      int tileY = std::min(y, gray.rows - tileHeight);
+      for (int x=0; ; x+=stride)
+      {
+        int tileX = std::min(x, gray.cols - tileWidth);
+        tiles.tiles.push_back(Rect(tileX, tileY, tileWidth, tileHeight));
+        if (tileX + tileWidth >= gray.cols) break;
+      }
+      if (tileY + tileHeight >= gray.rows) break;
+    }
+    tiles.faces.resize(tiles.tiles.size());
+    tiles.nextIndex = 0;
+    tiles.failed = false;
+
+    // Detect the tiles by the threads
+    int numThreads = (int)std::min(cascades.size(), tiles.tiles.size());
+    vector<DetectionTileWorker> workers(numThreads);
+    vector<bool> started(numThreads, false);
+    for (int t=0; t<numThreads; ++t)
+    {
+      workers[t].tiles = &tiles;
+      workers[t].cascade = cascades[t];
+    }
+    for (int t=1; t<numThreads; ++t)
+    {
+      started[t] = (pthread_create(&workers[t].thread, NULL, runDetectionTileWorker, &workers[t]) == 0);
+    }
+    runDetectionTileWorker(&workers[0]);
+    for (int t=1; t<numThreads; ++t)
+    {
+      if (started[t]) pthread_join(workers[t].thread, NULL);
+      else runDetectionTileWorker(&workers[t]);
+    }
+    if (tiles.failed) CV_Error(CV_StsError, tiles.error);
+
+    for (int i=0; i<tiles.faces.size(); ++i)
+    {
+      faces.insert(faces.end(), tiles.faces[i].begin(), tiles.faces[i].end());
+    }
+  }
+
+  // Detect the faces larger than the overlap in a downscaled copy
+  if ((config.detectMaxSize <= 0 || config.detectMaxSize > overlap) && overlap > windowSide)
+  {
+    double rscale = (double)windowSide / overlap;
+    Size coarseSize(std::max(cvRound(gray.cols * rscale), 1), std::max(cvRound(gray.rows * rscale), 1));
+    Mat coarse;
+    cv::resize(gray, coarse, coarseSize, 0, 0, INTER_AREA);
+
+    FaceRecConfig coarseConfig = config;
+    coarseConfig.detectMinSize = cvRound(std::max(config.detectMinSize, overlap) * rscale);
+    coarseConfig.detectMaxSize = (config.detectMaxSize > 0) ? std::max(cvRound(config.detectMaxSize * rscale), 1) : 0;
+    vector<Rect> coarseFaces;
+    detectFacesTiled(cascades, coarse, coarseConfig, tileSize, coarseFaces);
+
+    // Project the faces back to the image
+    double invrscale_x = (double)gray.cols / coarseSize.width;
+    double invrscale_y = (double)gray.rows / coarseSize.height;
+    Rect bounds(0, 0, gray.cols, gray.rows);
+    for (int i=0; i<coarseFaces.size(); ++i)
+    {
+      Rect face_i = coarseFaces[i];
+      Rect face_i_original(
+        cvRound(face_i.x * invrscale_x),
+        cvRound(face_i.y * invrscale_y),
+        cvRound(face_i.width * invrscale_x),
+        cvRound(face_i.height * invrscale_y)
+      );
+      face_i_original &= bounds;
+      if (face_i_original.area() > 0) faces.push_back(face_i_original);
+    }
+  }
+
+  // Merge the faces found more than once
+  mergeDuplicateFaces(faces);
+}
+
+
+/**
+ * @param cascades Face detecters, one per thread.
+ * @param config Configuration with the tiled detection.
+ * @return Side of the tiles, or "0" if the tiled detection is off.
+ *
+ * @brief
+ *    Compute the side of the tiles from the tile size and from the 
+ *    working memory of the configuration, whichever is smaller. A 
+ *    tile is at least 8 detection windows wide.
+ */
+static int computeDetectionTileSize(const vector<CascadeClassifier*>& cascades, const FaceRecConfig& config)
+{
+  int tileSize = config.detectTileSize;
+  if (config.detectMemoryMB > 0)
+  {
+    double tilePixels = (double)config.detectMemoryMB * 1048576.0 / (TILE_BYTES_PER_PIXEL * cascades.size());
+    int memoryTileSize = (int)std::sqrt(tilePixels);
+    tileSize = (tileSize > 0) ? std::min(tileSize, memoryTileSize) : memoryTileSize;
+  }
+  if (tileSize <= 0) return 0;
+
+  Size windowSize = obtainDetectionWindowSize(*cascades[0]);
+  return std::max(tileSize, 8 * std::max(windowSize.width, windowSize.height));
+}
+
+
+void detectFaces(const vector<CascadeClassifier*>& cascades, const Mat& gray, const FaceRecConfig& config, vector<Rect>& faces)
+{
+  faces.clear();
+
+  // Detect on the original image if no downscaling is required
+  double fscale = computeDetectionScale(gray.size(), obtainDetectionWindowSize(*cascades[0]), config);
+  Size detectSize(cvRound(gray.cols * fscale), cvRound(gray.rows * fscale));
+  int tileSize = computeDetectionTileSize(cascades, config);
+  if (fscale >= 1.0 || detectSize.width <= 0 || detectSize.height <= 0)
+  {
+    if (tileSize > 0) detectFacesTiled(cascades, gray, config, tileSize, faces);
+    else detectFacesInScaledImage(cascades, gray, 1.0, config, faces);
+    return;
+  }
+
+  // Downscale the image, with area interpolation to avoid aliasing 
+  // at large downscaling factors
+  Mat gray_resized;
+  cv::resize(gray, gray_resized, detectSize, 0, 0, INTER_AREA);
+
+  // Find the faces in the downscaled image
+  vector<Rect> faces_resized;
+  if (tileSize > 0)
+  {
+    FaceRecConfig tileConfig = config;
+    tileConfig.detectMinSize = cvRound(config.detectMinSize * fscale);
+    tileConfig.detectMaxSize = (config.detectMaxSize > 0) ? std::max(cvRound(config.detectMaxSize * fscale), 1) : 0;
+    detectFacesTiled(cascades, gray_resized, tileConfig, tileSize, faces_resized);
+  }
+  else
+  {
+    detectFacesInScaledImage(cascades, gray_resized, fscale, config, faces_resized);
+  }
+
+  // Project the faces back to the original image
+  double invfscale_x = (double)gray.cols / detectSize.width;
+  double invfscale_y = (double)gray.rows / detectSize.height;
+  Rect bounds(0, 0, gray.cols, gray.rows);
+  for (int i=0; i<faces_resized.size(); ++i)
+  {
+    Rect face_i = faces_resized[i];
+    Rect face_i_original(
+      cvRound(face_i.x * invfscale_x),
+      cvRound(face_i.y * invfscale_y),
+      cvRound(face_i.width * invfscale_x),
+      cvRound(face_i.height * invfscale_y)
+    );
+    face_i_original &= bounds;
+    if (face_i_original.area() > 0) faces.push_back(face_i_original);
+  }
+}
+
+
+void detectFaces(CascadeClassifier& cascade, const Mat& gray, const FaceRecConfig& config, vector<Rect>& faces)
+{
+  detectFaces(vector<CascadeClassifier*>(1, &cascade), gray, config, faces);
+}
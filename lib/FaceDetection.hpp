@@ -0,0 +1,159 @@
+/**
+ * Face detection. The faces are detected on a downscaled copy of the 
+ * image according to the detection resolution policy of the 
+ * configuration, and their positions are projected back to the 
+ * original image.
+ *
+ * Author:  David Qiu.
+ * Email:   david@davidqiu.com
+ * Email:   dicong.qiu@intel.com
+ * Website: http://www.davidqiu.com/
+ *
+ * Copyright (C) 2014, David Qiu. All rights reserved.
+ */
+
+#ifndef FACEREC_FACE_DETECTION_HPP
+#define FACEREC_FACE_DETECTION_HPP
+
+#include "opencv2/core/core.hpp"
+#include "opencv2/objdetect/objdetect.hpp"
+
+#include "FaceRecConfig.hpp"
+
+#include <string>
+#include <vector>
+
+
+class FaceCascade;
+
+
+/**
+ * @param fn_cascade Path to the Haar cascade given to the application.
+ * @param config Configuration with the detection backend.
+ * @return Path to the cascade of the detection backend.
+ *
+ * @brief
+ *    Obtain the cascade of the detection backend "detect_backend". 
+ *    The Haar backend uses the cascade given, and the LBP backend 
+ *    uses "detect_lbp_cascade", found in the directory of the cascade 
+ *    given unless it is an absolute path.
+ */
+std::string obtainDetectionCascadePath(const std::string& fn_cascade, const FaceRecConfig& config);
+
+
+/**
+ * @param cascade Face detecter to load.
+ * @param fn_cascade Path to the Haar cascade given to the application.
+ * @param config Configuration with the detection backend.
+ * @return True if the cascade of the detection backend is loaded and 
+ *         has the features of the backend, and false otherwise.
+ *
+ * @brief
+ *    Load the cascade of the detection backend into a face detecter.
+ */
+bool loadDetectionCascade(FaceCascade& cascade, const std::string& fn_cascade, const FaceRecConfig& config);
+
+
+/**
+ * @param cascade Face detecter.
+ * @return Size of the smallest face the face detecter can find.
+ *
+ * @brief
+ *    Obtain the detection window size of a face detecter.
+ */
+cv::Size obtainDetectionWindowSize(const cv::CascadeClassifier& cascade);
+
+
+/**
+ * @param imageSize Size of the original image.
+ * @param windowSize Detection window size of the face detecter.
+ * @param config Configuration with the detection resolution policy.
+ * @return Scale from the original image to the image for detection, 
+ *         no larger than 1.
+ *
+ * @brief
+ *    Compute the scale of the image for detection. "detect_max_side" 
+ *    limits the longest side of the image, and "detect_min_face" 
+ *    scales the smallest face to find down to the detection window. 
+ *    If both are given, the larger scale is taken so that no face of 
+ *    "detect_min_face" is lost.
+ */
+double computeDetectionScale(const cv::Size& imageSize, const cv::Size& windowSize, const FaceRecConfig& config);
+
+
+/**
+ * @param faces Faces detected, possibly more than once.
+ *
+ * @brief
+ *    Merge the faces detected more than once, across the seams of 
+ *    the tiles or across separate searches, keeping the largest of 
+ *    the faces mostly covering each other.
+ */
+void mergeDuplicateFaces(std::vector<cv::Rect>& faces);
+
+
+/**
+ * @param cascade Face detecter.
+ * @param gray Image in grayscale, scaled from the original image.
+ * @param fscale Scale from the original image to the image.
+ * @param config Configuration with the detection parameters.
+ * @param faces Array to store the positions of the faces in the 
+ *        scaled image.
+ *
+ * @brief
+ *    Detect the faces in a scaled image with the detection 
+ *    parameters of the configuration. The face size bounds are 
+ *    given in pixels of the original image, and they are scaled 
+ *    with the image.
+ */
+void detectFacesInScaledImage(cv::CascadeClassifier& cascade, const cv::Mat& gray, double fscale, const FaceRecConfig& config, std::vector<cv::Rect>& faces);
+
+
+/**
+ * @param cascades Face detecters loaded from the same cascade, one 
+ *        per thread.
+ * @param gray Image in grayscale, scaled from the original image.
+ * @param fscale Scale from the original image to the image.
+ * @param config Configuration with the detection parameters.
+ * @param faces Array to store the positions of the faces in the 
+ *        scaled image.
+ *
+ * @brief
+ *    Same as above, with the pyramid levels split into bands of 
+ *    about the same cost detected in parallel, one band per face 
+ *    detecter. The ungrouped detections of all the bands are 
+ *    grouped at once, so that the faces are the same as those of a 
+ *    single face detecter.
+ */
+void detectFacesInScaledImage(const std::vector<cv::CascadeClassifier*>& cascades, const cv::Mat& gray, double fscale, const FaceRecConfig& config, std::vector<cv::Rect>& faces);
+
+
+/**
+ * @param cascade Face detecter.
+ * @param gray Original image in grayscale.
+ * @param config Configuration with the detection resolution policy.
+ * @param faces Array to store the positions of the faces in the 
+ *        original image.
+ *
+ * @brief
+ *    Detect the faces in an image at the detection resolution, with 
+ *    the detection parameters of the configuration.
+ */
+void detectFaces(cv::CascadeClassifier& cascade, const cv::Mat& gray, const FaceRecConfig& config, std::vector<cv::Rect>& faces);
+
+
+/**
+ * @param cascades Face detecters loaded from the same cascade, one 
+ *        per thread.
+ * @param gray Original image in grayscale.
+ * @param config Configuration with the detection resolution policy.
+ * @param faces Array to store the positions of the faces in the 
+ *        original image.
+ *
+ * @brief
+ *    Same as above, with the pyramid levels detected in parallel.
+ */
+void detectFaces(const std::vector<cv::CascadeClassifier*>& cascades, const cv::Mat& gray, const FaceRecConfig& config, std::vector<cv::Rect>& faces);
+
+
+#endif // FACEREC_FACE_DETECTION_HPP
@@ -0,0 +1,287 @@
+/**
+ * Enrollment of new face samples into a trained face recognizer.
+ *
+ * Author:  David Qiu.
+ * Email:   david@davidqiu.com
+ * Email:   dicong.qiu@intel.com
+ * Website: http://www.davidqiu.com/
+ *
+ * Copyright (C) 2014, David Qiu. All rights reserved.
+ */
+
+#include "FaceEnrollment.hpp"
+
+#include <iostream>
+#include <string>
+using namespace cv;
+using namespace std;
+
+
+/**
+ * @param model A face recognizer.
+ * @return An untrained face recognizer of the same algorithm and 
+ *         with the same settings.
+ *
+ * @brief
+ *    Create a face recognizer to be retrained without touching the 
+ *    one in use. The integer and real number parameters, such as 
+ *    the number of components and the threshold, are copied.
+ */
+static Ptr<FaceRecognizer> createUntrainedCopy(const Ptr<FaceRecognizer>& model)
+{
+  Ptr<FaceRecognizer> copy = Algorithm::create<FaceRecognizer>(model->name());
+  if (copy.empty())
+  {
+    CV_Error(CV_StsNotImplemented, "Cannot create the face recognizer " + model->name() + ".");
+  }
+
+  vector<string> params;
+  model->getParams(params);
+  for (int i=0; i<params.size(); ++i)
+  {
+    int type = model->paramType(params[i]);
+    if (type == Param::INT) copy->set(params[i], model->getInt(params[i]));
+    if (type == Param::REAL) copy->set(params[i], model->getDouble(params[i]));
+  }
+
+  return copy;
+}
+
+
+FaceEnrollment::FaceEnrollment(const Ptr<FaceRecognizer>& model, const vector<Mat>& images, const vector<int>& labels, int batchSize, double idleSeconds)
+  : _model(model), 
+    _images(images), 
+    _labels(labels), 
+    _pendingCount(0), 
+    _batchSize(std::max(batchSize, 1)), 
+    _idleSeconds(idleSeconds), 
+    _lastAddTick(getTickCount()), 
+    _threadStarted(false), 
+    _stopping(false), 
+    _retrainPosted(false), 
+    _training(false), 
+    _swapped(false)
+{
+  // Only the LBPH face recognizer supports updating in OpenCV
+  _incremental = (model->name() == "FaceRecognizer.LBPH");
+
+  // Register the face recognizers to create the retrained ones
+  initModule_contrib();
+
+  // Start the background retraining thread
+  pthread_mutex_init(&_mutex, NULL);
+  pthread_cond_init(&_cond, NULL);
+  if (!_incremental)
+  {
+    _threadStarted = (pthread_create(&_thread, NULL, runRetrainThread, this) == 0);
+    if (!_threadStarted)
+    {
+      cerr << "[WARNING] Cannot start the retraining thread. Retraining in the foreground." << endl;
+    }
+  }
+}
+
+
+FaceEnrollment::~FaceEnrollment()
+{
+  // Stop the background retraining thread
+  if (_threadStarted)
+  {
+    pthread_mutex_lock(&_mutex);
+    _stopping = true;
+    pthread_cond_broadcast(&_cond);
+    pthread_mutex_unlock(&_mutex);
+    pthread_join(_thread, NULL);
+  }
+  pthread_cond_destroy(&_cond);
+  pthread_mutex_destroy(&_mutex);
+}
+
+
+void FaceEnrollment::add(const Mat& face, int label)
+{
+  pthread_mutex_lock(&_mutex);
+
+  // Record the new sample
+  _images.push_back(face);
+  _labels.push_back(label);
+  _lastAddTick = getTickCount();
+
+  // Leave the sample pending until the next retrain
+  if (!_incremental)
+  {
+    _pendingCount++;
+    pthread_mutex_unlock(&_mutex);
+    return;
+  }
+  pthread_mutex_unlock(&_mutex);
+
+  // Update the face recognizer with the new sample only
+  vector<Mat> newImages(1, face);
+  vector<int> newLabels(1, label);
+  _model->update(newImages, newLabels);
+}
+
+
+bool FaceEnrollment::poll()
+{
+  pthread_mutex_lock(&_mutex);
+
+  // Check if the face recognizer has been replaced
+  bool swapped = _swapped;
+  _swapped = false;
+
+  // Check if a retrain is due and none is in progress
+  double idle = (double)(getTickCount() - _lastAddTick) / getTickFrequency();
+  bool due = _pendingCount > 0 && (_pendingCount >= _batchSize || idle >= _idleSeconds);
+  if (due && !_retrainPosted && !_training)
+  {
+    if (_threadStarted)
+    {
+      postRetrain();
+    }
+    else
+    {
+      // Retrain in the foreground without the retraining thread
+      _model->train(_images, _labels);
+      _pendingCount = 0;
+      swapped = true;
+    }
+  }
+
+  pthread_mutex_unlock(&_mutex);
+  return swapped;
+}
+
+
+void FaceEnrollment::flush()
+{
+  pthread_mutex_lock(&_mutex);
+
+  // Retrain in the foreground without the retraining thread
+  if (!_threadStarted)
+  {
+    if (_pendingCount > 0) _model->train(_images, _labels);
+    _pendingCount = 0;
+    pthread_mutex_unlock(&_mutex);
+    return;
+  }
+
+  // Wait for the retrain in progress and retrain the rest
+  while (_retrainPosted || _training) pthread_cond_wait(&_cond, &_mutex);
+  if (_pendingCount > 0)
+  {
+    postRetrain();
+    while (_retrainPosted || _training) pthread_cond_wait(&_cond, &_mutex);
+  }
+  _swapped = false;
+
+  pthread_mutex_unlock(&_mutex);
+}
+
+
+void FaceEnrollment::postRetrain()
+{
+  // Share the face images with the retraining thread
+  _retrainImages = _images;
+  _retrainLabels = _labels;
+  _pendingCount = 0;
+  _retrainPosted = true;
+  pthread_cond_broadcast(&_cond);
+}
+
+
+void* FaceEnrollment::runRetrainThread(void* arg)
+{
+  FaceEnrollment* self = (FaceEnrollment*)arg;
+  vector<Mat> images;
+  vector<int> labels;
+
+  pthread_mutex_lock(&self->_mutex);
+  for (;;)
+  {
+    // Wait for a posted retrain
+    while (!self->_stopping && !self->_retrainPosted) pthread_cond_wait(&self->_cond, &self->_mutex);
+    if (!self->_retrainPosted) break;
+
+    // Take the posted retrain
+    images.swap(self->_retrainImages);
+    labels.swap(self->_retrainLabels);
+    self->_retrainImages.clear();
+    self->_retrainLabels.clear();
+    self->_retrainPosted = false;
+    self->_training = true;
+    Ptr<FaceRecognizer> current = self->_model;
+    pthread_mutex_unlock(&self->_mutex);
+
+    // Retrain a new face recognizer while the current one is in use
+    Ptr<FaceRecognizer> retrained;
+    try
+    {
+      retrained = createUntrainedCopy(current);
+      retrained->train(images, labels);
+    }
+    catch (cv::Exception& e)
+    {
+      cerr << "[WARNING] Failed to retrain the face recognizer. Reason: " << e.msg << endl;
+      retrained.release();
+    }
+    images.clear();
+    labels.clear();
+
+    // Replace the face recognizer in use
+    pthread_mutex_lock(&self->_mutex);
+    if (!retrained.empty())
+    {
+      self->_model = retrained;
+      self->_swapped = true;
+    }
+    self->_training = false;
+    pthread_cond_broadcast(&self->_cond);
+  }
+  pthread_mutex_unlock(&self->_mutex);
+
+  return NULL;
+}
+
+
+Ptr<FaceRecognizer> FaceEnrollment::getModel()
+{
+  pthread_mutex_lock(&_mutex);
+  Ptr<FaceRecognizer> model = _model;
+  pthread_mutex_unlock(&_mutex);
+  return model;
+}
+
+
+int FaceEnrollment::getPendingCount()
+{
+  pthread_mutex_lock(&_mutex);
+  int count = _pendingCount;
+  pthread_mutex_unlock(&_mutex);
+  return count;
+}
+
+
+int FaceEnrollment::getSampleCount()
+{
+  pthread_mutex_lock(&_mutex);
+  int count = (int)_images.size();
+  pthread_mutex_unlock(&_mutex);
+  return count;
+}
+
+
+bool FaceEnrollment::isTraining()
+{
+  pthread_mutex_lock(&_mutex);
+  bool training = _retrainPosted || _training;
+  pthread_mutex_unlock(&_mutex);
+  return training;
+}
+
+
+bool FaceEnrollment::isIncremental() const
+{
+  return _incremental;
+}
@@ -0,0 +1,153 @@
+/**
+ * Enrollment of new face samples into a trained face recognizer. 
+ * New samples are folded into the recognizer without retraining it 
+ * on the whole face database at every capture: recognizers that 
+ * support updating, such as LBPH, are updated with the new sample 
+ * only, and the other recognizers are retrained once per batch of 
+ * samples by a background thread, while the previous recognizer 
+ * keeps serving predictions.
+ *
+ * Author:  David Qiu.
+ * Email:   david@davidqiu.com
+ * Email:   dicong.qiu@intel.com
+ * Website: http://www.davidqiu.com/
+ *
+ * Copyright (C) 2014, David Qiu. All rights reserved.
+ */
+
+#ifndef FACEREC_FACE_ENROLLMENT_HPP
+#define FACEREC_FACE_ENROLLMENT_HPP
+
+#include "opencv2/core/core.hpp"
+#include "opencv2/contrib/contrib.hpp"
+
+#include <pthread.h>
+#include <vector>
+
+
+/**
+ * @brief
+ *   Enrollment of new face samples into a trained face recognizer.
+ */
+class FaceEnrollment
+{
+public:
+  /**
+   * @param model Face recognizer trained on the images and labels.
+   * @param images Face images the face recognizer is trained on.
+   * @param labels Corresponding labels for face images.
+   * @param batchSize Number of pending samples to trigger a retrain.
+   * @param idleSeconds Time since the last new sample to trigger a 
+   *        retrain of the pending samples.
+   */
+  FaceEnrollment(const cv::Ptr<cv::FaceRecognizer>& model, const std::vector<cv::Mat>& images, const std::vector<int>& labels, int batchSize, double idleSeconds);
+
+  /**
+   * @brief
+   *    Stop the background retraining thread. A retrain in progress 
+   *    is completed first.
+   */
+  ~FaceEnrollment();
+
+  /**
+   * @param face Face image of the new sample.
+   * @param label Label of the new sample.
+   *
+   * @brief
+   *    Add a new sample. An updatable face recognizer is updated 
+   *    right away. Otherwise the sample is pending until the next 
+   *    retrain.
+   */
+  void add(const cv::Mat& face, int label);
+
+  /**
+   * @return True if a retrained face recognizer has replaced the 
+   *         previous one since the last call, and false otherwise.
+   *
+   * @brief
+   *    Start a background retrain if enough samples are pending, 
+   *    or if samples are pending and no sample was added for a 
+   *    while. No retrain is started while another one is in 
+   *    progress, so the samples added meanwhile are coalesced into 
+   *    a single retrain after it. It never blocks on a retrain and 
+   *    is supposed to be called once per frame.
+   */
+  bool poll();
+
+  /**
+   * @brief
+   *    Retrain the face recognizer with all the pending samples and 
+   *    wait until the retrained face recognizer is in use.
+   */
+  void flush();
+
+  /**
+   * @return The latest trained face recognizer. It is never 
+   *         modified by a background retrain, which replaces it 
+   *         with a new face recognizer instead.
+   */
+  cv::Ptr<cv::FaceRecognizer> getModel();
+
+  /**
+   * @return Number of samples not folded into the face recognizer.
+   */
+  int getPendingCount();
+
+  /**
+   * @return Number of samples, including the pending ones.
+   */
+  int getSampleCount();
+
+  /**
+   * @return True if a background retrain is in progress.
+   */
+  bool isTraining();
+
+  /**
+   * @return True if the face recognizer is updated sample by sample.
+   */
+  bool isIncremental() const;
+
+private:
+  FaceEnrollment(const FaceEnrollment&);
+  FaceEnrollment& operator=(const FaceEnrollment&);
+
+  /**
+   * @brief
+   *    Post all the samples as the next retrain. The mutex must be 
+   *    locked by the caller.
+   */
+  void postRetrain();
+
+  /**
+   * @param arg Pointer to the FaceEnrollment.
+   * @return NULL.
+   *
+   * @brief
+   *    Entry of the background retraining thread.
+   */
+  static void* runRetrainThread(void* arg);
+
+  cv::Ptr<cv::FaceRecognizer> _model;   // Latest trained face recognizer
+  std::vector<cv::Mat> _images;         // All the face images
+  std::vector<int> _labels;             // Labels of all the face images
+  int _pendingCount;                    // Number of the pending samples
+  int _batchSize;                       // Number of pending samples to retrain
+  double _idleSeconds;                  // Idle time to retrain
+  int64 _lastAddTick;                   // Tick count of the last new sample
+  bool _incremental;                    // Whether the recognizer is updatable
+
+  pthread_mutex_t _mutex;               // Mutex guarding the state below
+  pthread_cond_t _cond;                 // Condition of the retrain state
+  pthread_t _thread;                    // Background retraining thread
+  bool _threadStarted;                  // Whether the thread is started
+  bool _stopping;                       // Whether the thread should stop
+  bool _retrainPosted;                  // Whether a retrain waits for the thread
+  bool _training;                       // Whether a retrain is in progress
+  bool _swapped;                        // Whether the model is replaced since the last poll
+  std::vector<cv::Mat> _retrainImages;  // Face images of the posted retrain
+  std::vector<int> _retrainLabels;      // Labels of the posted retrain
+};
+
+
+#endif // FACEREC_FACE_ENROLLMENT_HPP
@@ -0,0 +1,558 @@
+/**
+ * Face gallery.
+ *
+ * Author:  David Qiu.
+ * Email:   david@davidqiu.com
+ * Email:   dicong.qiu@intel.com
+ * Website: http://www.davidqiu.com/
+ *
+ * Copyright (C) 2014, David Qiu. All rights reserved.
+ */
+
+#include "FaceGallery.hpp"
+
+#include <iostream>
+#include <algorithm>
+#include <cfloat>
+#include <climits>
+#include <utility>
+#include <cmath>
+using namespace cv;
+using namespace std;
+
+
+/**
+ * @param squaredDistance Squared distance in single precision.
+ * @param norms Sum of the norms of both projections.
+ * @param dimensions Number of floats summed.
+ * @return Bound of the rounding error of the squared distance.
+ *
+ * @brief
+ *    Bound the rounding error of a squared distance computed in single
+ *    precision from projections rounded to single precision, twice
+ *    over for safety: each difference is off by up to 2u of the norms,
+ *    and the sum of the squares by up to "dimensions" u of the sum,
+ *    where u is the unit roundoff of single precision.
+ */
+static double boundDistanceError(double squaredDistance, double norms, int dimensions)
+{
+  const double u = FLT_EPSILON / 2;
+  return 2.0 * (4.0 * u * std::sqrt(squaredDistance) * norms + (dimensions + 4) * u * squaredDistance);
+}
+
+
+FaceGallery::FaceGallery()
+  : _dimensions(0),
+    _maxNorm(0.0),
+    _threshold(DBL_MAX),
+    _simd(SIMD_NONE),
+    _storage(GALLERY_STORAGE_FLOAT32),
+    _rerank(0),
+    _probes(FACE_INDEX_PROBES)
+{
+}
+
+
+FaceGallery::FaceGallery(const Ptr<FaceRecognizer>& model, SimdLevel simd)
+  : _dimensions(0),
+    _maxNorm(0.0),
+    _threshold(DBL_MAX),
+    _simd(std::min(simd, detectSimdLevel())),
+    _storage(GALLERY_STORAGE_FLOAT32),
+    _rerank(0),
+    _probes(FACE_INDEX_PROBES)
+{
+  // Only the face recognizers projecting into a subspace are supported
+  if (model.empty()) return;
+  string name = model->name();
+  if (name != "FaceRecognizer.Eigenfaces" && name != "FaceRecognizer.Fisherfaces") return;
+
+  // Take the subspace
+  Mat mean = model->getMat("mean");
+  Mat eigenvectors = model->getMat("eigenvectors");
+  if (mean.empty() || eigenvectors.empty()) return;
+  mean.reshape(1, 1).convertTo(_mean, CV_64F);
+  eigenvectors.convertTo(_eigenvectors, CV_64F);
+
+  // Stack the projections of the gallery faces in double precision
+  vector<Mat> projections = model->getMatVector("projections");
+  Mat labels = model->getMat("labels");
+  _projections.create((int)projections.size(), _eigenvectors.cols, CV_64F);
+  _labels.resize(projections.size());
+  for (int i=0; i<projections.size(); ++i)
+  {
+    Mat row = _projections.row(i);
+    projections[i].reshape(1, 1).convertTo(row, CV_64F);
+    _labels[i] = labels.at<int>(i);
+  }
+  _threshold = model->getDouble("threshold");
+  layoutProjections();
+}
+
+
+FaceGallery::FaceGallery(const Mat& projections, const vector<int>& labels, double threshold, SimdLevel simd)
+  : _dimensions(0),
+    _maxNorm(0.0),
+    _threshold(threshold),
+    _simd(std::min(simd, detectSimdLevel())),
+    _storage(GALLERY_STORAGE_FLOAT32),
+    _rerank(0),
+    _probes(FACE_INDEX_PROBES)
+{
+  CV_Assert(projections.rows == (int)labels.size());
+  projections.convertTo(_projections, CV_64F);
+  _labels = labels;
+  layoutProjections();
+}
+
+
+bool FaceGallery::empty() const
+{
+  return _labels.empty();
+}
+
+
+int FaceGallery::getSize() const
+{
+  return (int)_labels.size();
+}
+
+
+int FaceGallery::getDimensions() const
+{
+  return _dimensions;
+}
+
+
+SimdLevel FaceGallery::getSimdLevel() const
+{
+  return _simd;
+}
+
+
+void FaceGallery::setSimdLevel(SimdLevel simd)
+{
+  _simd = std::min(simd, detectSimdLevel());
+}
+
+
+GalleryStorage FaceGallery::getStorage() const
+{
+  return _storage;
+}
+
+
+int FaceGallery::getRerank() const
+{
+  return _rerank;
+}
+
+
+size_t FaceGallery::getMemorySize() const
+{
+  return _projections.total() * _projections.elemSize() + 
+         _aligned.total() * _aligned.elemSize() + 
+         _quantized.total() * _quantized.elemSize() + 
+         _scales.total() * _scales.elemSize();
+}
+
+
+void FaceGallery::quantize(GalleryStorage storage, int rerank)
+{
+  if (empty() || _storage != GALLERY_STORAGE_FLOAT32 || storage == GALLERY_STORAGE_FLOAT32) return;
+  int count = _projections.rows;
+
+  if (storage == GALLERY_STORAGE_INT8)
+  {
+    // Scale each dimension so that its largest magnitude maps to 127
+    allocateGalleryRows(1, _dimensions, _scaleBuffer, _scales);
+    float* scales = _scales.ptr<float>();
+    for (int i=0; i<count; ++i)
+    {
+      const double* p = _projections.ptr<double>(i);
+      for (int d=0; d<_dimensions; ++d) scales[d] = std::max(scales[d], (float)std::fabs(p[d]));
+    }
+    for (int d=0; d<_dimensions; ++d) scales[d] /= 127.0f;
+
+    // Round the projections to the closest steps of their dimension
+    allocateGalleryRows(count, _dimensions, _quantizedBuffer, _quantized, CV_8S);
+    for (int i=0; i<count; ++i)
+    {
+      const double* p = _projections.ptr<double>(i);
+      signed char* q = _quantized.ptr<signed char>(i);
+      for (int d=0; d<_dimensions; ++d)
+      {
+        int step = (scales[d] > 0.0f) ? cvRound(p[d] / scales[d]) : 0;
+        q[d] = (signed char)std::max(-127, std::min(step, 127));
+      }
+    }
+  }
+  else
+  {
+    // Round the projections to half precision
+    allocateGalleryRows(count, _dimensions, _quantizedBuffer, _quantized, CV_16U);
+    for (int i=0; i<count; ++i)
+    {
+      const double* p = _projections.ptr<double>(i);
+      unsigned short* q = _quantized.ptr<unsigned short>(i);
+      for (int d=0; d<_dimensions; ++d) q[d] = convertToFloat16((float)p[d]);
+    }
+  }
+  _storage = storage;
+  _rerank = std::max(rerank, 0);
+
+  // Release the rows in single precision and the index built on them,
+  // and the projections in double precision unless reranking with them
+  _buffer.release();
+  _aligned.release();
+  _index = FaceIndex();
+  if (_rerank == 0) _projections.release();
+}
+
+
+void FaceGallery::buildIndex(int lists)
+{
+  if (empty() || _aligned.empty()) return;
+  _index.build(_aligned, getDimensions(), lists, computeKey());
+}
+
+
+bool FaceGallery::loadIndex(const string& filename)
+{
+  if (empty() || _aligned.empty()) return false;
+  return _index.load(filename, _aligned, getDimensions(), computeKey());
+}
+
+
+bool FaceGallery::saveIndex(const string& filename) const
+{
+  return _index.save(filename);
+}
+
+
+int FaceGallery::getIndexLists() const
+{
+  return _index.getLists();
+}
+
+
+int FaceGallery::getIndexProbes() const
+{
+  return _probes;
+}
+
+
+void FaceGallery::setIndexProbes(int probes)
+{
+  _probes = std::max(probes, 0);
+}
+
+
+void FaceGallery::project(const vector<Mat>& faces, Mat& projections) const
+{
+  CV_Assert(!_eigenvectors.empty());
+
+  // Stack the faces minus the mean face, one row per face
+  Mat data((int)faces.size(), _eigenvectors.rows, CV_64F);
+  for (int i=0; i<faces.size(); ++i)
+  {
+    Mat face = faces[i].isContinuous() ? faces[i] : faces[i].clone();
+    CV_Assert(face.total() * face.channels() == (size_t)data.cols);
+    Mat row = data.row(i);
+    face.reshape(1, 1).convertTo(row, CV_64F);
+    subtract(row, _mean, row);
+  }
+
+  // Project all the faces at once
+  gemm(data, _eigenvectors, 1.0, Mat(), 0.0, projections);
+}
+
+
+void FaceGallery::predict(const vector<Mat>& faces, vector<int>& labels, vector<double>& distances) const
+{
+  labels.assign(faces.size(), -1);
+  distances.assign(faces.size(), DBL_MAX);
+  if (faces.empty() || empty()) return;
+
+  Mat queries;
+  project(faces, queries);
+  predictProjections(queries, labels, distances);
+}
+
+
+void FaceGallery::predictProjections(const Mat& projections, vector<int>& labels, vector<double>& distances) const
+{
+  labels.assign(projections.rows, -1);
+  distances.assign(projections.rows, DBL_MAX);
+  if (projections.rows == 0 || empty()) return;
+  CV_Assert(projections.cols == _dimensions);
+
+  // Round the projections to the aligned rows of the SIMD kernels
+  Mat queries;
+  projections.convertTo(queries, CV_64F);
+  Mat queryBuffer;
+  Mat alignedQueries;
+  allocateGalleryRows(queries.rows, queries.cols, queryBuffer, alignedQueries);
+  for (int i=0; i<queries.rows; ++i)
+  {
+    Mat alignedRow = alignedQueries.row(i).colRange(0, queries.cols);
+    queries.row(i).convertTo(alignedRow, CV_32F);
+  }
+
+  // Compare each face with the lists of the index probed
+  if (!_index.empty() && _probes > 0)
+  {
+    vector<int> ids;
+    vector<float> squaredDistances;
+    for (int i=0; i<queries.rows; ++i)
+    {
+      _index.search(alignedQueries.ptr<float>(i), _probes, _simd, ids, squaredDistances);
+      if (ids.empty()) continue;
+      searchNearest(queries.row(i), &ids[0], &squaredDistances[0], (int)ids.size(), labels[i], distances[i]);
+    }
+    return;
+  }
+
+  // Compare each block of faces with each block of the gallery, so
+  // that the block of the gallery stays in the cache, in fewer faces
+  // at once for a large gallery to bound the distances held
+  int count = getSize();
+  int queryBlock = std::max(1, std::min(FACE_GALLERY_BLOCK, FACE_GALLERY_MAX_DISTANCES / count));
+  Mat squaredDistances;
+  for (int q0=0; q0<queries.rows; q0+=queryBlock)
+  {
+    int q1 = std::min(q0 + queryBlock, queries.rows);
+    squaredDistances.create(q1 - q0, count, CV_32F);
+    for (int g0=0; g0<count; g0+=FACE_GALLERY_BLOCK)
+    {
+      int g1 = std::min(g0 + FACE_GALLERY_BLOCK, count);
+      for (int i=q0; i<q1; ++i)
+      {
+        computeDistances(g0, g1 - g0, alignedQueries.ptr<float>(i), squaredDistances.ptr<float>(i - q0) + g0);
+      }
+    }
+
+    for (int i=q0; i<q1; ++i)
+    {
+      if (_storage == GALLERY_STORAGE_FLOAT32)
+      {
+        searchNearest(queries.row(i), NULL, squaredDistances.ptr<float>(i - q0), count, labels[i], distances[i]);
+      }
+      else
+      {
+        searchQuantized(queries.row(i), squaredDistances.ptr<float>(i - q0), count, labels[i], distances[i]);
+      }
+    }
+  }
+}
+
+
+/**
+ * @brief
+ *    Stack the projections of the gallery in the aligned single
+ *    precision rows of the SIMD kernels.
+ */
+void FaceGallery::layoutProjections()
+{
+  _dimensions = _projections.cols;
+  allocateGalleryRows(_projections.rows, _dimensions, _buffer, _aligned);
+  for (int i=0; i<_projections.rows; ++i)
+  {
+    Mat row = _projections.row(i);
+    Mat alignedRow = _aligned.row(i).colRange(0, _dimensions);
+    row.convertTo(alignedRow, CV_32F);
+    _maxNorm = std::max(_maxNorm, norm(row, NORM_L2));
+  }
+}
+
+
+/**
+ * @param begin First face of the gallery to compare.
+ * @param count Number of faces to compare.
+ * @param query Projection of a face in the aligned rows.
+ * @param squaredDistances Array to store the squared distances.
+ *
+ * @brief
+ *    Compare a face with a block of the gallery, with the kernels of
+ *    the storage of the gallery.
+ */
+void FaceGallery::computeDistances(int begin, int count, const float* query, float* squaredDistances) const
+{
+  switch (_storage)
+  {
+    case GALLERY_STORAGE_FLOAT16:
+      computeGalleryDistancesFloat16(_quantized.ptr<unsigned short>(begin), count, _quantized.cols, query, squaredDistances, _simd);
+      break;
+    case GALLERY_STORAGE_INT8:
+      computeGalleryDistancesInt8(_quantized.ptr<signed char>(begin), count, _quantized.cols, _scales.ptr<float>(), query, squaredDistances, _simd);
+      break;
+    default:
+      computeGalleryDistances(_aligned.ptr<float>(begin), count, _aligned.cols, query, squaredDistances, _simd);
+      break;
+  }
+}
+
+
+/**
+ * @return Key of the gallery, a hash of its projections in single
+ *         precision and of its labels.
+ *
+ * @brief
+ *    Compute the key matching an index with the gallery it is built
+ *    on, with the 64-bit FNV-1a hash.
+ */
+string FaceGallery::computeKey() const
+{
+  unsigned long long hash = 14695981039346656037ULL;
+  for (int i=0; i<_aligned.rows; ++i)
+  {
+    const unsigned char* bytes = _aligned.ptr(i);
+    for (size_t k=0; k<_aligned.cols * sizeof(float); ++k) hash = (hash ^ bytes[k]) * 1099511628211ULL;
+  }
+  for (int i=0; i<_labels.size(); ++i) hash = (hash ^ (unsigned int)_labels[i]) * 1099511628211ULL;
+  return format("%d-%d-%016llx", _aligned.rows, getDimensions(), hash);
+}
+
+
+/**
+ * @param query Projection of a face in double precision.
+ * @param ids Indices in the gallery of the faces compared, or "NULL"
+ *        for the whole gallery.
+ * @param squaredDistances Squared distances from the face to the
+ *        faces compared in single precision.
+ * @param count Number of faces compared.
+ * @param label Variable to store the label predicted, or "-1".
+ * @param distance Variable to store the distance to the closest face.
+ *
+ * @brief
+ *    Find the closest face of the gallery exactly as the face
+ *    recognizer does. The faces whose distance in single precision
+ *    may be the smallest, within the bound of its rounding error, are
+ *    compared again in double precision. A tie goes to the face first
+ *    in the order of the gallery.
+ */
+void FaceGallery::searchNearest(const Mat& query, const int* ids, const float* squaredDistances, int count, int& label, double& distance) const
+{
+  int dimensions = _aligned.cols;
+  double norms = _maxNorm + norm(query, NORM_L2);
+
+  // Bound the smallest squared distance in single precision
+  double best = *std::min_element(squaredDistances, squaredDistances + count);
+  double limit = best + boundDistanceError(best, norms, dimensions);
+
+  // Past the floor, the error is below half of the distance, so that
+  // a distance over twice the limit cannot be the smallest
+  double floor = 32.0 * (FLT_EPSILON / 2) * norms;
+  double cutoff = std::max(2.0 * limit, floor * floor);
+
+  label = -1;
+  distance = DBL_MAX;
+  int nearest = INT_MAX;
+  for (int j=0; j<count; ++j)
+  {
+    double d = squaredDistances[j];
+    if (d >= cutoff || (d > limit && d - boundDistanceError(d, norms, dimensions) > limit)) continue;
+
+    int id = (ids != NULL) ? ids[j] : j;
+    double dist = norm(_projections.row(id), query, NORM_L2);
+    if ((dist < distance || (dist == distance && id < nearest)) && dist < _threshold)
+    {
+      distance = dist;
+      label = _labels[id];
+      nearest = id;
+    }
+  }
+}
+
+
+/**
+ * @param query Projection of a face in double precision.
+ * @param squaredDistances Squared distances from the face to the
+ *        quantized gallery in single precision.
+ * @param count Number of faces of the gallery.
+ * @param label Variable to store the label predicted, or "-1".
+ * @param distance Variable to store the distance to the closest face.
+ *
+ * @brief
+ *    Find the closest face of the quantized gallery. With reranking,
+ *    the faces closest in the quantized gallery are compared again in
+ *    double precision, and the closest face is exact unless it is not
+ *    among them. Without, the distance is the one to the quantized
+ *    face.
+ */
+void FaceGallery::searchQuantized(const Mat& query, const float* squaredDistances, int count, int& label, double& distance) const
+{
+  label = -1;
+  distance = DBL_MAX;
+
+  if (_rerank == 0)
+  {
+    int nearest = (int)(std::min_element(squaredDistances, squaredDistances + count) - squaredDistances);
+    double dist = std::sqrt((double)squaredDistances[nearest]);
+    if (dist < _threshold)
+    {
+      distance = dist;
+      label = _labels[nearest];
+    }
+    return;
+  }
+
+  // Keep the closest faces in a max-heap of the squared distances
+  int candidates = std::min(_rerank, count);
+  vector< pair<float, int> > heap;
+  heap.reserve(candidates);
+  for (int j=0; j<count; ++j)
+  {
+    if (heap.size() < (size_t)candidates)
+    {
+      heap.push_back(make_pair(squaredDistances[j], j));
+      std::push_heap(heap.begin(), heap.end());
+    }
+    else if (squaredDistances[j] < heap.front().first)
+    {
+      std::pop_heap(heap.begin(), heap.end());
+      heap.back() = make_pair(squaredDistances[j], j);
+      std::push_heap(heap.begin(), heap.end());
+    }
+  }
+
+  // Compare them again in double precision
+  int nearest = INT_MAX;
+  for (int k=0; k<heap.size(); ++k)
+  {
+    int id = heap[k].second;
+    double dist = norm(_projections.row(id), query, NORM_L2);
+    if ((dist < distance || (dist == distance && id < nearest)) && dist < _threshold)
+    {
+      distance = dist;
+      label = _labels[id];
+      nearest = id;
+    }
+  }
+}
+
+
+void loadFaceGalleryIndex(const string& dir_data, int lists, FaceGallery& gallery)
+{
+  if (gallery.empty() || lists <= 0) return;
+  string fn_index = dir_data + "/index.yml";
+
+  // Load the cached index if it is of the gallery and has as many
+  // lists
+  int expected = std::min(lists, gallery.getSize());
+  if (gallery.loadIndex(fn_index) && gallery.getIndexLists() == expected)
+  {
+    cout << "[INFO] Gallery index loaded from \"" << fn_index << "\"." << endl;
+    return;
+  }
+
+  // Build the index
+  gallery.buildIndex(lists);
+  cout << "[INFO] Gallery index of " << gallery.getIndexLists() << " lists built." << endl;
+
+  // Cache the index for the later runs
+  if (gallery.saveIndex(fn_index))
+  {
+    cout << "[INFO] Gallery index cached as \"" << fn_index << "\"." << endl;
+  }
+}
@@ -0,0 +1,272 @@
+/**
+ * Face gallery. The subspace of an Eigenfaces or Fisherfaces face
+ * recognizer and the projections of its training faces, taken out of
+ * the face recognizer, so that a batch of faces is projected by a
+ * single matrix multiplication and compared with the whole gallery
+ * block by block, instead of one face at a time. The projections of
+ * the gallery are kept in one contiguous, cache-aligned float array
+ * scanned by the SIMD kernels of "GallerySimd.hpp", or searched
+ * through the inverted file index of "FaceIndex.hpp".
+ *
+ * Author:  David Qiu.
+ * Email:   david@davidqiu.com
+ * Email:   dicong.qiu@intel.com
+ * Website: http://www.davidqiu.com/
+ *
+ * Copyright (C) 2014, David Qiu. All rights reserved.
+ */
+
+#ifndef FACEREC_FACE_GALLERY_HPP
+#define FACEREC_FACE_GALLERY_HPP
+
+#include "opencv2/core/core.hpp"
+#include "opencv2/contrib/contrib.hpp"
+
+#include "FaceIndex.hpp"
+#include "GallerySimd.hpp"
+
+#include <string>
+#include <vector>
+
+
+/**
+ * @brief
+ *   Number of faces of a batch, and of the gallery, compared at once,
+ *   so that the block of the gallery stays in the cache.
+ */
+const int FACE_GALLERY_BLOCK = 256;
+
+
+/**
+ * @brief
+ *   Largest number of distances held at once, 16 MB of floats, which
+ *   narrows the batches of faces compared with a large gallery.
+ */
+const int FACE_GALLERY_MAX_DISTANCES = 1 << 22;
+
+
+/**
+ * @brief
+ *   Gallery of the faces a face recognizer is trained on, in its
+ *   subspace. The closest faces are searched in single precision,
+ *   and the faces within the rounding error of the closest one are
+ *   compared again in double precision, as the face recognizer does,
+ *   so that the predictions are those of the face recognizer. With
+ *   an index, only the faces of the lists probed are compared, so
+ *   that the closest face may be missed. A quantized gallery reads a
+ *   half or a quarter of the memory per face, and is exact only for
+ *   the faces whose closest face is among those reranked.
+ */
+class FaceGallery
+{
+public:
+  /**
+   * @brief
+   *    Create an empty gallery.
+   */
+  FaceGallery();
+
+  /**
+   * @param model Trained face recognizer.
+   * @param simd SIMD kernels of the search, narrowed to those
+   *        supported by the CPU.
+   *
+   * @brief
+   *    Take the subspace and the gallery of an Eigenfaces or
+   *    Fisherfaces face recognizer. The gallery is left empty for
+   *    the other face recognizers.
+   */
+  explicit FaceGallery(const cv::Ptr<cv::FaceRecognizer>& model, SimdLevel simd = SIMD_AVX512);
+
+  /**
+   * @param projections Projections of the gallery faces, one row per
+   *        face.
+   * @param labels Labels of the gallery faces.
+   * @param threshold Largest distance to predict a label.
+   * @param simd SIMD kernels of the search, narrowed to those
+   *        supported by the CPU.
+   *
+   * @brief
+   *    Take a gallery of projections without a subspace, such as the
+   *    synthetic galleries of the benchmarks. Such a gallery predicts
+   *    projections only.
+   */
+  FaceGallery(const cv::Mat& projections, const std::vector<int>& labels, double threshold, SimdLevel simd = SIMD_AVX512);
+
+  /**
+   * @return True if the gallery has no face, or its face recognizer
+   *         is not supported.
+   */
+  bool empty() const;
+
+  /**
+   * @return Number of faces of the gallery.
+   */
+  int getSize() const;
+
+  /**
+   * @return Number of dimensions of the subspace.
+   */
+  int getDimensions() const;
+
+  /**
+   * @return SIMD kernels of the search.
+   */
+  SimdLevel getSimdLevel() const;
+
+  /**
+   * @param simd SIMD kernels of the search, narrowed to those 
+   *        supported by the CPU.
+   */
+  void setSimdLevel(SimdLevel simd);
+
+  /**
+   * @return Storage of the projections scanned.
+   */
+  GalleryStorage getStorage() const;
+
+  /**
+   * @return Number of the closest faces of a quantized gallery
+   *         compared again in double precision.
+   */
+  int getRerank() const;
+
+  /**
+   * @return Bytes of the projections held for the search.
+   */
+  size_t getMemorySize() const;
+
+  /**
+   * @param storage Storage of the projections scanned.
+   * @param rerank Number of the closest faces of the quantized
+   *        gallery compared again in double precision, "0" to take
+   *        the closest quantized face.
+   *
+   * @brief
+   *    Quantize the gallery in half precision, or in 8-bit integers
+   *    scaled per dimension. The rows in single precision and the
+   *    index built on them are released, and so are the projections
+   *    in double precision without reranking. A gallery is quantized
+   *    at most once.
+   */
+  void quantize(GalleryStorage storage, int rerank);
+
+  /**
+   * @param lists Number of lists of the index.
+   *
+   * @brief
+   *    Build an inverted file index over the gallery.
+   */
+  void buildIndex(int lists);
+
+  /**
+   * @param filename Path to the index file.
+   * @return True if the index is loaded, and false if the file does
+   *         not exist, cannot be read or is of another gallery.
+   */
+  bool loadIndex(const std::string& filename);
+
+  /**
+   * @param filename Path to the index file.
+   * @return True if the index is saved.
+   */
+  bool saveIndex(const std::string& filename) const;
+
+  /**
+   * @return Number of lists of the index, or "0" if the gallery has
+   *         no index.
+   */
+  int getIndexLists() const;
+
+  /**
+   * @return Number of lists of the index probed for each face.
+   */
+  int getIndexProbes() const;
+
+  /**
+   * @param probes Number of lists of the index probed for each face,
+   *        "0" to scan the whole gallery even with an index.
+   */
+  void setIndexProbes(int probes);
+
+  /**
+   * @param faces Normalized faces, all of the size of the training
+   *        faces.
+   * @param projections Variable to store the projections of the
+   *        faces, one row per face, in "CV_64F".
+   *
+   * @brief
+   *    Project a batch of faces into the subspace, by a single matrix
+   *    multiplication.
+   */
+  void project(const std::vector<cv::Mat>& faces, cv::Mat& projections) const;
+
+  /**
+   * @param faces Normalized faces, all of the size of the training
+   *        faces.
+   * @param labels Array to store the label predicted for each face,
+   *        or "-1" if no face of the gallery is within the threshold.
+   * @param distances Array to store the distance of each face to the
+   *        closest face of the gallery.
+   *
+   * @brief
+   *    Predict the labels of a batch of faces, as the face recognizer
+   *    does for each of them, or among the lists of the index probed
+   *    if the gallery has an index.
+   */
+  void predict(const std::vector<cv::Mat>& faces, std::vector<int>& labels, std::vector<double>& distances) const;
+
+  /**
+   * @param projections Projections of faces, one row per face.
+   * @param labels Array to store the label predicted for each face,
+   *        or "-1" if no face of the gallery is within the threshold.
+   * @param distances Array to store the distance of each face to the
+   *        closest face of the gallery.
+   *
+   * @brief
+   *    Predict the labels of a batch of faces already projected.
+   */
+  void predictProjections(const cv::Mat& projections, std::vector<int>& labels, std::vector<double>& distances) const;
+
+private:
+  void layoutProjections();
+  void computeDistances(int begin, int count, const float* query, float* squaredDistances) const;
+  std::string computeKey() const;
+  void searchNearest(const cv::Mat& query, const int* ids, const float* squaredDistances, int count, int& label, double& distance) const;
+  void searchQuantized(const cv::Mat& query, const float* squaredDistances, int count, int& label, double& distance) const;
+
+  cv::Mat _mean;                // Mean face, one row in "CV_64F"
+  cv::Mat _eigenvectors;        // Basis of the subspace, one column per dimension
+  int _dimensions;              // Number of dimensions of the subspace
+  cv::Mat _projections;         // Projections of the gallery faces, one row per face
+  cv::Mat _buffer;              // Memory of the aligned projections below
+  cv::Mat _aligned;             // Projections in "CV_32F", aligned and padded rows
+  cv::Mat _quantizedBuffer;     // Memory of the quantized projections below
+  cv::Mat _quantized;           // Projections in "CV_16U" halves or "CV_8S", aligned and padded rows
+  cv::Mat _scaleBuffer;         // Memory of the scales below
+  cv::Mat _scales;              // Scale of each dimension of the "CV_8S" projections, aligned row
+  double _maxNorm;              // Largest norm of the projections
+  std::vector<int> _labels;     // Labels of the gallery faces
+  double _threshold;            // Largest distance to predict a label
+  SimdLevel _simd;              // SIMD kernels of the search
+  GalleryStorage _storage;      // Storage of the projections scanned
+  int _rerank;                  // Closest quantized faces compared again in double precision
+  FaceIndex _index;             // Inverted file index, if any
+  int _probes;                  // Lists of the index probed for each face
+};
+
+
+/**
+ * @param dir_data Path to the face database.
+ * @param lists Number of lists of the index.
+ * @param gallery Gallery of the face recognizer of the face database.
+ *
+ * @brief
+ *    Load the index of the gallery cached as "<dir_data>/index.yml"
+ *    if it is of the gallery and has as many lists, or build it and
+ *    cache it for the later runs otherwise.
+ */
+void loadFaceGalleryIndex(const std::string& dir_data, int lists, FaceGallery& gallery);
+
+
+#endif // FACEREC_FACE_GALLERY_HPP
@@ -0,0 +1,214 @@
+/**
+ * Inverted file index of the face gallery.
+ *
+ * Author:  David Qiu.
+ * Email:   david@davidqiu.com
+ * Email:   dicong.qiu@intel.com
+ * Website: http://www.davidqiu.com/
+ *
+ * Copyright (C) 2014, David Qiu. All rights reserved.
+ */
+
+#include "FaceIndex.hpp"
+
+#include <iostream>
+#include <algorithm>
+#include <utility>
+#include <cstdio>
+#include <unistd.h>
+using namespace cv;
+using namespace std;
+
+
+FaceIndex::FaceIndex()
+  : _dimensions(0)
+{
+}
+
+
+bool FaceIndex::empty() const
+{
+  return _centroids.rows == 0;
+}
+
+
+int FaceIndex::getLists() const
+{
+  return _centroids.rows;
+}
+
+
+void FaceIndex::build(const Mat& vectors, int dimensions, int lists, const string& key)
+{
+  CV_Assert(vectors.type() == CV_32F && vectors.rows > 0 && dimensions <= vectors.cols);
+  lists = std::max(1, std::min(lists, vectors.rows));
+
+  // Cluster the projections, the zero padding of the rows leaving
+  // the distances unchanged
+  Mat assignments;
+  Mat centroids;
+  kmeans(vectors, lists, assignments,
+         TermCriteria(TermCriteria::COUNT + TermCriteria::EPS, FACE_INDEX_ITERATIONS, 1e-4),
+         1, KMEANS_PP_CENTERS, centroids);
+
+  _key = key;
+  _dimensions = dimensions;
+  layout(vectors, centroids, assignments);
+}
+
+
+bool FaceIndex::load(const string& filename, const Mat& vectors, int dimensions, const string& key)
+{
+  // Check if the index file exists
+  if ( !(access(filename.c_str(), 0)==0) ) return false;
+
+  Mat centroids;
+  Mat assignments;
+  try
+  {
+    // Open the index file
+    FileStorage fs(filename, FileStorage::READ);
+    if (!fs.isOpened()) return false;
+
+    // Check if the index is of the gallery
+    if ((string)fs["key"] != key || (int)fs["dimensions"] != dimensions) return false;
+
+    // Read the centroids and the list of each face
+    fs["centroids"] >> centroids;
+    fs["assignments"] >> assignments;
+  }
+  catch (cv::Exception& e)
+  {
+    cerr << "[WARNING] Cannot load the gallery index \"" << filename << "\". Reason: " << e.msg << endl;
+    return false;
+  }
+
+  // Validate the lists
+  if (centroids.empty() || centroids.type() != CV_32F || centroids.cols != dimensions) return false;
+  if (assignments.type() != CV_32S || assignments.total() != (size_t)vectors.rows) return false;
+  for (int i=0; i<vectors.rows; ++i)
+  {
+    int list = assignments.at<int>(i);
+    if (list < 0 || list >= centroids.rows) return false;
+  }
+
+  _key = key;
+  _dimensions = dimensions;
+  layout(vectors, centroids, assignments);
+  return true;
+}
+
+
+bool FaceIndex::save(const string& filename) const
+{
+  if (empty()) return false;
+
+  // Obtain the temporary file name
+  string tmpFilename = format("%s.%d.tmp", filename.c_str(), (int)getpid());
+
+  try
+  {
+    // Open the temporary index file
+    FileStorage fs(tmpFilename, FileStorage::WRITE);
+    if (!fs.isOpened()) return false;
+
+    // Write the key of the gallery, the centroids and the list of
+    // each face
+    fs << "key" << _key;
+    fs << "dimensions" << _dimensions;
+    fs << "centroids" << _centroids.colRange(0, _dimensions).clone();
+    fs << "assignments" << _assignments;
+    fs.release();
+  }
+  catch (cv::Exception& e)
+  {
+    cerr << "[WARNING] Cannot save the gallery index \"" << filename << "\". Reason: " << e.msg << endl;
+    remove(tmpFilename.c_str());
+    return false;
+  }
+
+  // Replace the index file
+  if (rename(tmpFilename.c_str(), filename.c_str()) != 0)
+  {
+    remove(tmpFilename.c_str());
+    return false;
+  }
+
+  return true;
+}
+
+
+void FaceIndex::search(const float* query, int probes, SimdLevel simd, vector<int>& ids, vector<float>& squaredDistances) const
+{
+  ids.clear();
+  squaredDistances.clear();
+  if (empty()) return;
+
+  // Rank the centroids by their distance to the face
+  int lists = _centroids.rows;
+  int stride = _centroids.cols;
+  probes = std::max(1, std::min(probes, lists));
+  vector<float> centroidDistances(lists);
+  computeGalleryDistances(_centroids.ptr<float>(), lists, stride, query, &centroidDistances[0], simd);
+  vector< pair<float, int> > ranks(lists);
+  for (int l=0; l<lists; ++l) ranks[l] = make_pair(centroidDistances[l], l);
+  std::partial_sort(ranks.begin(), ranks.begin() + probes, ranks.end());
+
+  // Compare the face with the faces of the closest lists
+  for (int p=0; p<probes; ++p)
+  {
+    int list = ranks[p].second;
+    int begin = _offsets[list];
+    int count = _offsets[list + 1] - begin;
+    if (count == 0) continue;
+
+    size_t start = ids.size();
+    ids.insert(ids.end(), _ids.begin() + begin, _ids.begin() + begin + count);
+    squaredDistances.resize(start + count);
+    computeGalleryDistances(_vectors.ptr<float>(begin), count, stride, query, &squaredDistances[start], simd);
+  }
+}
+
+
+/**
+ * @param vectors Projections of the gallery, in aligned rows.
+ * @param centroids Centroids of the lists, one row per list, of at
+ *        least the dimensions of the projections.
+ * @param assignments List of each face of the gallery.
+ *
+ * @brief
+ *    Lay out the centroids, and the projections of the faces list
+ *    after list, each list in the order of the gallery, in the
+ *    aligned rows of the SIMD kernels.
+ */
+void FaceIndex::layout(const Mat& vectors, const Mat& centroids, const Mat& assignments)
+{
+  int lists = centroids.rows;
+  int count = vectors.rows;
+
+  // Copy the centroids into the aligned rows
+  allocateGalleryRows(lists, _dimensions, _centroidBuffer, _centroids);
+  for (int l=0; l<lists; ++l)
+  {
+    Mat alignedRow = _centroids.row(l).colRange(0, _dimensions);
+    centroids.row(l).colRange(0, _dimensions).copyTo(alignedRow);
+  }
+
+  // Count the faces of each list, and find where each list starts
+  _assignments = assignments.reshape(1, 1).clone();
+  _offsets.assign(lists + 1, 0);
+  for (int i=0; i<count; ++i) _offsets[_assignments.at<int>(i) + 1]++;
+  for (int l=0; l<lists; ++l) _offsets[l + 1] += _offsets[l];
+
+  // Place the faces into their lists
+  vector<int> next(_offsets.begin(), _offsets.end() - 1);
+  _ids.resize(count);
+  for (int i=0; i<count; ++i) _ids[next[_assignments.at<int>(i)]++] = i;
+  allocateGalleryRows(count, _dimensions, _buffer, _vectors);
+  CV_Assert(_vectors.cols == vectors.cols);
+  for (int k=0; k<count; ++k)
+  {
+    Mat alignedRow = _vectors.row(k);
+    vectors.row(_ids[k]).copyTo(alignedRow);
+  }
+}
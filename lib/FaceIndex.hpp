@@ -0,0 +1,135 @@
+/**
+ * Inverted file index of the face gallery. The projections of the
+ * gallery are clustered by k-means into lists around coarse
+ * centroids, so that a face is compared with the lists of the few
+ * centroids closest to it instead of the whole gallery. The number
+ * of lists probed trades the recall of the closest face for the
+ * time of the search. The lists are laid out one after another in
+ * the aligned rows of the SIMD kernels of "GallerySimd.hpp".
+ *
+ * Author:  David Qiu.
+ * Email:   david@davidqiu.com
+ * Email:   dicong.qiu@intel.com
+ * Website: http://www.davidqiu.com/
+ *
+ * Copyright (C) 2014, David Qiu. All rights reserved.
+ */
+
+#ifndef FACEREC_FACE_INDEX_HPP
+#define FACEREC_FACE_INDEX_HPP
+
+#include "opencv2/core/core.hpp"
+
+#include "GallerySimd.hpp"
+
+#include <string>
+#include <vector>
+
+
+/**
+ * @brief
+ *   Iterations of the k-means clustering building the lists.
+ */
+const int FACE_INDEX_ITERATIONS = 20;
+
+
+/**
+ * @brief
+ *   Number of lists probed for each face by default.
+ */
+const int FACE_INDEX_PROBES = 8;
+
+
+/**
+ * @brief
+ *   Inverted file index over the projections of a face gallery.
+ */
+class FaceIndex
+{
+public:
+  /**
+   * @brief
+   *    Create an empty index.
+   */
+  FaceIndex();
+
+  /**
+   * @return True if the index has no list.
+   */
+  bool empty() const;
+
+  /**
+   * @return Number of lists of the index.
+   */
+  int getLists() const;
+
+  /**
+   * @param vectors Projections of the gallery, in the aligned rows
+   *        of "allocateGalleryRows()".
+   * @param dimensions Number of dimensions of the projections.
+   * @param lists Number of lists, narrowed to the number of faces.
+   * @param key Key of the gallery, recorded to match the index
+   *        with the gallery when it is loaded.
+   *
+   * @brief
+   *    Build the index by clustering the projections with k-means.
+   */
+  void build(const cv::Mat& vectors, int dimensions, int lists, const std::string& key);
+
+  /**
+   * @param filename Path to the index file.
+   * @param vectors Projections of the gallery, in the aligned rows
+   *        of "allocateGalleryRows()".
+   * @param dimensions Number of dimensions of the projections.
+   * @param key Key of the gallery.
+   * @return True if the index is loaded, and false if the file does
+   *         not exist, cannot be read or is of another gallery.
+   *
+   * @brief
+   *    Load the centroids and the lists of an index saved by save(),
+   *    and lay out the lists again from the gallery.
+   */
+  bool load(const std::string& filename, const cv::Mat& vectors, int dimensions, const std::string& key);
+
+  /**
+   * @param filename Path to the index file.
+   * @return True if the index is saved.
+   *
+   * @brief
+   *    Save the centroids and the list of each face, through a
+   *    temporary file renamed over the index file, so that a reader
+   *    never sees a partial index.
+   */
+  bool save(const std::string& filename) const;
+
+  /**
+   * @param query Projection of a face, aligned and padded as the
+   *        rows of the gallery.
+   * @param probes Number of lists to compare the face with.
+   * @param simd SIMD kernels, which must be supported by the CPU.
+   * @param ids Array to store the indices in the gallery of the
+   *        faces compared, in the order of the lists probed.
+   * @param squaredDistances Array to store the squared distances
+   *        in single precision to the faces compared.
+   *
+   * @brief
+   *    Compare a face with the lists of the centroids closest to it.
+   */
+  void search(const float* query, int probes, SimdLevel simd, std::vector<int>& ids, std::vector<float>& squaredDistances) const;
+
+private:
+  void layout(const cv::Mat& vectors, const cv::Mat& centroids, const cv::Mat& assignments);
+
+  std::string _key;             // Key of the gallery indexed
+  int _dimensions;              // Number of dimensions of the projections
+  cv::Mat _assignments;         // List of each face, one row in "CV_32S"
+  cv::Mat _centroidBuffer;      // Memory of the centroids below
+  cv::Mat _centroids;           // Centroids of the lists, aligned and padded rows
+  std::vector<int> _offsets;    // Start of each list, and the end of the last one
+  std::vector<int> _ids;        // Indices in the gallery of the faces of the lists
+  cv::Mat _buffer;              // Memory of the lists below
+  cv::Mat _vectors;             // Projections of the faces of the lists, aligned and padded rows
+};
+
+
+#endif // FACEREC_FACE_INDEX_HPP
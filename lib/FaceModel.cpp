@@ -0,0 +1,148 @@
+/**
+ * Face recognizer trained on the face database.
+ *
+ * Author:  David Qiu.
+ * Email:   david@davidqiu.com
+ * Email:   dicong.qiu@intel.com
+ * Website: http://www.davidqiu.com/
+ *
+ * Copyright (C) 2014, David Qiu. All rights reserved.
+ */
+
+#include "FaceModel.hpp"
+#include "FaceDatabase.hpp"
+
+#include <iostream>
+#include <cstdio>
+#include <unistd.h>
+using namespace cv;
+using namespace std;
+
+
+Ptr<FaceRecognizer> createFaceRecognizer(const string& backend)
+{
+  if (backend == "eigenfaces") return createEigenFaceRecognizer();
+  if (backend == "fisherfaces") return createFisherFaceRecognizer();
+  if (backend == "lbph") return createLBPHFaceRecognizer();
+  CV_Error(CV_StsBadArg, "Unknown face recognizer backend " + backend + ", expected eigenfaces, fisherfaces or lbph.");
+  return Ptr<FaceRecognizer>();
+}
+
+
+bool loadFaceModel(const string& filename, const string& fingerprint, Ptr<FaceRecognizer>& model, map<int, string>& names)
+{
+  // Clear the result container
+  names.clear();
+
+  // Check if the cached model exists
+  if ( !(access(filename.c_str(), 0)==0) ) return false;
+
+  try
+  {
+    // Open the cached model file
+    FileStorage fs(filename, FileStorage::READ);
+    if (!fs.isOpened()) return false;
+
+    // Check if the cached model is up to date and of the backend
+    string cachedFingerprint = (string)fs["fingerprint"];
+    if (cachedFingerprint != fingerprint) return false;
+    string cachedRecognizer = (string)fs["recognizer"];
+    if (cachedRecognizer != model->name()) return false;
+
+    // Read the mapping from label to name
+    FileNode fnNames = fs["names"];
+    for (FileNodeIterator it=fnNames.begin(); it!=fnNames.end(); ++it)
+    {
+      names.insert( pair<int, string>((int)(*it)["label"], (string)(*it)["name"]) );
+    }
+
+    // Read the face recognizer model
+    model->load(fs);
+  }
+  catch (cv::Exception& e)
+  {
+    cerr << "[WARNING] Cannot load the cached face recognizer \"" << filename << "\". Reason: " << e.msg << endl;
+    names.clear();
+    return false;
+  }
+
+  return true;
+}
+
+
+bool saveFaceModel(const string& filename, const string& fingerprint, const Ptr<FaceRecognizer>& model, const map<int, string>& names)
+{
+  // Obtain the temporary file name
+  string tmpFilename = format("%s.%d.tmp", filename.c_str(), (int)getpid());
+
+  try
+  {
+    // Open the temporary model file
+    FileStorage fs(tmpFilename, FileStorage::WRITE);
+    if (!fs.isOpened()) return false;
+
+    // Write the fingerprint, the backend and the mapping from label 
+    // to name
+    fs << "fingerprint" << fingerprint;
+    fs << "recognizer" << model->name();
+    fs << "names" << "[";
+    for (map<int, string>::const_iterator it=names.begin(); it!=names.end(); ++it)
+    {
+      fs << "{" << "label" << it->first << "name" << it->second << "}";
+    }
+    fs << "]";
+
+    // Write the face recognizer model
+    model->save(fs);
+    fs.release();
+  }
+  catch (cv::Exception& e)
+  {
+    cerr << "[WARNING] Cannot cache the face recognizer \"" << filename << "\". Reason: " << e.msg << endl;
+    remove(tmpFilename.c_str());
+    return false;
+  }
+
+  // Replace the cached model
+  if (rename(tmpFilename.c_str(), filename.c_str()) != 0)
+  {
+    remove(tmpFilename.c_str());
+    return false;
+  }
+
+  return true;
+}
+
+
+Ptr<FaceRecognizer> loadFaceRecognizer(const string& dir_data, const FaceRecConfig& config, map<int, string>& names)
+{
+  // Obtain the fingerprint of the face database
+  string fn_model = dir_data + "/model.yml";
+  string fingerprint = computeFaceDataFingerprint(dir_data);
+
+  // Load the cached face recognizer if it is up to date
+  Ptr<FaceRecognizer> model = createFaceRecognizer(config.predictBackend);
+  if (loadFaceModel(fn_model, fingerprint, model, names))
+  {
+    cout << "[INFO] Face recognizer loaded from \"" << fn_model << "\"." << endl;
+    return model;
+  }
+
+  // Load the face database
+  vector<Mat> images;
+  vector<int> labels;
+  loadFaceData(dir_data, images, labels, names, config.loaderThreads);
+  cout << "[INFO] Face database loaded." << endl;
+
+  // Train the face recognizer
+  model->train(images, labels);
+  cout << "[INFO] Face recognizer trained." << endl;
+
+  // Cache the face recognizer for the later runs
+  if (saveFaceModel(fn_model, fingerprint, model, names))
+  {
+    cout << "[INFO] Face recognizer cached as \"" << fn_model << "\"." << endl;
+  }
+
+  return model;
+}
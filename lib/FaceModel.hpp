@@ -0,0 +1,89 @@
+/**
+ * Face recognizer trained on the face database. The trained face 
+ * recognizer is cached in the face database together with the 
+ * mapping from label to name, and reused as long as the face 
+ * database is unchanged.
+ *
+ * Author:  David Qiu.
+ * Email:   david@davidqiu.com
+ * Email:   dicong.qiu@intel.com
+ * Website: http://www.davidqiu.com/
+ *
+ * Copyright (C) 2014, David Qiu. All rights reserved.
+ */
+
+#ifndef FACEREC_FACE_MODEL_HPP
+#define FACEREC_FACE_MODEL_HPP
+
+#include "opencv2/core/core.hpp"
+#include "opencv2/contrib/contrib.hpp"
+
+#include "FaceRecConfig.hpp"
+
+#include <map>
+#include <string>
+
+
+/**
+ * @param backend Name of a face recognizer backend, "eigenfaces", 
+ *        "fisherfaces" or "lbph".
+ * @return A new untrained face recognizer of the backend.
+ *
+ * @brief
+ *    Create the face recognizer of a backend. It throws 
+ *    cv::Exception if the backend is unknown.
+ */
+cv::Ptr<cv::FaceRecognizer> createFaceRecognizer(const std::string& backend);
+
+
+/**
+ * @param filename Path to the cached face recognizer model.
+ * @param fingerprint Fingerprint of the current face database.
+ * @param model Face recognizer to load the cached model into.
+ * @param names Mapping from label to name of the face.
+ * @return True if the cached model exists and matches the 
+ *         fingerprint and the backend, and false otherwise.
+ *
+ * @brief
+ *    Load a face recognizer model cached by saveFaceModel(). The 
+ *    cache is rejected if it was trained on a different state of 
+ *    the face database, or by another backend than the one of the 
+ *    face recognizer to load it into.
+ */
+bool loadFaceModel(const std::string& filename, const std::string& fingerprint, cv::Ptr<cv::FaceRecognizer>& model, std::map<int, std::string>& names);
+
+
+/**
+ * @param filename Path to cache the face recognizer model.
+ * @param fingerprint Fingerprint of the face database trained on.
+ * @param model Trained face recognizer.
+ * @param names Mapping from label to name of the face.
+ * @return True if the model is cached successfully, and false 
+ *         otherwise.
+ *
+ * @brief
+ *    Cache a trained face recognizer model together with the label 
+ *    to name mapping. The model is written to a temporary file 
+ *    first and then renamed, so that concurrent runs never read a 
+ *    partially written cache.
+ */
+bool saveFaceModel(const std::string& filename, const std::string& fingerprint, const cv::Ptr<cv::FaceRecognizer>& model, const std::map<int, std::string>& names);
+
+
+/**
+ * @param dir_data Path to the face database.
+ * @param config Deployment configuration.
+ * @param names Mapping from label to name of the face.
+ * @return The face recognizer.
+ *
+ * @brief
+ *    Load the cached face recognizer if it is up to date, or load 
+ *    the face database, train a new face recognizer and cache it. 
+ *    The face recognizer is of the backend of the configuration. 
+ *    It throws cv::Exception if the face database cannot be read 
+ *    or the backend is unknown.
+ */
+cv::Ptr<cv::FaceRecognizer> loadFaceRecognizer(const std::string& dir_data, const FaceRecConfig& config, std::map<int, std::string>& names);
+
+
+#endif // FACEREC_FACE_MODEL_HPP
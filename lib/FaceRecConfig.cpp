@@ -0,0 +1,150 @@
+/**
+ * Deployment configuration of the face recognition applications.
+ *
+ * Author:  David Qiu.
+ * Email:   david@davidqiu.com
+ * Email:   dicong.qiu@intel.com
+ * Website: http://www.davidqiu.com/
+ *
+ * Copyright (C) 2014, David Qiu. All rights reserved.
+ */
+
+#include "FaceRecConfig.hpp"
+
+#include "opencv2/core/core.hpp"
+
+#include <iostream>
+#include <unistd.h>
+using namespace cv;
+using namespace std;
+
+
+FaceRecConfig::FaceRecConfig()
+  : loaderThreads(0), 
+    enrollBatchSize(5), 
+    enrollIdleSeconds(2.0), 
+    serverSocket(""), 
+    serverThreads(0), 
+    serverCheckSeconds(2.0), 
+    batchThreads(0), 
+    detectMaxSide(0), 
+    detectMinFace(0), 
+    detectScaleFactor(1.1), 
+    detectMinNeighbors(3), 
+    detectMinSize(0), 
+    detectMaxSize(0), 
+    detectThreads(1), 
+    detectTileSize(0), 
+    detectMemoryMB(0), 
+    detectCompiled(0), 
+    detectSimd("auto"), 
+    detectBackend("haar"), 
+    detectLbpCascade("lbpcascade_frontalface.xml"), 
+    trackInterval(0), 
+    trackMargin(0.5), 
+    predictBackend("fisherfaces"), 
+    predictSimd("auto"), 
+    predictIndexLists(0), 
+    predictIndexProbes(8), 
+    predictStorage("float32"), 
+    predictRerank(16), 
+    motionThreshold(0), 
+    motionMinArea(100), 
+    motionScanInterval(300)
+{
+}
+
+
+/**
+ * @param node File node of the configuration entry.
+ * @param value Value to overwrite if the entry exists.
+ *
+ * @brief
+ *    Read an optional integer configuration entry.
+ */
+static void readConfigEntry(const FileNode& node, int& value)
+{
+  if (!node.isNone()) node >> value;
+}
+
+
+/**
+ * @param node File node of the configuration entry.
+ * @param value Value to overwrite if the entry exists.
+ *
+ * @brief
+ *    Read an optional real number configuration entry.
+ */
+static void readConfigEntry(const FileNode& node, double& value)
+{
+  if (!node.isNone()) node >> value;
+}
+
+
+/**
+ * @param node File node of the configuration entry.
+ * @param value Value to overwrite if the entry exists.
+ *
+ * @brief
+ *    Read an optional string configuration entry.
+ */
+static void readConfigEntry(const FileNode& node, string& value)
+{
+  if (!node.isNone()) node >> value;
+}
+
+
+bool loadFaceRecConfig(const string& datapath, FaceRecConfig& config)
+{
+  // Check if the configuration file exists
+  string filename = datapath + "/config.yml";
+  if ( !(access(filename.c_str(), 0)==0) ) return false;
+
+  // Open the configuration file
+  FileStorage fs;
+  try
+  {
+    fs.open(filename, FileStorage::READ);
+  }
+  catch (cv::Exception& e)
+  {
+    cerr << "[WARNING] Cannot parse the configuration \"" << filename << "\". Reason: " << e.msg << endl;
+    return false;
+  }
+  if (!fs.isOpened()) return false;
+
+  // Read the configuration entries
+  readConfigEntry(fs["loader_threads"], config.loaderThreads);
+  readConfigEntry(fs["enroll_batch_size"], config.enrollBatchSize);
+  readConfigEntry(fs["enroll_idle_seconds"], config.enrollIdleSeconds);
+  readConfigEntry(fs["server_socket"], config.serverSocket);
+  readConfigEntry(fs["server_threads"], config.serverThreads);
+  readConfigEntry(fs["server_check_seconds"], config.serverCheckSeconds);
+  readConfigEntry(fs["batch_threads"], config.batchThreads);
+  readConfigEntry(fs["detect_max_side"], config.detectMaxSide);
+  readConfigEntry(fs["detect_min_face"], config.detectMinFace);
+  readConfigEntry(fs["detect_scale_factor"], config.detectScaleFactor);
+  readConfigEntry(fs["detect_min_neighbors"], config.detectMinNeighbors);
+  readConfigEntry(fs["detect_min_size"], config.detectMinSize);
+  readConfigEntry(fs["detect_max_size"], config.detectMaxSize);
+  readConfigEntry(fs["detect_threads"], config.detectThreads);
+  readConfigEntry(fs["detect_tile_size"], config.detectTileSize);
+  readConfigEntry(fs["detect_memory_mb"], config.detectMemoryMB);
+  readConfigEntry(fs["detect_compiled"], config.detectCompiled);
+  readConfigEntry(fs["detect_simd"], config.detectSimd);
+  readConfigEntry(fs["detect_backend"], config.detectBackend);
+  readConfigEntry(fs["detect_lbp_cascade"], config.detectLbpCascade);
+  readConfigEntry(fs["track_interval"], config.trackInterval);
+  readConfigEntry(fs["track_margin"], config.trackMargin);
+  readConfigEntry(fs["predict_backend"], config.predictBackend);
+  readConfigEntry(fs["predict_simd"], config.predictSimd);
+  readConfigEntry(fs["predict_index_lists"], config.predictIndexLists);
+  readConfigEntry(fs["predict_index_probes"], config.predictIndexProbes);
+  readConfigEntry(fs["predict_storage"], config.predictStorage);
+  readConfigEntry(fs["predict_rerank"], config.predictRerank);
+  readConfigEntry(fs["motion_threshold"], config.motionThreshold);
+  readConfigEntry(fs["motion_min_area"], config.motionMinArea);
+  readConfigEntry(fs["motion_scan_interval"], config.motionScanInterval);
+
+  return true;
+}
@@ -0,0 +1,75 @@
+/**
+ * Deployment configuration of the face recognition applications. 
+ * The configuration is read from the optional file 
+ * "<data_path>/config.yml", and every entry missing from the file 
+ * keeps its default value.
+ *
+ * Author:  David Qiu.
+ * Email:   david@davidqiu.com
+ * Email:   dicong.qiu@intel.com
+ * Website: http://www.davidqiu.com/
+ *
+ * Copyright (C) 2014, David Qiu. All rights reserved.
+ */
+
+#ifndef FACEREC_FACE_REC_CONFIG_HPP
+#define FACEREC_FACE_REC_CONFIG_HPP
+
+#include <string>
+
+
+/**
+ * @brief
+ *   Configuration of the face recognition applications.
+ */
+struct FaceRecConfig
+{
+  int loaderThreads;        // Worker threads loading the face images, "0" for one per CPU
+  int enrollBatchSize;      // Captured faces to trigger a retrain in FaceCollection
+  double enrollIdleSeconds; // Idle time to retrain the pending captured faces
+  std::string serverSocket; // Socket of the recognition server, "" for "<data_path>/server.sock"
+  int serverThreads;        // Worker threads of the recognition server, "0" for one per CPU
+  double serverCheckSeconds; // Interval of the server checks for changes of the face database, "0" for never
+  int batchThreads;         // Worker threads of the batch recognition, "0" for one per CPU
+  int detectMaxSide;        // Longest side of the image for face detection, "0" for full resolution
+  int detectMinFace;        // Smallest face to detect in pixels, "0" for any size
+  double detectScaleFactor; // Scale between the levels of the detection pyramid
+  int detectMinNeighbors;   // Neighbor detections to keep a face
+  int detectMinSize;        // Smallest face size in pixels, "0" for no bound
+  int detectMaxSize;        // Largest face size in pixels, "0" for no bound
+  int detectThreads;        // Threads detecting the pyramid levels of an image, "0" for one per CPU
+  int detectTileSize;       // Side of the tiles of the tiled detection in pixels, "0" for no tiling
+  int detectMemoryMB;       // Working memory of the tiled detection in MB, "0" for no bound
+  int detectCompiled;       // Whether to detect with the cascade compiled into the binary, if any
+  std::string detectSimd;   // SIMD kernels of the compiled cascade, "auto" for the widest supported
+  std::string detectBackend; // Face detecter backend, "haar" or "lbp"
+  std::string detectLbpCascade; // LBP cascade of the "lbp" backend, relative to the Haar cascade
+  int trackInterval;        // Frames between full-frame scans of FaceCollection, "0" for no tracking
+  double trackMargin;       // Margin around a tracked face to search, relative to the face size
+  std::string predictBackend; // Face recognizer backend, "eigenfaces", "fisherfaces" or "lbph"
+  std::string predictSimd;  // SIMD kernels of the face gallery search, "auto" for the widest supported
+  int predictIndexLists;    // Lists of the inverted file index of the face gallery, "0" for an exact scan
+  int predictIndexProbes;   // Lists of the index probed for each face
+  std::string predictStorage; // Storage of the face gallery, "float32", "float16" or "int8"
+  int predictRerank;        // Closest faces of a quantized face gallery compared again exactly, "0" for none
+  int motionThreshold;      // Gray levels of a pixel changed from the background, "0" for no motion gating
+  int motionMinArea;        // Smallest changed region in pixels of the detection frame
+  int motionScanInterval;   // Frames between full-frame scans of the motion gating, "0" for none
+
+  FaceRecConfig();
+};
+
+
+/**
+ * @param datapath Path to face database directory.
+ * @param config Configuration to fill in.
+ * @return True if the configuration file exists and is read, and 
+ *         false if the default configuration is used.
+ *
+ * @brief
+ *    Load the configuration from "<datapath>/config.yml". 
+ */
+bool loadFaceRecConfig(const std::string& datapath, FaceRecConfig& config);
+
+
+#endif // FACEREC_FACE_REC_CONFIG_HPP
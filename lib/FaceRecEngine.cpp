@@ -0,0 +1,230 @@
+/**
+ * Face recognition engine.
+ *
+ * Author:  David Qiu.
+ * Email:   david@davidqiu.com
+ * Email:   dicong.qiu@intel.com
+ * Website: http://www.davidqiu.com/
+ *
+ * Copyright (C) 2014, David Qiu. All rights reserved.
+ */
+
+#include "FaceRecEngine.hpp"
+#include "FaceCascade.hpp"
+#include "FaceDatabase.hpp"
+#include "FaceDetection.hpp"
+#include "FaceModel.hpp"
+
+#include "opencv2/imgproc/imgproc.hpp"
+
+#include <climits>
+#include <unistd.h>
+using namespace cv;
+using namespace std;
+
+
+Mat normalizeFace(const Mat& gray, const Rect& face)
+{
+  Mat face_resized;
+  cv::resize(gray(face), face_resized, Size(STD_FACE_REC_SIZE, STD_FACE_REC_SIZE), 1.0, 1.0, INTER_CUBIC);
+  return face_resized;
+}
+
+
+FaceRecEngine::FaceRecEngine(const string& cascadePath, const string& dataPath)
+{
+  loadFaceRecConfig(dataPath, _config);
+  open(cascadePath, dataPath);
+}
+
+
+FaceRecEngine::FaceRecEngine(const string& cascadePath, const string& dataPath, const FaceRecConfig& config)
+  : _config(config)
+{
+  open(cascadePath, dataPath);
+}
+
+
+FaceRecEngine::~FaceRecEngine()
+{
+  pthread_mutex_destroy(&_mutex);
+}
+
+
+void FaceRecEngine::open(const string& cascadePath, const string& dataPath)
+{
+  // Obtain the absolute path to the cascade
+  _cascadePath = cascadePath;
+  char cwd[PATH_MAX];
+  if (!cascadePath.empty() && cascadePath[0] != '/' && getcwd(cwd, sizeof(cwd)) != NULL)
+  {
+    _cascadePath = string(cwd) + "/" + cascadePath;
+  }
+
+  // Load the face recognizer
+  GalleryStorage storage = obtainGalleryStorage(_config.predictStorage);
+  _model = loadFaceRecognizer(dataPath, _config, _names);
+  _gallery = FaceGallery(_model, obtainSimdLevel(_config.predictSimd));
+  loadFaceGalleryIndex(dataPath, _config.predictIndexLists, _gallery);
+  _gallery.setIndexProbes(_config.predictIndexProbes);
+  if (_gallery.getIndexLists() == 0)
+  {
+    _gallery.quantize(storage, _config.predictRerank);
+  }
+
+  // Load the first face detecter
+  FaceCascade* cascade = new FaceCascade();
+  Ptr<CascadeClassifier> detector = cascade;
+  if (!loadDetectionCascade(*cascade, _cascadePath, _config))
+  {
+    CV_Error(CV_StsBadArg, "Cannot load the cascade " + obtainDetectionCascadePath(cascadePath, _config) + ".");
+  }
+  _detectors.push_back(detector);
+
+  // Create the mutex last, since the destructor is not run if any 
+  // step above throws
+  pthread_mutex_init(&_mutex, NULL);
+}
+
+
+void FaceRecEngine::recognize(const Mat& image, vector<FaceResult>& results)
+{
+  vector< vector<FaceResult> > batchResults;
+  recognize(vector<Mat>(1, image), batchResults);
+  results.swap(batchResults[0]);
+}
+
+
+void FaceRecEngine::recognize(const vector<Mat>& images, vector< vector<FaceResult> >& results)
+{
+  results.assign(images.size(), vector<FaceResult>());
+
+  // Detect the faces of all the images and normalize them
+  vector<Mat> normalized;
+  for (int k=0; k<images.size(); ++k)
+  {
+    // Convert the image to grayscale
+    Mat gray;
+    if (images[k].channels() == 3) cvtColor(images[k], gray, CV_BGR2GRAY);
+    else gray = images[k];
+
+    vector< Rect_<int> > faces;
+    detect(gray, faces);
+    for (int i=0; i<faces.size(); ++i)
+    {
+      FaceResult result;
+      result.position = faces[i];
+      result.label = -1;
+      result.confidence = 0.0;
+      results[k].push_back(result);
+      normalized.push_back(normalizeFace(gray, faces[i]));
+    }
+  }
+
+  // Recognize all the faces at once through the gallery, or one at a 
+  // time if the face recognizer has none
+  vector<int> labels(normalized.size(), -1);
+  vector<double> confidences(normalized.size(), 0.0);
+  if (!_gallery.empty())
+  {
+    _gallery.predict(normalized, labels, confidences);
+  }
+  else
+  {
+    for (int i=0; i<normalized.size(); ++i) _model->predict(normalized[i], labels[i], confidences[i]);
+  }
+
+  // Fill in the predictions in the order of the faces
+  int index = 0;
+  for (int k=0; k<results.size(); ++k)
+  {
+    for (int i=0; i<results[k].size(); ++i, ++index)
+    {
+      FaceResult& result = results[k][i];
+      result.label = labels[index];
+      result.confidence = confidences[index];
+      map<int, string>::const_iterator it = _names.find(result.label);
+      if (it != _names.end()) result.name = it->second;
+    }
+  }
+}
+
+
+void FaceRecEngine::recognize(const unsigned char* bgr, int width, int height, size_t stride, vector<FaceResult>& results)
+{
+  Mat image(height, width, CV_8UC3, (void*)bgr, stride);
+  recognize(image, results);
+}
+
+
+const string& FaceRecEngine::getCascadePath() const
+{
+  return _cascadePath;
+}
+
+
+const map<int, string>& FaceRecEngine::getNames() const
+{
+  return _names;
+}
+
+
+const FaceRecConfig& FaceRecEngine::getConfig() const
+{
+  return _config;
+}
+
+
+void FaceRecEngine::detect(const Mat& gray, vector<Rect>& faces)
+{
+  int numThreads = (_config.detectThreads > 0) ? _config.detectThreads : getNumberOfCPUs();
+  vector< Ptr<CascadeClassifier> > detectors;
+  vector<CascadeClassifier*> cascades;
+  try
+  {
+    for (int i=0; i<numThreads; ++i)
+    {
+      detectors.push_back(acquireDetector());
+      cascades.push_back(detectors.back());
+    }
+    detectFaces(cascades, gray, _config, faces);
+  }
+  catch (cv::Exception&)
+  {
+    for (int i=0; i<detectors.size(); ++i) releaseDetector(detectors[i]);
+    throw;
+  }
+  for (int i=0; i<detectors.size(); ++i) releaseDetector(detectors[i]);
+}
+
+
+Ptr<CascadeClassifier> FaceRecEngine::acquireDetector()
+{
+  // Take an idle face detecter
+  pthread_mutex_lock(&_mutex);
+  if (!_detectors.empty())
+  {
+    Ptr<CascadeClassifier> detector = _detectors.back();
+    _detectors.pop_back();
+    pthread_mutex_unlock(&_mutex);
+    return detector;
+  }
+  pthread_mutex_unlock(&_mutex);
+
+  // Load a new face detecter
+  FaceCascade* cascade = new FaceCascade();
+  Ptr<CascadeClassifier> detector = cascade;
+  if (!loadDetectionCascade(*cascade, _cascadePath, _config))
+  {
+    CV_Error(CV_StsError, "Cannot load the cascade " + obtainDetectionCascadePath(_cascadePath, _config) + ".");
+  }
+  return detector;
+}
+
+
+void FaceRecEngine::releaseDetector(const Ptr<CascadeClassifier>& detector)
+{
+  pthread_mutex_lock(&_mutex);
+  _detectors.push_back(detector);
+  pthread_mutex_unlock(&_mutex);
+}
@@ -0,0 +1,183 @@
+/**
+ * Face recognition engine. An engine owns the face recognizer 
+ * trained on a face database and the face detecter, and recognizes 
+ * the faces in images in the calling process. It is the C++ 
+ * interface of the facerec library, and the C interface in 
+ * "facerec.h" is built on it.
+ *
+ * Author:  David Qiu.
+ * Email:   david@davidqiu.com
+ * Email:   dicong.qiu@intel.com
+ * Website: http://www.davidqiu.com/
+ *
+ * Copyright (C) 2014, David Qiu. All rights reserved.
+ */
+
+#ifndef FACEREC_FACE_REC_ENGINE_HPP
+#define FACEREC_FACE_REC_ENGINE_HPP
+
+#include "opencv2/core/core.hpp"
+#include "opencv2/contrib/contrib.hpp"
+#include "opencv2/objdetect/objdetect.hpp"
+
+#include "FaceGallery.hpp"
+#include "FaceRecConfig.hpp"
+
+#include <map>
+#include <pthread.h>
+#include <string>
+#include <vector>
+
+
+/**
+ * @brief
+ *   A face recognized in an image.
+ */
+struct FaceResult
+{
+  cv::Rect position;        // Position of the face in the image
+  int label;                // Label of the face predicted
+  double confidence;        // Distance to the closest face, smaller is closer
+  std::string name;         // Name of the face predicted
+};
+
+
+/**
+ * @param gray Grayscale image.
+ * @param face Position of the face in the image.
+ * @return The face cropped and resized to the standard face size.
+ *
+ * @brief
+ *    Normalize a face for the face recognizer.
+ */
+cv::Mat normalizeFace(const cv::Mat& gray, const cv::Rect& face);
+
+
+/**
+ * @brief
+ *   Face recognition engine. The methods of an engine can be called 
+ *   from several threads at the same time.
+ */
+class FaceRecEngine
+{
+public:
+  /**
+   * @param cascadePath Path to the cascade for face detection.
+   * @param dataPath Path to the face database.
+   *
+   * @brief
+   *    Load the face recognizer of the face database, training it 
+   *    if its cache is out of date, and load the face detecter. The 
+   *    configuration is read from the face database. It throws 
+   *    cv::Exception if either cannot be loaded.
+   */
+  FaceRecEngine(const std::string& cascadePath, const std::string& dataPath);
+
+  /**
+   * @param cascadePath Path to the cascade for face detection.
+   * @param dataPath Path to the face database.
+   * @param config Configuration to use.
+   *
+   * @brief
+   *    Same as above, with the configuration given.
+   */
+  FaceRecEngine(const std::string& cascadePath, const std::string& dataPath, const FaceRecConfig& config);
+
+  ~FaceRecEngine();
+
+  /**
+   * @param image Image in BGR color or in grayscale.
+   * @param results Array to store the faces recognized.
+   *
+   * @brief
+   *    Detect and recognize all the faces in an image.
+   */
+  void recognize(const cv::Mat& image, std::vector<FaceResult>& results);
+
+  /**
+   * @param images Images in BGR color or in grayscale.
+   * @param results Array to store the faces recognized in each image.
+   *
+   * @brief
+   *    Detect all the faces in several images, and recognize them 
+   *    all at once, projected by a single matrix multiplication.
+   */
+  void recognize(const std::vector<cv::Mat>& images, std::vector< std::vector<FaceResult> >& results);
+
+  /**
+   * @param bgr Pixels of an image in BGR color, 3 bytes per pixel.
+   * @param width Width of the image.
+   * @param height Height of the image.
+   * @param stride Bytes from a row of pixels to the next.
+   * @param results Array to store the faces recognized.
+   *
+   * @brief
+   *    Detect and recognize all the faces in an image given by its 
+   *    pixels. The pixels are not copied.
+   */
+  void recognize(const unsigned char* bgr, int width, int height, size_t stride, std::vector<FaceResult>& results);
+
+  /**
+   * @return Absolute path to the cascade for face detection.
+   */
+  const std::string& getCascadePath() const;
+
+  /**
+   * @return Mapping from label to name of the face.
+   */
+  const std::map<int, std::string>& getNames() const;
+
+  /**
+   * @return The configuration in use.
+   */
+  const FaceRecConfig& getConfig() const;
+
+private:
+  FaceRecEngine(const FaceRecEngine&);
+  FaceRecEngine& operator=(const FaceRecEngine&);
+
+  /**
+   * @brief
+   *    Load the face recognizer and the face detecter.
+   */
+  void open(const std::string& cascadePath, const std::string& dataPath);
+
+  /**
+   * @param gray Image in grayscale.
+   * @param faces Array to store the positions of the faces.
+   *
+   * @brief
+   *    Find the faces of an image at the detection resolution, with 
+   *    a face detecter per detection thread.
+   */
+  void detect(const cv::Mat& gray, std::vector<cv::Rect>& faces);
+
+  /**
+   * @return A face detecter not in use by any other thread. 
+   *
+   * @brief
+   *    Take an idle face detecter, or load a new one if all of 
+   *    them are in use, since a face detecter cannot detect in two 
+   *    threads at the same time.
+   */
+  cv::Ptr<cv::CascadeClassifier> acquireDetector();
+
+  /**
+   * @param detector Face detecter taken by acquireDetector().
+   *
+   * @brief
+   *    Return a face detecter for the other threads.
+   */
+  void releaseDetector(const cv::Ptr<cv::CascadeClassifier>& detector);
+
+  std::string _cascadePath;                                 // Path to the cascade
+  FaceRecConfig _config;                                    // Configuration
+  cv::Ptr<cv::FaceRecognizer> _model;                       // Face recognizer
+  FaceGallery _gallery;                                     // Gallery of the face recognizer, for batches
+  std::map<int, std::string> _names;                        // Mapping from label to name
+  std::vector< cv::Ptr<cv::CascadeClassifier> > _detectors; // Idle face detecters
+  pthread_mutex_t _mutex;                                   // Mutex guarding the idle face detecters
+};
+
+
+#endif // FACEREC_FACE_REC_ENGINE_HPP
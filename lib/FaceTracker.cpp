@@ -0,0 +1,121 @@
+/**
+ * Face tracker.
+ *
+ * Author:  David Qiu.
+ * Email:   david@davidqiu.com
+ * Email:   dicong.qiu@intel.com
+ * Website: http://www.davidqiu.com/
+ *
+ * Copyright (C) 2014, David Qiu. All rights reserved.
+ */
+
+#include "FaceTracker.hpp"
+#include "FaceDetection.hpp"
+
+#include <algorithm>
+using namespace cv;
+using namespace std;
+
+
+/**
+ * @brief
+ *   Largest change of the face size between two frames searched for.
+ */
+const double TRACK_SIZE_CHANGE = 1.5;
+
+
+FaceTracker::FaceTracker(int scanInterval, double searchMargin)
+  : _scanInterval(scanInterval), 
+    _searchMargin(searchMargin), 
+    _framesSinceScan(0), 
+    _fullScan(true), 
+    _searchedFraction(1.0)
+{
+}
+
+
+void FaceTracker::detect(CascadeClassifier& cascade, const Mat& gray, double fscale, const FaceRecConfig& config, vector<Rect>& faces)
+{
+  faces.clear();
+  _framesSinceScan++;
+
+  // Search the regions around the faces of the previous frame
+  bool lost = _faces.empty() || _scanInterval <= 0 || _framesSinceScan >= _scanInterval;
+  Rect bounds(0, 0, gray.cols, gray.rows);
+  Mat searched;
+  if (!lost) searched = Mat::zeros(gray.rows, gray.cols, CV_8UC1);
+  for (int i=0; i<_faces.size() && !lost; ++i)
+  {
+    // Expand the face by the margin
+    const Rect& face = _faces[i];
+    int margin_x = cvRound(face.width * _searchMargin);
+    int margin_y = cvRound(face.height * _searchMargin);
+    Rect region(face.x - margin_x, face.y - margin_y, face.width + 2 * margin_x, face.height + 2 * margin_y);
+    region &= bounds;
+    if (region.area() <= 0)
+    {
+      lost = true;
+      break;
+    }
+    searched(region).setTo(Scalar(255));
+
+    // Search for faces of about the same size in the region, in 
+    // pixels of the frame
+    FaceRecConfig regionConfig = config;
+    regionConfig.detectMinSize = std::max(cvRound(config.detectMinSize * fscale), cvFloor(face.width / TRACK_SIZE_CHANGE));
+    regionConfig.detectMaxSize = cvCeil(face.width * TRACK_SIZE_CHANGE);
+    if (config.detectMaxSize > 0) regionConfig.detectMaxSize = std::min(regionConfig.detectMaxSize, cvRound(config.detectMaxSize * fscale));
+    vector<Rect> regionFaces;
+    detectFacesInScaledImage(cascade, gray(region), 1.0, regionConfig, regionFaces);
+
+    // Consider the face lost if it is not found again
+    if (regionFaces.empty())
+    {
+      lost = true;
+      break;
+    }
+    for (int j=0; j<regionFaces.size(); ++j)
+    {
+      regionFaces[j].x += region.x;
+      regionFaces[j].y += region.y;
+      faces.push_back(regionFaces[j]);
+    }
+  }
+
+  // Scan the full frame if tracking is not possible
+  if (lost)
+  {
+    faces.clear();
+    detectFacesInScaledImage(cascade, gray, fscale, config, faces);
+    _framesSinceScan = 0;
+    _fullScan = true;
+    _searchedFraction = 1.0;
+  }
+  else
+  {
+    mergeDuplicateFaces(faces);
+    _fullScan = false;
+    _searchedFraction = (double)countNonZero(searched) / std::max(bounds.area(), 1);
+  }
+
+  _faces = faces;
+}
+
+
+bool FaceTracker::isFullScan() const
+{
+  return _fullScan;
+}
+
+
+double FaceTracker::getSearchedFraction() const
+{
+  return _searchedFraction;
+}
+
+
+void FaceTracker::reset()
+{
+  _faces.clear();
+  _framesSinceScan = 0;
+}
@@ -0,0 +1,87 @@
+/**
+ * Face tracker. It detects the faces of a video stream in the 
+ * regions around the faces of the previous frame, and scans the full 
+ * frame only periodically or when a face is lost.
+ *
+ * Author:  David Qiu.
+ * Email:   david@davidqiu.com
+ * Email:   dicong.qiu@intel.com
+ * Website: http://www.davidqiu.com/
+ *
+ * Copyright (C) 2014, David Qiu. All rights reserved.
+ */
+
+#ifndef FACEREC_FACE_TRACKER_HPP
+#define FACEREC_FACE_TRACKER_HPP
+
+#include "opencv2/core/core.hpp"
+#include "opencv2/objdetect/objdetect.hpp"
+
+#include "FaceRecConfig.hpp"
+
+#include <vector>
+
+
+/**
+ * @brief
+ *   Face tracker of a video stream.
+ */
+class FaceTracker
+{
+public:
+  /**
+   * @param scanInterval Frames between two full-frame scans, or "0" 
+   *        to scan every frame.
+   * @param searchMargin Margin around a face of the previous frame 
+   *        to search, relative to the face size.
+   *
+   * @brief
+   *    Create a face tracker with no face tracked yet.
+   */
+  FaceTracker(int scanInterval, double searchMargin);
+
+  /**
+   * @param cascade Face detecter.
+   * @param gray Frame in grayscale, scaled from the original frame.
+   * @param fscale Scale from the original frame to the frame.
+   * @param config Configuration with the detection parameters.
+   * @param faces Array to store the positions of the faces in the 
+   *        frame.
+   *
+   * @brief
+   *    Detect the faces in the next frame. The regions around the 
+   *    faces of the previous frame are searched for faces of about 
+   *    the same size. The full frame is scanned instead on the first 
+   *    frame, every scan interval, when no face is tracked, and when 
+   *    a tracked face is not found again.
+   */
+  void detect(cv::CascadeClassifier& cascade, const cv::Mat& gray, double fscale, const FaceRecConfig& config, std::vector<cv::Rect>& faces);
+
+  /**
+   * @return True if the last frame was scanned in full.
+   */
+  bool isFullScan() const;
+
+  /**
+   * @return Fraction of the last frame searched for faces.
+   */
+  double getSearchedFraction() const;
+
+  /**
+   * @brief
+   *    Forget the faces tracked, so that the next frame is scanned 
+   *    in full.
+   */
+  void reset();
+
+private:
+  int _scanInterval;                // Frames between two full-frame scans
+  double _searchMargin;             // Margin around a face to search
+  int _framesSinceScan;             // Frames since the last full-frame scan
+  std::vector<cv::Rect> _faces;     // Faces of the previous frame
+  bool _fullScan;                   // Whether the last frame was scanned in full
+  double _searchedFraction;         // Fraction of the last frame searched
+};
+
+
+#endif // FACEREC_FACE_TRACKER_HPP
@@ -0,0 +1,394 @@
+/**
+ * SIMD kernels of the face gallery.
+ *
+ * Author:  David Qiu.
+ * Email:   david@davidqiu.com
+ * Email:   dicong.qiu@intel.com
+ * Website: http://www.davidqiu.com/
+ *
+ * Copyright (C) 2014, David Qiu. All rights reserved.
+ */
+
+#include "GallerySimd.hpp"
+
+#if defined(__x86_64__) || defined(__i386__)
+#define GALLERY_SIMD_X86 1
+#include <immintrin.h>
+#endif
+
+#include <algorithm>
+using namespace cv;
+
+
+GalleryStorage obtainGalleryStorage(const std::string& name)
+{
+  if (name == "float16") return GALLERY_STORAGE_FLOAT16;
+  if (name == "int8") return GALLERY_STORAGE_INT8;
+  if (name != "float32")
+  {
+    CV_Error(CV_StsBadArg, "Unknown gallery storage " + name + ", expected float32, float16 or int8.");
+  }
+  return GALLERY_STORAGE_FLOAT32;
+}
+
+
+const char* getGalleryStorageName(GalleryStorage storage)
+{
+  switch (storage)
+  {
+    case GALLERY_STORAGE_FLOAT16: return "float16";
+    case GALLERY_STORAGE_INT8: return "int8";
+    default: return "float32";
+  }
+}
+
+
+void allocateGalleryRows(int rows, int cols, Mat& buffer, Mat& aligned, int type)
+{
+  int stride = (cols + GALLERY_SIMD_ALIGN - 1) / GALLERY_SIMD_ALIGN * GALLERY_SIMD_ALIGN;
+  stride = std::max(stride, GALLERY_SIMD_ALIGN);
+  size_t alignment = GALLERY_SIMD_ALIGN * sizeof(float);
+  buffer = Mat::zeros(1, (int)((size_t)rows * stride * CV_ELEM_SIZE(type) + alignment), CV_8U);
+  aligned = Mat(rows, stride, type, alignPtr(buffer.data, (int)alignment));
+}
+
+
+unsigned short convertToFloat16(float value)
+{
+  union { float f; unsigned int u; } bits;
+  bits.f = value;
+  unsigned int sign = (bits.u >> 16) & 0x8000;
+  unsigned int magnitude = bits.u & 0x7fffffff;
+
+  // Infinity and NaN, and the floats rounding past the largest half
+  if (magnitude > 0x7f800000) return (unsigned short)(sign | 0x7e00);
+  if (magnitude >= 0x477ff000) return (unsigned short)(sign | 0x7c00);
+
+  // Subnormal halves, in steps of 2^-24
+  if (magnitude < 0x38800000)
+  {
+    bits.u = magnitude;
+    return (unsigned short)(sign | (unsigned int)cvRound(bits.f * 16777216.0f));
+  }
+
+  // Normal halves, rebiasing the exponent and rounding the mantissa
+  // to even
+  magnitude += 0xfff + ((magnitude >> 13) & 1) - 0x38000000;
+  return (unsigned short)(sign | (magnitude >> 13));
+}
+
+
+float convertFromFloat16(unsigned short value)
+{
+  unsigned int sign = (unsigned int)(value & 0x8000) << 16;
+  unsigned int exponent = (value >> 10) & 0x1f;
+  unsigned int mantissa = value & 0x3ff;
+
+  union { float f; unsigned int u; } bits;
+  if (exponent == 0)
+  {
+    bits.f = mantissa * (1.0f / 16777216.0f);
+    bits.u |= sign;
+  }
+  else if (exponent == 0x1f)
+  {
+    bits.u = sign | 0x7f800000 | (mantissa << 13);
+  }
+  else
+  {
+    bits.u = sign | ((exponent + 112) << 23) | (mantissa << 13);
+  }
+  return bits.f;
+}
+
+
+/**
+ * @brief
+ *    Squared distances one float at a time.
+ */
+static void computeDistancesScalar(const float* gallery, int count, int stride, const float* query, float* distances)
+{
+  for (int j=0; j<count; ++j)
+  {
+    const float* g = gallery + (size_t)j * stride;
+    float sum = 0.0f;
+    for (int i=0; i<stride; ++i)
+    {
+      float d = g[i] - query[i];
+      sum += d * d;
+    }
+    distances[j] = sum;
+  }
+}
+
+
+/**
+ * @brief
+ *    Squared distances one half at a time.
+ */
+static void computeDistancesFloat16Scalar(const unsigned short* gallery, int count, int stride, const float* query, float* distances)
+{
+  for (int j=0; j<count; ++j)
+  {
+    const unsigned short* g = gallery + (size_t)j * stride;
+    float sum = 0.0f;
+    for (int i=0; i<stride; ++i)
+    {
+      float d = convertFromFloat16(g[i]) - query[i];
+      sum += d * d;
+    }
+    distances[j] = sum;
+  }
+}
+
+
+/**
+ * @brief
+ *    Squared distances one 8-bit integer at a time.
+ */
+static void computeDistancesInt8Scalar(const signed char* gallery, int count, int stride, const float* scales, const float* query, float* distances)
+{
+  for (int j=0; j<count; ++j)
+  {
+    const signed char* g = gallery + (size_t)j * stride;
+    float sum = 0.0f;
+    for (int i=0; i<stride; ++i)
+    {
+      float d = g[i] * scales[i] - query[i];
+      sum += d * d;
+    }
+    distances[j] = sum;
+  }
+}
+
+
+#ifdef GALLERY_SIMD_X86
+
+/**
+ * @brief
+ *    The kernels below take the difference and the square of 8 or 16
+ *    floats at once, with two accumulators to hide the latency of the
+ *    additions, and sum the lanes at the end of each row. The rows are
+ *    a multiple of 16 floats, so that no row needs a tail.
+ */
+__attribute__((target("avx2")))
+static void computeDistancesAVX2(const float* gallery, int count, int stride, const float* query, float* distances)
+{
+  for (int j=0; j<count; ++j)
+  {
+    const float* g = gallery + (size_t)j * stride;
+    __m256 acc0 = _mm256_setzero_ps();
+    __m256 acc1 = _mm256_setzero_ps();
+    for (int i=0; i<stride; i+=16)
+    {
+      __m256 d0 = _mm256_sub_ps(_mm256_load_ps(g + i), _mm256_load_ps(query + i));
+      __m256 d1 = _mm256_sub_ps(_mm256_load_ps(g + i + 8), _mm256_load_ps(query + i + 8));
+      acc0 = _mm256_add_ps(acc0, _mm256_mul_ps(d0, d0));
+      acc1 = _mm256_add_ps(acc1, _mm256_mul_ps(d1, d1));
+    }
+    __m256 acc = _mm256_add_ps(acc0, acc1);
+    __m128 s = _mm_add_ps(_mm256_castps256_ps128(acc), _mm256_extractf128_ps(acc, 1));
+    s = _mm_add_ps(s, _mm_movehl_ps(s, s));
+    s = _mm_add_ss(s, _mm_shuffle_ps(s, s, 1));
+    distances[j] = _mm_cvtss_f32(s);
+  }
+}
+
+
+__attribute__((target("avx512f")))
+static void computeDistancesAVX512(const float* gallery, int count, int stride, const float* query, float* distances)
+{
+  for (int j=0; j<count; ++j)
+  {
+    const float* g = gallery + (size_t)j * stride;
+    __m512 acc0 = _mm512_setzero_ps();
+    __m512 acc1 = _mm512_setzero_ps();
+    int i = 0;
+    for (; i+32<=stride; i+=32)
+    {
+      __m512 d0 = _mm512_sub_ps(_mm512_load_ps(g + i), _mm512_load_ps(query + i));
+      __m512 d1 = _mm512_sub_ps(_mm512_load_ps(g + i + 16), _mm512_load_ps(query + i + 16));
+      acc0 = _mm512_add_ps(acc0, _mm512_mul_ps(d0, d0));
+      acc1 = _mm512_add_ps(acc1, _mm512_mul_ps(d1, d1));
+    }
+    if (i < stride)
+    {
+      __m512 d0 = _mm512_sub_ps(_mm512_load_ps(g + i), _mm512_load_ps(query + i));
+      acc0 = _mm512_add_ps(acc0, _mm512_mul_ps(d0, d0));
+    }
+    distances[j] = _mm512_reduce_add_ps(_mm512_add_ps(acc0, acc1));
+  }
+}
+
+
+/**
+ * @brief
+ *    The kernels below widen 16 halves or 8-bit integers at a time to
+ *    floats, and take the difference and the square as the kernels
+ *    above. The 8-bit integers are scaled by their dimension first.
+ */
+__attribute__((target("avx2,f16c")))
+static void computeDistancesFloat16AVX2(const unsigned short* gallery, int count, int stride, const float* query, float* distances)
+{
+  for (int j=0; j<count; ++j)
+  {
+    const unsigned short* g = gallery + (size_t)j * stride;
+    __m256 acc0 = _mm256_setzero_ps();
+    __m256 acc1 = _mm256_setzero_ps();
+    for (int i=0; i<stride; i+=16)
+    {
+      __m256 g0 = _mm256_cvtph_ps(_mm_load_si128((const __m128i*)(g + i)));
+      __m256 g1 = _mm256_cvtph_ps(_mm_load_si128((const __m128i*)(g + i + 8)));
+      __m256 d0 = _mm256_sub_ps(g0, _mm256_load_ps(query + i));
+      __m256 d1 = _mm256_sub_ps(g1, _mm256_load_ps(query + i + 8));
+      acc0 = _mm256_add_ps(acc0, _mm256_mul_ps(d0, d0));
+      acc1 = _mm256_add_ps(acc1, _mm256_mul_ps(d1, d1));
+    }
+    __m256 acc = _mm256_add_ps(acc0, acc1);
+    __m128 s = _mm_add_ps(_mm256_castps256_ps128(acc), _mm256_extractf128_ps(acc, 1));
+    s = _mm_add_ps(s, _mm_movehl_ps(s, s));
+    s = _mm_add_ss(s, _mm_shuffle_ps(s, s, 1));
+    distances[j] = _mm_cvtss_f32(s);
+  }
+}
+
+
+__attribute__((target("avx512f")))
+static void computeDistancesFloat16AVX512(const unsigned short* gallery, int count, int stride, const float* query, float* distances)
+{
+  for (int j=0; j<count; ++j)
+  {
+    const unsigned short* g = gallery + (size_t)j * stride;
+    __m512 acc0 = _mm512_setzero_ps();
+    __m512 acc1 = _mm512_setzero_ps();
+    int i = 0;
+    for (; i+32<=stride; i+=32)
+    {
+      __m512 g0 = _mm512_cvtph_ps(_mm256_load_si256((const __m256i*)(g + i)));
+      __m512 g1 = _mm512_cvtph_ps(_mm256_load_si256((const __m256i*)(g + i + 16)));
+      __m512 d0 = _mm512_sub_ps(g0, _mm512_load_ps(query + i));
+      __m512 d1 = _mm512_sub_ps(g1, _mm512_load_ps(query + i + 16));
+      acc0 = _mm512_add_ps(acc0, _mm512_mul_ps(d0, d0));
+      acc1 = _mm512_add_ps(acc1, _mm512_mul_ps(d1, d1));
+    }
+    if (i < stride)
+    {
+      __m512 g0 = _mm512_cvtph_ps(_mm256_load_si256((const __m256i*)(g + i)));
+      __m512 d0 = _mm512_sub_ps(g0, _mm512_load_ps(query + i));
+      acc0 = _mm512_add_ps(acc0, _mm512_mul_ps(d0, d0));
+    }
+    distances[j] = _mm512_reduce_add_ps(_mm512_add_ps(acc0, acc1));
+  }
+}
+
+
+__attribute__((target("avx2")))
+static void computeDistancesInt8AVX2(const signed char* gallery, int count, int stride, const float* scales, const float* query, float* distances)
+{
+  for (int j=0; j<count; ++j)
+  {
+    const signed char* g = gallery + (size_t)j * stride;
+    __m256 acc0 = _mm256_setzero_ps();
+    __m256 acc1 = _mm256_setzero_ps();
+    for (int i=0; i<stride; i+=16)
+    {
+      __m128i b = _mm_load_si128((const __m128i*)(g + i));
+      __m256 g0 = _mm256_cvtepi32_ps(_mm256_cvtepi8_epi32(b));
+      __m256 g1 = _mm256_cvtepi32_ps(_mm256_cvtepi8_epi32(_mm_srli_si128(b, 8)));
+      __m256 d0 = _mm256_sub_ps(_mm256_mul_ps(g0, _mm256_load_ps(scales + i)), _mm256_load_ps(query + i));
+      __m256 d1 = _mm256_sub_ps(_mm256_mul_ps(g1, _mm256_load_ps(scales + i + 8)), _mm256_load_ps(query + i + 8));
+      acc0 = _mm256_add_ps(acc0, _mm256_mul_ps(d0, d0));
+      acc1 = _mm256_add_ps(acc1, _mm256_mul_ps(d1, d1));
+    }
+    __m256 acc = _mm256_add_ps(acc0, acc1);
+    __m128 s = _mm_add_ps(_mm256_castps256_ps128(acc), _mm256_extractf128_ps(acc, 1));
+    s = _mm_add_ps(s, _mm_movehl_ps(s, s));
+    s = _mm_add_ss(s, _mm_shuffle_ps(s, s, 1));
+    distances[j] = _mm_cvtss_f32(s);
+  }
+}
+
+
+__attribute__((target("avx512f")))
+static void computeDistancesInt8AVX512(const signed char* gallery, int count, int stride, const float* scales, const float* query, float* distances)
+{
+  for (int j=0; j<count; ++j)
+  {
+    const signed char* g = gallery + (size_t)j * stride;
+    __m512 acc0 = _mm512_setzero_ps();
+    __m512 acc1 = _mm512_setzero_ps();
+    int i = 0;
+    for (; i+32<=stride; i+=32)
+    {
+      __m512 g0 = _mm512_cvtepi32_ps(_mm512_cvtepi8_epi32(_mm_load_si128((const __m128i*)(g + i))));
+      __m512 g1 = _mm512_cvtepi32_ps(_mm512_cvtepi8_epi32(_mm_load_si128((const __m128i*)(g + i + 16))));
+      __m512 d0 = _mm512_sub_ps(_mm512_mul_ps(g0, _mm512_load_ps(scales + i)), _mm512_load_ps(query + i));
+      __m512 d1 = _mm512_sub_ps(_mm512_mul_ps(g1, _mm512_load_ps(scales + i + 16)), _mm512_load_ps(query + i + 16));
+      acc0 = _mm512_add_ps(acc0, _mm512_mul_ps(d0, d0));
+      acc1 = _mm512_add_ps(acc1, _mm512_mul_ps(d1, d1));
+    }
+    if (i < stride)
+    {
+      __m512 g0 = _mm512_cvtepi32_ps(_mm512_cvtepi8_epi32(_mm_load_si128((const __m128i*)(g + i))));
+      __m512 d0 = _mm512_sub_ps(_mm512_mul_ps(g0, _mm512_load_ps(scales + i)), _mm512_load_ps(query + i));
+      acc0 = _mm512_add_ps(acc0, _mm512_mul_ps(d0, d0));
+    }
+    distances[j] = _mm512_reduce_add_ps(_mm512_add_ps(acc0, acc1));
+  }
+}
+
+
+/**
+ * @return True if the CPU converts halves to floats with F16C.
+ */
+static bool hasFloat16Conversion()
+{
+  __builtin_cpu_init();
+  return __builtin_cpu_supports("f16c");
+}
+
+#endif // GALLERY_SIMD_X86
+
+
+void computeGalleryDistances(const float* gallery, int count, int stride, const float* query, float* distances, SimdLevel level)
+{
+  switch (level)
+  {
+#ifdef GALLERY_SIMD_X86
+    case SIMD_AVX2: computeDistancesAVX2(gallery, count, stride, query, distances); break;
+    case SIMD_AVX512: computeDistancesAVX512(gallery, count, stride, query, distances); break;
+#endif
+    default: computeDistancesScalar(gallery, count, stride, query, distances); break;
+  }
+}
+
+
+void computeGalleryDistancesFloat16(const unsigned short* gallery, int count, int stride, const float* query, float* distances, SimdLevel level)
+{
+#ifdef GALLERY_SIMD_X86
+  static const bool f16c = hasFloat16Conversion();
+  if (level == SIMD_AVX2 && !f16c) level = SIMD_NONE;
+#endif
+
+  switch (level)
+  {
+#ifdef GALLERY_SIMD_X86
+    case SIMD_AVX2: computeDistancesFloat16AVX2(gallery, count, stride, query, distances); break;
+    case SIMD_AVX512: computeDistancesFloat16AVX512(gallery, count, stride, query, distances); break;
+#endif
+    default: computeDistancesFloat16Scalar(gallery, count, stride, query, distances); break;
+  }
+}
+
+
+void computeGalleryDistancesInt8(const signed char* gallery, int count, int stride, const float* scales, const float* query, float* distances, SimdLevel level)
+{
+  switch (level)
+  {
+#ifdef GALLERY_SIMD_X86
+    case SIMD_AVX2: computeDistancesInt8AVX2(gallery, count, stride, scales, query, distances); break;
+    case SIMD_AVX512: computeDistancesInt8AVX512(gallery, count, stride, scales, query, distances); break;
+#endif
+    default: computeDistancesInt8Scalar(gallery, count, stride, scales, query, distances); break;
+  }
+}
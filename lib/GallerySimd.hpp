@@ -0,0 +1,154 @@
+/**
+ * SIMD kernels of the face gallery. The squared distances from a
+ * projected face to the projections of the gallery are computed in
+ * single precision by hand-vectorized kernels for AVX2 and AVX-512,
+ * chosen at runtime from the levels of "SimdLevel.hpp". The gallery
+ * may also be stored in half precision, or in 8-bit integers scaled
+ * per dimension, for kernels reading a half or a quarter of the
+ * memory.
+ *
+ * Author:  David Qiu.
+ * Email:   david@davidqiu.com
+ * Email:   dicong.qiu@intel.com
+ * Website: http://www.davidqiu.com/
+ *
+ * Copyright (C) 2014, David Qiu. All rights reserved.
+ */
+
+#ifndef FACEREC_GALLERY_SIMD_HPP
+#define FACEREC_GALLERY_SIMD_HPP
+
+#include "opencv2/core/core.hpp"
+
+#include "SimdLevel.hpp"
+
+#include <string>
+
+
+/**
+ * @brief
+ *   Alignment of the rows of the gallery in floats, a cache line of
+ *   64 bytes, so that the kernels only make aligned loads.
+ */
+const int GALLERY_SIMD_ALIGN = 16;
+
+
+/**
+ * @brief
+ *   Storage of the projections of the gallery scanned by the kernels.
+ */
+enum GalleryStorage
+{
+  GALLERY_STORAGE_FLOAT32 = 0,  // Single precision
+  GALLERY_STORAGE_FLOAT16 = 1,  // Half precision
+  GALLERY_STORAGE_INT8 = 2      // 8-bit integers scaled per dimension
+};
+
+
+/**
+ * @param name Name of the storage, "float32", "float16" or "int8".
+ * @return The storage named. An error is raised for any other name.
+ */
+GalleryStorage obtainGalleryStorage(const std::string& name);
+
+
+/**
+ * @param storage Storage of the gallery.
+ * @return Name of the storage.
+ */
+const char* getGalleryStorageName(GalleryStorage storage);
+
+
+/**
+ * @param rows Number of rows.
+ * @param cols Number of elements of a row.
+ * @param buffer Variable to store the memory of the rows.
+ * @param aligned Variable to store the rows, aligned to a cache line
+ *        and padded with zeros to a multiple of "GALLERY_SIMD_ALIGN"
+ *        elements.
+ * @param type Type of the elements, "CV_32F", "CV_16U" for half
+ *        precision or "CV_8S".
+ *
+ * @brief
+ *    Allocate rows for the SIMD kernels. The aligned rows point into
+ *    the buffer, which keeps the memory alive as long as any copy of
+ *    it.
+ */
+void allocateGalleryRows(int rows, int cols, cv::Mat& buffer, cv::Mat& aligned, int type = CV_32F);
+
+
+/**
+ * @param value A float.
+ * @return The closest half precision float, rounded to even.
+ */
+unsigned short convertToFloat16(float value);
+
+
+/**
+ * @param value A half precision float.
+ * @return The same value in single precision.
+ */
+float convertFromFloat16(unsigned short value);
+
+
+/**
+ * @param gallery Projections of the gallery, one row of "stride"
+ *        floats per face, aligned to "GALLERY_SIMD_ALIGN" floats and
+ *        padded with zeros.
+ * @param count Number of faces of the gallery.
+ * @param stride Floats from a row to the next, a multiple of
+ *        "GALLERY_SIMD_ALIGN".
+ * @param query Projection of the face, aligned and padded the same.
+ * @param distances Array to store the squared distance to each face
+ *        of the gallery.
+ * @param level SIMD kernels, which must be supported by the CPU. The
+ *        SSE4.2 kernels are those without SIMD.
+ *
+ * @brief
+ *    Compute the squared distances from a face to the gallery in
+ *    single precision. The kernels sum in different orders, so that
+ *    the last digits of the distances differ between them.
+ */
+void computeGalleryDistances(const float* gallery, int count, int stride, const float* query, float* distances, SimdLevel level);
+
+
+/**
+ * @param gallery Projections of the gallery in half precision, in
+ *        rows as computeGalleryDistances() takes them.
+ * @param count Number of faces of the gallery.
+ * @param stride Elements from a row to the next.
+ * @param query Projection of the face in single precision.
+ * @param distances Array to store the squared distance to each face
+ *        of the gallery.
+ * @param level SIMD kernels, which must be supported by the CPU. The
+ *        AVX2 kernels also need F16C, and fall back to those without
+ *        SIMD on a CPU without it.
+ *
+ * @brief
+ *    Compute the squared distances from a face to a gallery stored in
+ *    half precision, in single precision.
+ */
+void computeGalleryDistancesFloat16(const unsigned short* gallery, int count, int stride, const float* query, float* distances, SimdLevel level);
+
+
+/**
+ * @param gallery Projections of the gallery in 8-bit integers, in
+ *        rows as computeGalleryDistances() takes them.
+ * @param count Number of faces of the gallery.
+ * @param stride Elements from a row to the next.
+ * @param scales Scale of each dimension, aligned and padded as the
+ *        query.
+ * @param query Projection of the face in single precision.
+ * @param distances Array to store the squared distance to each face
+ *        of the gallery.
+ * @param level SIMD kernels, which must be supported by the CPU.
+ *
+ * @brief
+ *    Compute the squared distances from a face to a gallery stored in
+ *    8-bit integers, each element standing for itself times the scale
+ *    of its dimension, in single precision.
+ */
+void computeGalleryDistancesInt8(const signed char* gallery, int count, int stride, const float* scales, const float* query, float* distances, SimdLevel level);
+
+
+#endif // FACEREC_GALLERY_SIMD_HPP
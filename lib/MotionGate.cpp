@@ -0,0 +1,206 @@
+/**
+ * Motion gate.
+ *
+ * Author:  David Qiu.
+ * Email:   david@davidqiu.com
+ * Email:   dicong.qiu@intel.com
+ * Website: http://www.davidqiu.com/
+ *
+ * Copyright (C) 2014, David Qiu. All rights reserved.
+ */
+
+#include "MotionGate.hpp"
+#include "FaceDetection.hpp"
+
+#include "opencv2/imgproc/imgproc.hpp"
+
+#include <algorithm>
+using namespace cv;
+using namespace std;
+
+
+/**
+ * @brief
+ *   Weight of a frame in the background learned. A person standing
+ *   still fades into the background within about a hundred frames.
+ */
+const double MOTION_BACKGROUND_RATE = 0.02;
+
+
+/**
+ * @brief
+ *   Margin around a changed region to search, relative to the region
+ *   size, so that a face partly changed is searched in full.
+ */
+const double MOTION_REGION_MARGIN = 0.5;
+
+
+/**
+ * @brief
+ *   Largest fraction of the frame searched region by region, above
+ *   which the full frame is scanned at once.
+ */
+const double MOTION_MAX_SEARCHED = 0.5;
+
+
+MotionGate::MotionGate(int threshold, int minArea, int scanInterval)
+  : _threshold(threshold),
+    _minArea(minArea),
+    _scanInterval(scanInterval),
+    _framesSinceScan(0),
+    _idle(false),
+    _fullScan(true),
+    _searchedFraction(1.0)
+{
+}
+
+
+void MotionGate::detect(CascadeClassifier& cascade, const Mat& gray, double fscale, const FaceRecConfig& config, vector<Rect>& faces)
+{
+  faces.clear();
+  _framesSinceScan++;
+
+  // Find the regions changed from the background
+  bool scan = _background.empty() || _background.size() != gray.size() ||
+              (_scanInterval > 0 && _framesSinceScan >= _scanInterval);
+  vector<Rect> regions;
+  findChangedRegions(gray, regions);
+
+  // Expand the changed regions by the margin, and at least to the
+  // detection window
+  Size windowSize = obtainDetectionWindowSize(cascade);
+  Rect bounds(0, 0, gray.cols, gray.rows);
+  Mat searched = Mat::zeros(gray.rows, gray.cols, CV_8UC1);
+  for (int i=0; i<regions.size(); ++i)
+  {
+    const Rect& changed = regions[i];
+    int margin_x = std::max(cvRound(changed.width * MOTION_REGION_MARGIN), (windowSize.width - changed.width + 1) / 2);
+    int margin_y = std::max(cvRound(changed.height * MOTION_REGION_MARGIN), (windowSize.height - changed.height + 1) / 2);
+    Rect region(changed.x - margin_x, changed.y - margin_y, changed.width + 2 * margin_x, changed.height + 2 * margin_y);
+    region &= bounds;
+    if (region.area() > 0) searched(region).setTo(Scalar(255));
+  }
+  double searchedFraction = (double)countNonZero(searched) / std::max(bounds.area(), 1);
+  if (searchedFraction > MOTION_MAX_SEARCHED) scan = true;
+
+  if (scan)
+  {
+    // Scan the full frame
+    detectFacesInScaledImage(cascade, gray, fscale, config, faces);
+    _framesSinceScan = 0;
+    _idle = false;
+    _fullScan = true;
+    _searchedFraction = 1.0;
+  }
+  else if (regions.empty())
+  {
+    // Reuse the faces of the previous frame if nothing changed
+    faces = _faces;
+    _idle = true;
+    _fullScan = false;
+    _searchedFraction = 0.0;
+  }
+  else
+  {
+    // Keep the faces away from the changes
+    for (int i=0; i<_faces.size(); ++i)
+    {
+      Rect face = _faces[i] & bounds;
+      if (face.area() > 0 && countNonZero(searched(face)) == 0) faces.push_back(face);
+    }
+
+    // Search the changed regions, merged where they overlap
+    vector< vector<Point> > contours;
+    Mat mask = searched.clone();
+    findContours(mask, contours, CV_RETR_EXTERNAL, CV_CHAIN_APPROX_SIMPLE);
+    for (int i=0; i<contours.size(); ++i)
+    {
+      Rect region = boundingRect(contours[i]);
+      vector<Rect> regionFaces;
+      detectFacesInScaledImage(cascade, gray(region), fscale, config, regionFaces);
+      for (int j=0; j<regionFaces.size(); ++j)
+      {
+        regionFaces[j].x += region.x;
+        regionFaces[j].y += region.y;
+        faces.push_back(regionFaces[j]);
+      }
+    }
+    mergeDuplicateFaces(faces);
+    _idle = false;
+    _fullScan = false;
+    _searchedFraction = searchedFraction;
+  }
+
+  _faces = faces;
+}
+
+
+bool MotionGate::isIdle() const
+{
+  return _idle;
+}
+
+
+bool MotionGate::isFullScan() const
+{
+  return _fullScan;
+}
+
+
+double MotionGate::getSearchedFraction() const
+{
+  return _searchedFraction;
+}
+
+
+void MotionGate::reset()
+{
+  _background.release();
+  _faces.clear();
+  _framesSinceScan = 0;
+}
+
+
+/**
+ * @param gray Frame in grayscale.
+ * @param regions Array to store the bounding boxes of the changed
+ *        regions.
+ *
+ * @brief
+ *    Find the regions of a frame changed from the background, and
+ *    learn the frame into the background. The first frame, or a
+ *    frame of another size, starts a new background.
+ */
+void MotionGate::findChangedRegions(const Mat& gray, vector<Rect>& regions)
+{
+  regions.clear();
+  if (_background.empty() || _background.size() != gray.size())
+  {
+    gray.convertTo(_background, CV_32F);
+    return;
+  }
+
+  // Threshold the difference from the background
+  Mat background;
+  _background.convertTo(background, CV_8U);
+  Mat diff;
+  absdiff(gray, background, diff);
+  Mat mask;
+  threshold(diff, mask, _threshold, 255, THRESH_BINARY);
+
+  // Remove the isolated noise pixels and join the pixels of a change
+  erode(mask, mask, Mat());
+  dilate(mask, mask, Mat(), Point(-1, -1), 2);
+
+  // Bound the changed regions large enough not to be noise
+  vector< vector<Point> > contours;
+  findContours(mask, contours, CV_RETR_EXTERNAL, CV_CHAIN_APPROX_SIMPLE);
+  for (int i=0; i<contours.size(); ++i)
+  {
+    Rect region = boundingRect(contours[i]);
+    if (region.area() >= _minArea) regions.push_back(region);
+  }
+
+  // Learn the frame into the background
+  accumulateWeighted(gray, _background, MOTION_BACKGROUND_RATE);
+}
@@ -0,0 +1,102 @@
+/**
+ * Motion gate. It compares the frames of a static camera with a
+ * slowly learned background, detects the faces only in the regions
+ * which changed, and reuses the faces of the previous frame when
+ * nothing moved.
+ *
+ * Author:  David Qiu.
+ * Email:   david@davidqiu.com
+ * Email:   dicong.qiu@intel.com
+ * Website: http://www.davidqiu.com/
+ *
+ * Copyright (C) 2014, David Qiu. All rights reserved.
+ */
+
+#ifndef FACEREC_MOTION_GATE_HPP
+#define FACEREC_MOTION_GATE_HPP
+
+#include "opencv2/core/core.hpp"
+#include "opencv2/objdetect/objdetect.hpp"
+
+#include "FaceRecConfig.hpp"
+
+#include <vector>
+
+
+/**
+ * @brief
+ *   Motion-gated face detection of a video stream from a static
+ *   camera.
+ */
+class MotionGate
+{
+public:
+  /**
+   * @param threshold Difference of a pixel from the background, in
+   *        gray levels, for the pixel to be changed.
+   * @param minArea Smallest changed region in pixels, below which
+   *        the changes are taken for noise.
+   * @param scanInterval Frames between two full-frame scans, or "0"
+   *        to scan the full frame only when most of it changed.
+   *
+   * @brief
+   *    Create a motion gate with no background learned yet.
+   */
+  MotionGate(int threshold, int minArea, int scanInterval);
+
+  /**
+   * @param cascade Face detecter.
+   * @param gray Frame in grayscale, scaled from the original frame.
+   * @param fscale Scale from the original frame to the frame.
+   * @param config Configuration with the detection parameters.
+   * @param faces Array to store the positions of the faces in the
+   *        frame.
+   *
+   * @brief
+   *    Detect the faces in the next frame. The faces of the previous
+   *    frame are reused if nothing changed, and otherwise the faces
+   *    away from the changes are kept and the changed regions are
+   *    searched again. The full frame is scanned instead on the first
+   *    frame, every scan interval, and when most of the frame changed.
+   */
+  void detect(cv::CascadeClassifier& cascade, const cv::Mat& gray, double fscale, const FaceRecConfig& config, std::vector<cv::Rect>& faces);
+
+  /**
+   * @return True if nothing changed in the last frame, and its faces
+   *         are those of the previous frame.
+   */
+  bool isIdle() const;
+
+  /**
+   * @return True if the last frame was scanned in full.
+   */
+  bool isFullScan() const;
+
+  /**
+   * @return Fraction of the last frame searched for faces.
+   */
+  double getSearchedFraction() const;
+
+  /**
+   * @brief
+   *    Forget the background and the faces, so that the next frame
+   *    is scanned in full.
+   */
+  void reset();
+
+private:
+  void findChangedRegions(const cv::Mat& gray, std::vector<cv::Rect>& regions);
+
+  int _threshold;                   // Difference of a changed pixel from the background
+  int _minArea;                     // Smallest changed region in pixels
+  int _scanInterval;                // Frames between two full-frame scans
+  int _framesSinceScan;             // Frames since the last full-frame scan
+  cv::Mat _background;              // Background learned, in "CV_32F"
+  std::vector<cv::Rect> _faces;     // Faces of the previous frame
+  bool _idle;                       // Whether nothing changed in the last frame
+  bool _fullScan;                   // Whether the last frame was scanned in full
+  double _searchedFraction;         // Fraction of the last frame searched
+};
+
+
+#endif // FACEREC_MOTION_GATE_HPP
@@ -0,0 +1,57 @@
+/**
+ * Instruction sets of the SIMD kernels.
+ *
+ * Author:  David Qiu.
+ * Email:   david@davidqiu.com
+ * Email:   dicong.qiu@intel.com
+ * Website: http://www.davidqiu.com/
+ *
+ * Copyright (C) 2014, David Qiu. All rights reserved.
+ */
+
+#include "SimdLevel.hpp"
+
+#include "opencv2/core/core.hpp"
+
+#include <algorithm>
+using namespace std;
+
+
+SimdLevel detectSimdLevel()
+{
+#if defined(__x86_64__) || defined(__i386__)
+  __builtin_cpu_init();
+  if (__builtin_cpu_supports("avx512f")) return SIMD_AVX512;
+  if (__builtin_cpu_supports("avx2")) return SIMD_AVX2;
+  if (__builtin_cpu_supports("sse4.2")) return SIMD_SSE42;
+#endif
+  return SIMD_NONE;
+}
+
+
+SimdLevel obtainSimdLevel(const string& name)
+{
+  SimdLevel supported = detectSimdLevel();
+  SimdLevel level = supported;
+  if (name == "none") level = SIMD_NONE;
+  else if (name == "sse4.2") level = SIMD_SSE42;
+  else if (name == "avx2") level = SIMD_AVX2;
+  else if (name == "avx512") level = SIMD_AVX512;
+  else if (name != "auto")
+  {
+    CV_Error(CV_StsBadArg, "Unknown SIMD kernels " + name + ", expected none, sse4.2, avx2, avx512 or auto.");
+  }
+  return std::min(level, supported);
+}
+
+
+const char* getSimdLevelName(SimdLevel level)
+{
+  switch (level)
+  {
+    case SIMD_SSE42: return "sse4.2";
+    case SIMD_AVX2: return "avx2";
+    case SIMD_AVX512: return "avx512";
+    default: return "none";
+  }
+}
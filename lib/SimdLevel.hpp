@@ -0,0 +1,56 @@
+/**
+ * Instruction sets of the SIMD kernels. The kernels of the compiled
+ * cascades and of the face gallery are hand-vectorized for the same
+ * instruction sets, and one of them is chosen at runtime from those
+ * of the CPU.
+ *
+ * Author:  David Qiu.
+ * Email:   david@davidqiu.com
+ * Email:   dicong.qiu@intel.com
+ * Website: http://www.davidqiu.com/
+ *
+ * Copyright (C) 2014, David Qiu. All rights reserved.
+ */
+
+#ifndef FACEREC_SIMD_LEVEL_HPP
+#define FACEREC_SIMD_LEVEL_HPP
+
+#include <string>
+
+
+/**
+ * @brief
+ *   Instruction sets of the SIMD kernels, from the narrowest.
+ */
+enum SimdLevel
+{
+  SIMD_NONE = 0,            // No SIMD kernels
+  SIMD_SSE42 = 1,           // SSE4.2
+  SIMD_AVX2 = 2,            // AVX2
+  SIMD_AVX512 = 3           // AVX-512
+};
+
+
+/**
+ * @return The widest SIMD kernels supported by the CPU.
+ */
+SimdLevel detectSimdLevel();
+
+
+/**
+ * @param name Name of the SIMD kernels, "none", "sse4.2", "avx2",
+ *        "avx512" or "auto" for the widest supported.
+ * @return The SIMD kernels of the name, narrowed to those supported
+ *         by the CPU. An error is raised for any other name.
+ */
+SimdLevel obtainSimdLevel(const std::string& name);
+
+
+/**
+ * @param level SIMD kernels.
+ * @return Name of the SIMD kernels.
+ */
+const char* getSimdLevelName(SimdLevel level);
+
+
+#endif // FACEREC_SIMD_LEVEL_HPP
@@ -0,0 +1,102 @@
+/**
+ * C interface of the facerec library.
+ *
+ * Author:  David Qiu.
+ * Email:   david@davidqiu.com
+ * Email:   dicong.qiu@intel.com
+ * Website: http://www.davidqiu.com/
+ *
+ * Copyright (C) 2014, David Qiu. All rights reserved.
+ */
+
+#include "facerec.h"
+#include "FaceRecEngine.hpp"
+
+#include <iostream>
+using namespace cv;
+using namespace std;
+
+
+struct facerec_engine
+{
+  FaceRecEngine* engine;
+};
+
+
+int facerec_api_version(void)
+{
+  return FACEREC_API_VERSION;
+}
+
+
+facerec_engine* facerec_open(const char* cascade, const char* data)
+{
+  if (cascade == NULL || data == NULL) return NULL;
+
+  try
+  {
+    facerec_engine* handle = new facerec_engine;
+    try
+    {
+      handle->engine = new FaceRecEngine(cascade, data);
+    }
+    catch (...)
+    {
+      delete handle;
+      throw;
+    }
+    return handle;
+  }
+  catch (cv::Exception& e)
+  {
+    cerr << "[ERROR] Cannot open the face recognition engine. Reason: " << e.msg << endl;
+  }
+  catch (...)
+  {
+    cerr << "[ERROR] Cannot open the face recognition engine." << endl;
+  }
+  return NULL;
+}
+
+
+void facerec_close(facerec_engine* engine)
+{
+  if (engine == NULL) return;
+  delete engine->engine;
+  delete engine;
+}
+
+
+int facerec_recognize_bgr(facerec_engine* engine, const unsigned char* bgr, int width, int height, size_t stride, facerec_face* faces, int max_faces)
+{
+  // Check the arguments
+  if (engine == NULL || bgr == NULL || width <= 0 || height <= 0 || stride < (size_t)width * 3) return FACEREC_ERROR_ARGUMENT;
+  if (max_faces < 0 || (faces == NULL && max_faces > 0)) return FACEREC_ERROR_ARGUMENT;
+
+  // Recognize the faces
+  vector<FaceResult> results;
+  try
+  {
+    engine->engine->recognize(bgr, width, height, stride, results);
+  }
+  catch (...)
+  {
+    return FACEREC_ERROR_INTERNAL;
+  }
+
+  // Store the faces recognized
+  const map<int, string>& names = engine->engine->getNames();
+  for (int i=0; i<results.size() && i<max_faces; ++i)
+  {
+    faces[i].x = results[i].position.x;
+    faces[i].y = results[i].position.y;
+    faces[i].width = results[i].position.width;
+    faces[i].height = results[i].position.height;
+    faces[i].label = results[i].label;
+    faces[i].confidence = results[i].confidence;
+    map<int, string>::const_iterator it = names.find(results[i].label);
+    faces[i].name = (it != names.end()) ? it->second.c_str() : NULL;
+  }
+
+  return (int)results.size();
+}
@@ -0,0 +1,109 @@
+/**
+ * C interface of the facerec library. It recognizes the faces in 
+ * images in the calling process, without any server, so that the 
+ * face recognition can be embedded in programs of any language with 
+ * a C foreign function interface.
+ *
+ * Author:  David Qiu.
+ * Email:   david@davidqiu.com
+ * Email:   dicong.qiu@intel.com
+ * Website: http://www.davidqiu.com/
+ *
+ * Copyright (C) 2014, David Qiu. All rights reserved.
+ */
+
+#ifndef FACEREC_H
+#define FACEREC_H
+
+#include <stddef.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+
+/* Version of the interface, increased on every incompatible change */
+#define FACEREC_API_VERSION 1
+
+/* Error codes returned by the functions */
+#define FACEREC_ERROR_ARGUMENT  (-1)
+#define FACEREC_ERROR_INTERNAL  (-2)
+
+
+/**
+ * Face recognition engine, opaque to the callers.
+ */
+typedef struct facerec_engine facerec_engine;
+
+
+/**
+ * A face recognized in an image.
+ */
+typedef struct facerec_face
+{
+  int x;                    /* Left of the face in the image */
+  int y;                    /* Top of the face in the image */
+  int width;                /* Width of the face */
+  int height;               /* Height of the face */
+  int label;                /* Label of the face predicted */
+  double confidence;        /* Distance to the closest face, smaller is closer */
+  const char* name;         /* Name of the face predicted, owned by the engine */
+} facerec_face;
+
+
+/**
+ * @return FACEREC_API_VERSION of the library loaded.
+ *
+ * @brief
+ *    Obtain the version of the interface implemented by the library, 
+ *    to check it against the header compiled with.
+ */
+int facerec_api_version(void);
+
+
+/**
+ * @param cascade Path to the cascade for face detection.
+ * @param data Path to the face database.
+ * @return The engine opened, or NULL on failure.
+ *
+ * @brief
+ *    Open a face recognition engine on a face database. The face 
+ *    recognizer is loaded from its cache, or trained and cached if the 
+ *    cache is out of date.
+ */
+facerec_engine* facerec_open(const char* cascade, const char* data);
+
+
+/**
+ * @param engine Engine opened by facerec_open(), or NULL.
+ *
+ * @brief
+ *    Close a face recognition engine. The names of the faces 
+ *    recognized by the engine are no longer valid afterwards.
+ */
+void facerec_close(facerec_engine* engine);
+
+
+/**
+ * @param engine Engine opened by facerec_open().
+ * @param bgr Pixels of the image in BGR color, 3 bytes per pixel.
+ * @param width Width of the image.
+ * @param height Height of the image.
+ * @param stride Bytes from a row of pixels to the next.
+ * @param faces Array to store the faces recognized.
+ * @param max_faces Capacity of the array.
+ * @return Number of faces found, which may exceed max_faces while 
+ *         only max_faces of them are stored, or a negative error code.
+ *
+ * @brief
+ *    Detect and recognize all the faces in an image. It can be called 
+ *    on an engine from several threads at the same time.
+ */
+int facerec_recognize_bgr(facerec_engine* engine, const unsigned char* bgr, int width, int height, size_t stride, facerec_face* faces, int max_faces);
+
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* FACEREC_H */
@@ -0,0 +1,203 @@
+/**
+ * Cascade compilation tool. This application precompiles an XML 
+ * face cascade into the binary cascade loaded by the other 
+ * applications, and verifies that both detect the same faces.
+ *
+ * The binary cascade "<cascade>.bin" is picked up automatically 
+ * by the applications given "<cascade>", as long as the XML cascade 
+ * is not modified after it is precompiled.
+ *
+ * Author:  David Qiu.
+ * Email:   david@davidqiu.com
+ * Email:   dicong.qiu@intel.com
+ * Website: http://www.davidqiu.com/
+ *
+ * Copyright (C) 2014, David Qiu. All rights reserved.
+ */
+
+#include "opencv2/core/core.hpp"
+#include "opencv2/highgui/highgui.hpp"
+#include "opencv2/imgproc/imgproc.hpp"
+#include "opencv2/objdetect/objdetect.hpp"
+
+#include "FaceCascade.hpp"
+
+#include <iostream>
+#include <algorithm>
+#include <cstdlib>
+using namespace cv;
+using namespace std;
+
+
+/**
+ * @param a A rectangle.
+ * @param b Another rectangle.
+ * @return True if the first rectangle goes before the second one.
+ *
+ * @brief
+ *    Order the rectangles by position and then by size.
+ */
+bool compareRects(const Rect& a, const Rect& b)
+{
+  if (a.y != b.y) return a.y < b.y;
+  if (a.x != b.x) return a.x < b.x;
+  if (a.width != b.width) return a.width < b.width;
+  return a.height < b.height;
+}
+
+
+/**
+ * @param fn_cascade Path to the XML cascade.
+ * @param fn_binary Path to the binary cascade.
+ * @return An int indicating the operation state.
+ *
+ * @brief
+ *    Precompile an XML cascade into a binary cascade.
+ */
+int compileCascade(const string& fn_cascade, const string& fn_binary)
+{
+  // Load the XML cascade
+  FaceCascade cascade;
+  int64 startTick = getTickCount();
+  if (!cascade.loadXML(fn_cascade))
+  {
+    cerr << "[ERROR] Cannot load the cascade \"" << fn_cascade << "\"." << endl;
+    return 1;
+  }
+  double xmlTime = (getTickCount() - startTick) * 1000.0 / getTickFrequency();
+  if (!cascade.isOldFormatCascade())
+  {
+    cerr << "[ERROR] Only the cascades in the old Haar format can be precompiled." << endl;
+    return 1;
+  }
+
+  // Write the binary cascade
+  if (!cascade.saveBinary(fn_binary, fn_cascade))
+  {
+    cerr << "[ERROR] Cannot write the binary cascade \"" << fn_binary << "\"." << endl;
+    return 1;
+  }
+
+  // Load the binary cascade back
+  FaceCascade binary;
+  startTick = getTickCount();
+  if (!binary.loadBinary(fn_binary, fn_cascade))
+  {
+    cerr << "[ERROR] Cannot load the binary cascade \"" << fn_binary << "\" back." << endl;
+    return 1;
+  }
+  double binaryTime = (getTickCount() - startTick) * 1000.0 / getTickFrequency();
+
+  cout << "[INFO] Output the binary cascade as \"" << fn_binary << "\"" << endl;
+  cout << "[INFO] Loading takes " << xmlTime << " ms from XML and " << binaryTime << " ms from binary." << endl;
+  return 0;
+}
+
+
+/**
+ * @param fn_cascade Path to the XML cascade.
+ * @param fn_binary Path to the binary cascade.
+ * @param imagePaths Paths to the test images.
+ * @return An int indicating the operation state.
+ *
+ * @brief
+ *    Verify that the XML cascade and the binary cascade detect the 
+ *    same faces in the test images, at their size and scaled up 2 
+ *    times.
+ */
+int verifyCascade(const string& fn_cascade, const string& fn_binary, const vector<string>& imagePaths)
+{
+  // Load both cascades
+  FaceCascade xmlCascade;
+  FaceCascade binaryCascade;
+  if (!xmlCascade.loadXML(fn_cascade))
+  {
+    cerr << "[ERROR] Cannot load the cascade \"" << fn_cascade << "\"." << endl;
+    return 1;
+  }
+  if (!binaryCascade.loadBinary(fn_binary, fn_cascade))
+  {
+    cerr << "[ERROR] Cannot load the binary cascade \"" << fn_binary << "\", or it is out of date." << endl;
+    return 1;
+  }
+
+  // Compare the faces detected in each test image
+  int numMismatches = 0;
+  for (int i=0; i<imagePaths.size(); ++i)
+  {
+    Mat original = imread(imagePaths[i], 0);
+    if (original.empty())
+    {
+      cerr << "[ERROR] Cannot read the test image \"" << imagePaths[i] << "\"." << endl;
+      return 1;
+    }
+
+    for (int scale=1; scale<=2; ++scale)
+    {
+      Mat gray;
+      cv::resize(original, gray, Size(original.cols * scale, original.rows * scale), 0, 0, INTER_CUBIC);
+
+      vector<Rect> xmlFaces;
+      vector<Rect> binaryFaces;
+      xmlCascade.detectMultiScale(gray, xmlFaces);
+      binaryCascade.detectMultiScale(gray, binaryFaces);
+      std::sort(xmlFaces.begin(), xmlFaces.end(), compareRects);
+      std::sort(binaryFaces.begin(), binaryFaces.end(), compareRects);
+
+      bool same = (xmlFaces == binaryFaces);
+      if (!same) numMismatches++;
+      cout << "[INFO] \"" << imagePaths[i] << "\" x" << scale << ": " << xmlFaces.size() << " faces from XML, " 
+           << binaryFaces.size() << " faces from binary, " << (same ? "identical." : "DIFFERENT.") << endl;
+    }
+  }
+
+  if (numMismatches > 0)
+  {
+    cerr << "[ERROR] " << numMismatches << " detections differ between the XML and the binary cascades." << endl;
+    return 1;
+  }
+  cout << "[INFO] The XML and the binary cascades detect the same faces." << endl;
+  return 0;
+}
+
+
+/**
+ * @brief
+ *    Program entry of the application.
+ */
+int main(int argc, const char *argv[])
+{
+  // Check for valid command line arguments
+  bool verifyMode = (argc >= 4 && string(argv[1]) == "--verify");
+  if ((argc < 2 || argc > 3 || string(argv[1]) == "--verify") && !verifyMode)
+  {
+    cout << "usage: " << argv[0] << " <cascade> [<out_binary>]" << endl;
+    cout << "       " << argv[0] << " --verify <cascade> <image> [<image> ...]" << endl;
+    cout << "\t <cascade>    -- Path to the XML Haar Cascade to precompile." << endl;
+    cout << "\t <out_binary> -- Path to the binary cascade. (optional, \"<cascade>" << FACE_CASCADE_BINARY_SUFFIX << "\" by default)" << endl;
+    cout << "\t --verify     -- Check that the cascade and its binary cascade detect the same faces." << endl;
+    cout << "\t <image>      -- Test image for the verification." << endl;
+    exit(1);
+  }
+
+  try
+  {
+    // Verify the binary cascade
+    if (verifyMode)
+    {
+      string fn_cascade = string(argv[2]);
+      vector<string> imagePaths(argv + 3, argv + argc);
+      return verifyCascade(fn_cascade, fn_cascade + FACE_CASCADE_BINARY_SUFFIX, imagePaths);
+    }
+
+    // Precompile the cascade
+    string fn_cascade = string(argv[1]);
+    string fn_binary = (argc > 2) ? string(argv[2]) : fn_cascade + FACE_CASCADE_BINARY_SUFFIX;
+    return compileCascade(fn_cascade, fn_binary);
+  }
+  catch (cv::Exception& e)
+  {
+    cerr << "[ERROR] Cascade compilation failed. Reason: " << e.msg << endl;
+    exit(1);
+  }
+}
@@ -25,6 +25,15 @@
 #include "opencv2/imgproc/imgproc.hpp"
 #include "opencv2/objdetect/objdetect.hpp"
 
+#include "FaceCascade.hpp"
+#include "FaceDatabase.hpp"
+#include "FaceDetection.hpp"
+#include "FaceEnrollment.hpp"
+#include "FaceModel.hpp"
+#include "FaceRecConfig.hpp"
+#include "FaceTracker.hpp"
+#include "MotionGate.hpp"
+
 #include <iostream>
 #include <fstream>
 #include <sstream>
@@ -34,169 +43,16 @@
 #include <sys/stat.h>
 #include <unistd.h>
 #include <cstdio>
+#include <algorithm>
 using namespace cv;
 using namespace std;
 
 
 const int STD_PROTRAIT_SIZE       = 256;
-const int STD_FACE_REC_SIZE       = 64;
 const int STD_DETECT_FRAME_WIDTH  = 320;
 const int STD_DETECT_FRAME_HEIGHT = 240;
 
 
-/**
- * @brief
- *   Type of directory item.
- */ 
-enum DirectoryItemType
-{
-  DIRITEM_OTHER = 0,  // Other directory item type
-  DIRITEM_FILE = 1,   // Normal file
-  DIRITEM_DIR = 2     // Directory item
-};
-
-
-/**
- * @param dirpath Path to the directory.
- * @param items Item names from the directory
- * @param types Directory types of corresponding items.
- * @return An int indicating the operation state. "0" indicates 
- *         success and negative numbers indicate failure.
- *
- * @brief
- *    Traverse a directory and obtain all the items. Hidden files 
- *    will be ignored.
- */
-int traverseDirectory(string dirpath, vector<string>& items, vector<DirectoryItemType>& types)
-{
-  DIR* dp;
-  struct dirent* dirp;
-  struct stat st;
-
-  // Clear the vectors
-  items.clear();
-  types.clear();
-
-  // Open dirent directory
-  if ((dp = opendir(dirpath.c_str())) == NULL)
-  {
-    cerr << "[ERROR] traverseDirectory(string, vector<string>&, vector<DirectoryItemType>&): " 
-         << "Cannot open the directory " << dirpath << "." << endl;
-    return -1;
-  }
-
-  // Read all files in this dir
-  while ((dirp = readdir(dp)) != NULL)
-  {
-    // Ignore hidden files
-    if (dirp->d_name[0] == '.') continue;
-
-    // Obtain the full name of the item
-    string fullname = dirpath + string("/") + string(dirp->d_name);
-
-    // Obtain the item status
-    if (stat(fullname.c_str(), &st) == -1)
-    {
-      cerr << "[ERROR] traverseDirectory(string, vector<string>&, vector<DirectoryItemType>&): " 
-           << "Cannot obtain the status of the item " << fullname << "." << endl;
-      return -1;
-    }
-
-    // Obtain the item type
-    DirectoryItemType itemType = DIRITEM_OTHER;
-    if (S_ISREG(st.st_mode)) itemType = DIRITEM_FILE;
-    if (S_ISDIR(st.st_mode)) itemType = DIRITEM_DIR;
-    
-    // Push to the vectors
-    items.push_back(dirp->d_name);
-    types.push_back(itemType);
-  }
-
-  return 0;
-}
-
-
-/**
- * @param datapath Path to face database directory.
- * @param images Array to store face image data.
- * @param labels Array to store corresponding labels for face images.
- * @param names Mapping from label to name of the face.
- *
- * @brief
- *    Load face data from face database directory.
- */
-void loadFaceData(const string& datapath, vector<Mat>& images, vector<int>& labels, map<int, string>& names)
-{
-  vector<string> items_data;
-  vector<DirectoryItemType> types_data;
-  vector<string> items_face;
-  vector<DirectoryItemType> types_face;
-  
-  // Clear the result containers
-  images.clear();
-  labels.clear();
-  names.clear();
-
-  // Obtain the face data path
-  string faceDataPath = datapath + "/faces";
-
-  // Traverse the data directory
-  if (traverseDirectory(faceDataPath, items_data, types_data) < 0)
-  {
-    string error_message = "Cannot read the face database directory " + faceDataPath + ".";
-    cerr << "[ERROR] loadFaceData(const string&, vector<Mat>&, vector<int>&, map<int, string>&): "
-         << error_message << endl;
-    CV_Error(CV_StsBadArg, error_message);
-  }
-
-  // Inform the loading state
-  cout << "[INFO] Open face data directory \"" << faceDataPath << "\". Now loading: " << endl;
-  
-  // Traverse each face directory
-  for (int i=0; i<items_data.size(); ++i)
-  {
-    // Check if the current item is a directory
-    if ( !(types_data[i]==DIRITEM_DIR) ) continue;
-
-    // Obtain the face image directory path
-    string faceImagePath = faceDataPath + "/" + items_data[i];
-
-    // Traverse the face image directory
-    if (traverseDirectory(faceImagePath, items_face, types_face) < 0)
-    {
-      string error_message = "Cannot read the face image directory " + faceImagePath + ".";
-      cerr << "[ERROR] loadFaceData(const string&, vector<Mat>&, map<int, string>&): "
-           << error_message << endl;
-      CV_Error(CV_StsBadArg, error_message);
-    }
-
-    // Inform the loading state
-    cout << "\t- " << items_data[i] << " [" << i + 1 << "/" << items_data.size() << "]" << endl;
-
-    // Push data to result containers
-    for (int j=0; j<items_face.size(); ++j)
-    {
-      // Check if the current item is a normal file
-      if ( !(types_face[j]==DIRITEM_FILE) ) continue;
-
-      // Obtain the image path
-      string imagePath = faceImagePath + "/" + items_face[j];
-      
-      // Read the image and push to the result containers
-      Mat img_original = imread(imagePath, 0);
-      Mat img_resized;
-      cv::resize(img_original, img_resized, Size(STD_FACE_REC_SIZE, STD_FACE_REC_SIZE), 1.0, 1.0, INTER_CUBIC);
-      images.push_back(img_resized);
-      labels.push_back(i);
-      names.insert( pair<int, string>(i, items_data[i]) );
-      
-      // Inform the loading state
-      cout << "\t\t- " << items_face[j] << endl;
-    }
-  }
-}
-
-
 /**
  * @brief
  *    Program entry of the application.
@@ -238,6 +94,10 @@ int main(int argc, const char *argv[])
   system( (string("mkdir -p ") + dir_usrfaces).c_str() );
   system( (string("mkdir -p ") + dir_usrprotraits).c_str() );
   
+  // Load the deployment configuration
+  FaceRecConfig config;
+  loadFaceRecConfig(dir_data, config);
+
   // Load the face database
   vector<Mat> images;
   vector<int> labels;
@@ -245,7 +105,7 @@ int main(int argc, const char *argv[])
   map<string, int> name2label;
   try
   {
-    loadFaceData(dir_data, images, labels, names);
+    loadFaceData(dir_data, images, labels, names, config.loaderThreads);
   }
   catch (cv::Exception& e)
   {
@@ -262,12 +122,34 @@ int main(int argc, const char *argv[])
   int im_height = images[0].rows;
 
   // Create and train a face recognizer
-  Ptr<FaceRecognizer> model = createFisherFaceRecognizer();
-  model->train(images, labels);
+  Ptr<FaceRecognizer> model;
+  try
+  {
+    model = createFaceRecognizer(config.predictBackend);
+    model->train(images, labels);
+  }
+  catch (cv::Exception& e)
+  {
+    cerr << "[ERROR] Failed to train the face recognizer. Reason: " << e.msg << endl;
+    exit(1);
+  }
+
+  // Prepare the enrollment of the captured faces
+  FaceEnrollment enrollment(model, images, labels, config.enrollBatchSize, config.enrollIdleSeconds);
 
   // Create and train a face detecter
-  CascadeClassifier haar_cascade;
-  haar_cascade.load(fn_cascade);
+  FaceCascade haar_cascade;
+  if (!loadDetectionCascade(haar_cascade, fn_cascade, config))
+  {
+    cerr << "[ERROR] Cannot load the cascade \"" << obtainDetectionCascadePath(fn_cascade, config) << "\"." << endl;
+    return -1;
+  }
+
+  // Prepare the tracking of the faces between frames
+  FaceTracker tracker(config.trackInterval, config.trackMargin);
+
+  // Prepare the motion gating of the detection for a static camera
+  MotionGate motionGate(config.motionThreshold, config.motionMinArea, config.motionScanInterval);
 
   // Open the video capture device
   VideoCapture cap(deviceId);
@@ -288,6 +170,14 @@ int main(int argc, const char *argv[])
     // Obtain the next frame from the video stream
     cap >> frame;
 
+    // Start retraining with the pending captured faces in background 
+    // and switch to the latest retrained face recognizer
+    if (enrollment.poll())
+    {
+      cout << "[INFO] Face recognizer retrained in background." << endl;
+    }
+    model = enrollment.getModel();
+
     // Clone the current frame
     Mat original = frame.clone();
 
@@ -299,9 +189,13 @@ int main(int argc, const char *argv[])
     Mat gray;
     cvtColor(original_resized, gray, CV_BGR2GRAY);
 
-    // Find the faces in the frame
+    // Find the faces in the frame, only where it changed if the 
+    // detection is motion gated, or around the faces of the previous 
+    // frame if they are tracked
     vector< Rect_<int> > faces;
-    haar_cascade.detectMultiScale(gray, faces);
+    double fscale = 1.0 / std::max(invfscale_x, invfscale_y);
+    if (config.motionThreshold > 0) motionGate.detect(haar_cascade, gray, fscale, config, faces);
+    else tracker.detect(haar_cascade, gray, fscale, config, faces);
 
     // Process all the faces detected
     for(int i = 0; i < faces.size(); i++)
@@ -345,11 +239,9 @@ int main(int argc, const char *argv[])
         // Append the saved face to runtime
         int usrLabel = -1;
         if (name2label.find(expectName)!=name2label.end()) usrLabel = name2label[expectName];
-        images.push_back(face_resized);
-        labels.push_back(usrLabel);
         names.insert( pair<int, string>(usrLabel, expectName) );
         name2label.insert( pair<string, int>(expectName, usrLabel) );
-        model->train(images, labels);
+        enrollment.add(face_resized, usrLabel);
 
         // Reset the save face flag
         saveFaceFlag = false;
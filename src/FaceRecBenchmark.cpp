@@ -0,0 +1,1994 @@
+/**
+ * Benchmark of the face recognition applications. This 
+ * application measures the performance of the building blocks of 
+ * the face recognition applications on a face database.
+ *
+ * Author:  David Qiu.
+ * Email:   david@davidqiu.com
+ * Email:   dicong.qiu@intel.com
+ * Website: http://www.davidqiu.com/
+ *
+ * Copyright (C) 2014, David Qiu. All rights reserved.
+ */
+
+#include "opencv2/core/core.hpp"
+#include "opencv2/contrib/contrib.hpp"
+#include "opencv2/highgui/highgui.hpp"
+#include "opencv2/imgproc/imgproc.hpp"
+#include "opencv2/objdetect/objdetect.hpp"
+
+#include "FaceCascade.hpp"
+#include "FaceDatabase.hpp"
+#include "FaceDetection.hpp"
+#include "FaceEnrollment.hpp"
+#include "FaceGallery.hpp"
+#include "FaceModel.hpp"
+#include "FaceRecConfig.hpp"
+#include "FaceTracker.hpp"
+#include "MotionGate.hpp"
+
+#include <iostream>
+#include <iomanip>
+#include <fstream>
+#include <sstream>
+#include <algorithm>
+#include <cmath>
+#include <cfloat>
+#include <cstdlib>
+#include <cstdio>
+#include <climits>
+#include <unistd.h>
+using namespace cv;
+using namespace std;
+
+
+/**
+ * @param startTick Tick count at the start of the measurement.
+ * @return Milliseconds elapsed since the start tick.
+ *
+ * @brief
+ *    Measure the elapsed time.
+ */
+double elapsedMilliseconds(int64 startTick)
+{
+  return (double)(getTickCount() - startTick) * 1000.0 / getTickFrequency();
+}
+
+
+/**
+ * @brief
+ *   Timings of a stage of the face recognition on an input.
+ */
+struct StageTiming
+{
+  string stage;             // Name of the stage
+  string input;             // Description of the input
+  int itemsPerRun;          // Number of items processed by each run
+  string unit;              // Name of the items processed
+  vector<double> samples;   // Milliseconds taken by each run
+};
+
+
+/**
+ * @param samples Milliseconds taken by each run.
+ * @param fraction Fraction of the runs at or below the percentile.
+ * @return The percentile of the samples, by the nearest rank.
+ *
+ * @brief
+ *    Compute a percentile of the timings.
+ */
+double computePercentile(vector<double> samples, double fraction)
+{
+  if (samples.empty()) return 0.0;
+  std::sort(samples.begin(), samples.end());
+  int rank = (int)std::ceil(fraction * samples.size()) - 1;
+  return samples[std::max(0, std::min(rank, (int)samples.size() - 1))];
+}
+
+
+/**
+ * @param samples Milliseconds taken by each run.
+ * @return The mean of the samples.
+ *
+ * @brief
+ *    Compute the mean of the timings.
+ */
+double computeMean(const vector<double>& samples)
+{
+  if (samples.empty()) return 0.0;
+  double sum = 0.0;
+  for (int i=0; i<samples.size(); ++i) sum += samples[i];
+  return sum / samples.size();
+}
+
+
+/**
+ * @param images Face images of the face database.
+ * @param index Index of the synthetic capture.
+ * @param rng Random number generator.
+ * @return A synthetic captured face.
+ *
+ * @brief
+ *    Synthesize a captured face from the face database by adding 
+ *    noise to one of its faces.
+ */
+Mat synthesizeCapture(const vector<Mat>& images, int index, RNG& rng)
+{
+  Mat noise(images[0].rows, images[0].cols, CV_8UC1);
+  rng.fill(noise, RNG::UNIFORM, Scalar(0), Scalar(16));
+  Mat capture;
+  add(images[index % images.size()], noise, capture);
+  return capture;
+}
+
+
+/**
+ * @param dir_data Path to the face database.
+ * @param numCaptures Number of captured faces to enroll.
+ * @param config Deployment configuration.
+ * @return An int indicating the operation state.
+ *
+ * @brief
+ *    Benchmark the cost per captured face of enrolling new faces 
+ *    as the face database grows, for a full retrain at every 
+ *    capture, for the background batched retrain of FaceCollection 
+ *    and for the incremental update of the LBPH face recognizer. 
+ *    The cost is the time the capture loop is blocked.
+ */
+int benchmarkEnrollment(const string& dir_data, int numCaptures, const FaceRecConfig& config)
+{
+  // Load the face database
+  vector<Mat> images;
+  vector<int> labels;
+  map<int, string> names;
+  loadFaceData(dir_data, images, labels, names, config.loaderThreads);
+  int newLabel = names.empty() ? 0 : names.rbegin()->first + 1;
+
+  // Synthesize the captured faces
+  RNG rng(12345);
+  vector<Mat> captures;
+  for (int k=0; k<numCaptures; ++k) captures.push_back(synthesizeCapture(images, k, rng));
+
+  // Enroll the captured faces with each strategy in turn
+  const int numStrategies = 3;
+  const char* strategyNames[numStrategies] = { "retrain", "background", "lbph-update" };
+  vector< vector<double> > costs(numStrategies, vector<double>(numCaptures, 0.0));
+  vector<double> drainCosts(numStrategies, 0.0);
+  for (int s=0; s<numStrategies; ++s)
+  {
+    // Retrain on the whole face database at every capture
+    if (s == 0)
+    {
+      vector<Mat> retrainImages(images);
+      vector<int> retrainLabels(labels);
+      Ptr<FaceRecognizer> model = createFisherFaceRecognizer();
+      model->train(retrainImages, retrainLabels);
+      for (int k=0; k<numCaptures; ++k)
+      {
+        int64 startTick = getTickCount();
+        retrainImages.push_back(captures[k]);
+        retrainLabels.push_back(newLabel);
+        model->train(retrainImages, retrainLabels);
+        costs[s][k] = elapsedMilliseconds(startTick);
+      }
+      continue;
+    }
+
+    // Enroll as FaceCollection does, polling once per capture
+    Ptr<FaceRecognizer> model = (s == 1) ? createFisherFaceRecognizer() : createLBPHFaceRecognizer();
+    model->train(images, labels);
+    FaceEnrollment enrollment(model, images, labels, config.enrollBatchSize, 1e30);
+    for (int k=0; k<numCaptures; ++k)
+    {
+      int64 startTick = getTickCount();
+      enrollment.add(captures[k], newLabel);
+      enrollment.poll();
+      costs[s][k] = elapsedMilliseconds(startTick);
+    }
+
+    // Wait for the last retrain
+    int64 startTick = getTickCount();
+    enrollment.flush();
+    drainCosts[s] = elapsedMilliseconds(startTick);
+  }
+
+  // Inform the benchmark setting
+  cout << "[INFO] Enroll " << numCaptures << " captured faces into " << images.size() 
+       << " faces, retraining every " << config.enrollBatchSize << " captures in background mode." << endl;
+  cout << "[INFO] Cost per captured face in ms, as mean / max over each interval:" << endl;
+  cout << setw(12) << "faces";
+  for (int s=0; s<numStrategies; ++s) cout << setw(24) << strategyNames[s];
+  cout << endl;
+
+  // Report the cost per interval of captures
+  int interval = std::max(numCaptures / 10, 1);
+  for (int begin=0; begin<numCaptures; begin+=interval)
+  {
+    int end = std::min(begin + interval, numCaptures);
+    cout << setw(12) << images.size() + end;
+    for (int s=0; s<numStrategies; ++s)
+    {
+      double sum = 0.0;
+      double peak = 0.0;
+      for (int k=begin; k<end; ++k)
+      {
+        sum += costs[s][k];
+        peak = std::max(peak, costs[s][k]);
+      }
+      cout << setw(24) << format("%.3f / %.3f", sum / (end - begin), peak);
+    }
+    cout << endl;
+  }
+  cout << "[INFO] Waiting for the last background retrain took " << drainCosts[1] << " ms." << endl;
+
+  return 0;
+}
+
+
+/**
+ * @param timings Timings of all the stages.
+ *
+ * @brief
+ *    Print the timings of the stages as a table.
+ */
+void printStageTimings(const vector<StageTiming>& timings)
+{
+  cout << setw(14) << "stage" << setw(22) << "input" << setw(8) << "runs" 
+       << setw(12) << "mean ms" << setw(12) << "p50 ms" << setw(12) << "p99 ms" << setw(20) << "throughput" << endl;
+  for (int i=0; i<timings.size(); ++i)
+  {
+    const StageTiming& timing = timings[i];
+    double mean = computeMean(timing.samples);
+    double throughput = timing.itemsPerRun * 1000.0 / std::max(mean, 1e-9);
+    cout << setw(14) << timing.stage << setw(22) << timing.input << setw(8) << timing.samples.size() 
+         << setw(12) << format("%.3f", mean) 
+         << setw(12) << format("%.3f", computePercentile(timing.samples, 0.50)) 
+         << setw(12) << format("%.3f", computePercentile(timing.samples, 0.99)) 
+         << setw(20) << format("%.1f %s/s", throughput, timing.unit.c_str()) << endl;
+  }
+}
+
+
+/**
+ * @param filename Path to the JSON file.
+ * @param timings Timings of all the stages.
+ * @return True if the file is written, and false otherwise.
+ *
+ * @brief
+ *    Write the timings of the stages as a JSON document, with the 
+ *    milliseconds of every run, for the other tools to compare.
+ */
+bool writeStageTimings(const string& filename, const vector<StageTiming>& timings)
+{
+  ofstream ofs(filename.c_str());
+  if (!ofs.is_open()) return false;
+
+  ofs << "{\"stages\":[";
+  for (int i=0; i<timings.size(); ++i)
+  {
+    const StageTiming& timing = timings[i];
+    double mean = computeMean(timing.samples);
+    if (i>0) ofs << ",";
+    ofs << "\n{"
+        << "\"stage\":\"" << timing.stage << "\","
+        << "\"input\":\"" << timing.input << "\","
+        << "\"runs\":" << timing.samples.size() << ","
+        << "\"mean_ms\":" << mean << ","
+        << "\"p50_ms\":" << computePercentile(timing.samples, 0.50) << ","
+        << "\"p99_ms\":" << computePercentile(timing.samples, 0.99) << ","
+        << "\"throughput\":" << timing.itemsPerRun * 1000.0 / std::max(mean, 1e-9) << ","
+        << "\"unit\":\"" << timing.unit << "\","
+        << "\"samples_ms\":[";
+    for (int k=0; k<timing.samples.size(); ++k) ofs << ((k>0)?(","):("")) << timing.samples[k];
+    ofs << "]}";
+  }
+  ofs << "\n]}" << endl;
+
+  return true;
+}
+
+
+/**
+ * @param stage Name of the stage.
+ * @param input Description of the input.
+ * @param itemsPerRun Number of items processed by each run.
+ * @param unit Name of the items processed.
+ * @return A timing with no sample yet.
+ *
+ * @brief
+ *    Create the timing of a stage.
+ */
+StageTiming createStageTiming(const string& stage, const string& input, int itemsPerRun, const string& unit)
+{
+  StageTiming timing;
+  timing.stage = stage;
+  timing.input = input;
+  timing.itemsPerRun = itemsPerRun;
+  timing.unit = unit;
+  return timing;
+}
+
+
+/**
+ * @param fn_cascade Path to the face cascade.
+ * @param dir_data Path to the face database.
+ * @param fn_image Path to the test image.
+ * @param numRuns Number of runs of each stage.
+ * @param fn_json Path to output the timings in JSON format, or 
+ *        empty if not required.
+ * @return An int indicating the operation state.
+ *
+ * @brief
+ *    Benchmark each stage of the face recognition separately: the 
+ *    face database scan, the image decoding, the resizing, the 
+ *    training, the cascade loading, the face detection and the 
+ *    prediction. The test image is also scaled up 2 and 4 times to 
+ *    show how the stages grow with the image size.
+ */
+int benchmarkStages(const string& fn_cascade, const string& dir_data, const string& fn_image, int numRuns, const string& fn_json)
+{
+  vector<StageTiming> timings;
+  numRuns = std::max(numRuns, 1);
+
+  // Load the test image and synthesize its scaled-up variants
+  Mat original = imread(fn_image);
+  if (original.empty())
+  {
+    CV_Error(CV_StsBadArg, "Cannot read the test image " + fn_image + ".");
+  }
+  const int numScales = 3;
+  const int scales[numScales] = { 1, 2, 4 };
+  vector<Mat> frames(numScales);
+  vector< vector<uchar> > encodedFrames(numScales);
+  vector<string> frameNames(numScales);
+  for (int s=0; s<numScales; ++s)
+  {
+    cv::resize(original, frames[s], Size(original.cols * scales[s], original.rows * scales[s]), 0, 0, INTER_CUBIC);
+    imencode(".jpg", frames[s], encodedFrames[s]);
+    frameNames[s] = format("%dx%d", frames[s].cols, frames[s].rows);
+  }
+  cout << "[INFO] Test image is " << frameNames[0] << ", scaled up to " << frameNames[1] << " and " << frameNames[2] << "." << endl;
+
+  // Benchmark the scan of the face database
+  vector<FaceFileRecord> records;
+  map<int, string> names;
+  timings.push_back(createStageTiming("scan", "faces/", 1, "scans"));
+  for (int r=0; r<numRuns; ++r)
+  {
+    int64 startTick = getTickCount();
+    scanFaceData(dir_data, records, names);
+    timings.back().samples.push_back(elapsedMilliseconds(startTick));
+  }
+  if (records.empty())
+  {
+    CV_Error(CV_StsError, "No face image in the face database " + dir_data + ".");
+  }
+
+  // Read the face images into memory, so that only the decoding is 
+  // measured
+  vector< vector<uchar> > encodedFaces(records.size());
+  for (int i=0; i<records.size(); ++i)
+  {
+    string filename = dir_data + "/faces/" + records[i].path;
+    FILE* file = fopen(filename.c_str(), "rb");
+    if (file == NULL) CV_Error(CV_StsError, "Cannot read the face image " + filename + ".");
+    fseek(file, 0, SEEK_END);
+    encodedFaces[i].resize(std::max(ftell(file), 1L));
+    fseek(file, 0, SEEK_SET);
+    size_t length = fread(&encodedFaces[i][0], 1, encodedFaces[i].size(), file);
+    fclose(file);
+    encodedFaces[i].resize(length);
+  }
+
+  // Benchmark the decoding of the face images and the test images
+  vector<Mat> images(records.size());
+  vector<int> labels(records.size());
+  timings.push_back(createStageTiming("decode", format("%d faces", (int)records.size()), (int)records.size(), "images"));
+  for (int r=0; r<numRuns; ++r)
+  {
+    int64 startTick = getTickCount();
+    for (int i=0; i<records.size(); ++i)
+    {
+      images[i] = imdecode(Mat(encodedFaces[i]), 0);
+      labels[i] = records[i].label;
+    }
+    timings.back().samples.push_back(elapsedMilliseconds(startTick));
+  }
+  for (int s=0; s<numScales; ++s)
+  {
+    timings.push_back(createStageTiming("decode", frameNames[s], 1, "images"));
+    for (int r=0; r<numRuns; ++r)
+    {
+      int64 startTick = getTickCount();
+      imdecode(Mat(encodedFrames[s]), 1);
+      timings.back().samples.push_back(elapsedMilliseconds(startTick));
+    }
+  }
+
+  // Benchmark the resizing of the test images for detection and of 
+  // the faces for recognition
+  for (int s=0; s<numScales; ++s)
+  {
+    timings.push_back(createStageTiming("resize", frameNames[s] + " to 320x240", 1, "images"));
+    for (int r=0; r<numRuns; ++r)
+    {
+      Mat resized;
+      int64 startTick = getTickCount();
+      cv::resize(frames[s], resized, Size(320, 240), 1.0, 1.0, INTER_CUBIC);
+      timings.back().samples.push_back(elapsedMilliseconds(startTick));
+    }
+  }
+  timings.push_back(createStageTiming("resize", format("%d faces", (int)images.size()), (int)images.size(), "faces"));
+  for (int r=0; r<numRuns; ++r)
+  {
+    Mat resized;
+    int64 startTick = getTickCount();
+    for (int i=0; i<images.size(); ++i)
+    {
+      cv::resize(images[i], resized, Size(STD_FACE_REC_SIZE, STD_FACE_REC_SIZE), 1.0, 1.0, INTER_CUBIC);
+    }
+    timings.back().samples.push_back(elapsedMilliseconds(startTick));
+  }
+
+  // Benchmark the training of the face recognizer
+  Ptr<FaceRecognizer> model;
+  timings.push_back(createStageTiming("train", format("%d faces", (int)images.size()), 1, "models"));
+  for (int r=0; r<numRuns; ++r)
+  {
+    int64 startTick = getTickCount();
+    model = createFisherFaceRecognizer();
+    model->train(images, labels);
+    timings.back().samples.push_back(elapsedMilliseconds(startTick));
+  }
+
+  // Benchmark the loading of the XML face cascade, and of the binary 
+  // face cascade if it is precompiled
+  FaceCascade haar_cascade;
+  timings.push_back(createStageTiming("cascade-load", "xml", 1, "loads"));
+  for (int r=0; r<numRuns; ++r)
+  {
+    int64 startTick = getTickCount();
+    FaceCascade cascade;
+    if (!cascade.loadXML(fn_cascade))
+    {
+      CV_Error(CV_StsBadArg, "Cannot load the cascade " + fn_cascade + ".");
+    }
+    timings.back().samples.push_back(elapsedMilliseconds(startTick));
+  }
+  string fn_binary = fn_cascade + FACE_CASCADE_BINARY_SUFFIX;
+  if (haar_cascade.loadBinary(fn_binary, fn_cascade))
+  {
+    timings.push_back(createStageTiming("cascade-load", "binary", 1, "loads"));
+    for (int r=0; r<numRuns; ++r)
+    {
+      int64 startTick = getTickCount();
+      FaceCascade cascade;
+      cascade.loadBinary(fn_binary, fn_cascade);
+      timings.back().samples.push_back(elapsedMilliseconds(startTick));
+    }
+  }
+  haar_cascade.load(fn_cascade);
+
+  // Benchmark the face detection on the test images
+  vector< Rect_<int> > faces;
+  for (int s=0; s<numScales; ++s)
+  {
+    Mat gray;
+    cvtColor(frames[s], gray, CV_BGR2GRAY);
+    timings.push_back(createStageTiming("detect", frameNames[s], 1, "images"));
+    for (int r=0; r<numRuns; ++r)
+    {
+      int64 startTick = getTickCount();
+      haar_cascade.detectMultiScale(gray, faces);
+      timings.back().samples.push_back(elapsedMilliseconds(startTick));
+    }
+    cout << "[INFO] " << faces.size() << " faces detected in " << frameNames[s] << "." << endl;
+  }
+
+  // Benchmark the prediction of the faces
+  timings.push_back(createStageTiming("predict", format("%d faces", (int)images.size()), (int)images.size(), "faces"));
+  for (int r=0; r<numRuns; ++r)
+  {
+    int64 startTick = getTickCount();
+    for (int i=0; i<images.size(); ++i)
+    {
+      int prediction = -1;
+      double confidence = 0.0;
+      model->predict(images[i], prediction, confidence);
+    }
+    timings.back().samples.push_back(elapsedMilliseconds(startTick));
+  }
+
+  // Report the timings
+  cout << "[INFO] Timings of " << numRuns << " runs of each stage:" << endl;
+  printStageTimings(timings);
+  if (!fn_json.empty())
+  {
+    if (!writeStageTimings(fn_json, timings))
+    {
+      cerr << "[ERROR] Cannot open the file \"" << fn_json << "\"." << endl;
+      return 1;
+    }
+    cout << "[INFO] Output the timings as \"" << fn_json << "\"" << endl;
+  }
+
+  return 0;
+}
+
+
+/**
+ * @param dir_data Path to the face database.
+ * @param numRuns Number of runs of each prediction.
+ * @return An int indicating the operation state, nonzero if the 
+ *         batch prediction predicts other labels than the face 
+ *         recognizer.
+ *
+ * @brief
+ *    Benchmark the prediction of batches of faces through the face 
+ *    gallery, without SIMD kernels and with each of the SIMD kernels 
+ *    supported by the CPU, against the prediction of the faces one at 
+ *    a time by the face recognizer. The batches of 1 to 200 faces are 
+ *    drawn from the face database in turn.
+ */
+int benchmarkBatchPrediction(const string& dir_data, int numRuns)
+{
+  numRuns = std::max(numRuns, 1);
+
+  // Load the face recognizer and the faces to predict
+  FaceRecConfig config;
+  loadFaceRecConfig(dir_data, config);
+  map<int, string> names;
+  Ptr<FaceRecognizer> model = loadFaceRecognizer(dir_data, config, names);
+  FaceGallery gallery(model);
+  if (gallery.empty())
+  {
+    CV_Error(CV_StsError, "The face recognizer of " + dir_data + " has no gallery.");
+  }
+  vector<Mat> images;
+  vector<int> imageLabels;
+  loadFaceData(dir_data, images, imageLabels, names, config.loaderThreads);
+  if (images.empty())
+  {
+    CV_Error(CV_StsError, "No face image in the face database " + dir_data + ".");
+  }
+
+  SimdLevel widest = detectSimdLevel();
+  cout << "[INFO] Prediction time in ms per face over " << numRuns << " runs, gallery of " << gallery.getSize() 
+       << " faces in " << gallery.getDimensions() << " dimensions, SIMD kernels up to " << getSimdLevelName(widest) << ":" << endl;
+  cout << setw(8) << "faces" << setw(10) << "search" << setw(12) << "time" << setw(10) << "speedup" << setw(8) << "same" << endl;
+
+  bool allSame = true;
+  const int numBatchSizes = 5;
+  const int batchSizes[numBatchSizes] = { 1, 10, 50, 100, 200 };
+  for (int b=0; b<numBatchSizes; ++b)
+  {
+    vector<Mat> faces(batchSizes[b]);
+    for (int i=0; i<faces.size(); ++i) faces[i] = images[i % images.size()];
+
+    // Time the prediction of one face at a time as the reference
+    vector<int> singleLabels(faces.size(), -1);
+    vector<double> singleDistances(faces.size(), 0.0);
+    vector<double> singleSamples;
+    for (int r=0; r<numRuns; ++r)
+    {
+      int64 startTick = getTickCount();
+      for (int i=0; i<faces.size(); ++i) model->predict(faces[i], singleLabels[i], singleDistances[i]);
+      singleSamples.push_back(elapsedMilliseconds(startTick) / faces.size());
+    }
+    double singleTime = computeMean(singleSamples);
+    cout << setw(8) << faces.size() << setw(10) << "single" << setw(12) << format("%.4f", singleTime) 
+         << setw(10) << "1.00" << setw(8) << "-" << endl;
+
+    // Time the batch prediction with each of the SIMD kernels, those 
+    // of SSE4.2 being the ones without SIMD
+    for (int level=SIMD_NONE; level<=widest; ++level)
+    {
+      if (level == SIMD_SSE42) continue;
+      gallery.setSimdLevel((SimdLevel)level);
+      vector<int> batchLabels;
+      vector<double> batchDistances;
+      vector<double> batchSamples;
+      for (int r=0; r<numRuns; ++r)
+      {
+        int64 startTick = getTickCount();
+        gallery.predict(faces, batchLabels, batchDistances);
+        batchSamples.push_back(elapsedMilliseconds(startTick) / faces.size());
+      }
+      bool same = (singleLabels == batchLabels);
+      allSame = allSame && same;
+
+      double batchTime = computeMean(batchSamples);
+      cout << setw(8) << faces.size() << setw(10) << getSimdLevelName(gallery.getSimdLevel()) 
+           << setw(12) << format("%.4f", batchTime) 
+           << setw(10) << format("%.2f", singleTime / std::max(batchTime, 1e-9)) 
+           << setw(8) << (same ? "yes" : "NO") << endl;
+    }
+  }
+
+  if (!allSame)
+  {
+    cerr << "[ERROR] The batch prediction predicts other labels than the face recognizer." << endl;
+    return 1;
+  }
+  return 0;
+}
+
+
+/**
+ * @param numVectors Number of faces of the gallery.
+ * @param dimensions Number of dimensions of the subspace.
+ * @param numQueries Number of faces to predict.
+ * @param rng Random number generator.
+ * @param projections Variable to store the projections of the 
+ *        gallery, one row per face, in "CV_32F".
+ * @param labels Array to store the labels of the gallery.
+ * @param queries Variable to store the projections of the faces to 
+ *        predict, one row per face, in "CV_64F".
+ *
+ * @brief
+ *    Synthesize a gallery of projections clustered by identity, 10 
+ *    faces per identity, and faces to predict, which are faces of 
+ *    the gallery with noise.
+ */
+void synthesizeGallery(int numVectors, int dimensions, int numQueries, RNG& rng, Mat& projections, vector<int>& labels, Mat& queries)
+{
+  int numLabels = std::max(1, numVectors / 10);
+  Mat centers(numLabels, dimensions, CV_32F);
+  rng.fill(centers, RNG::NORMAL, Scalar(0), Scalar(100));
+  projections.create(numVectors, dimensions, CV_32F);
+  rng.fill(projections, RNG::NORMAL, Scalar(0), Scalar(20));
+  labels.resize(numVectors);
+  for (int i=0; i<numVectors; ++i)
+  {
+    labels[i] = i % numLabels;
+    Mat row = projections.row(i);
+    row += centers.row(labels[i]);
+  }
+  queries.create(numQueries, dimensions, CV_64F);
+  rng.fill(queries, RNG::NORMAL, Scalar(0), Scalar(10));
+  for (int i=0; i<numQueries; ++i)
+  {
+    Mat row = queries.row(i);
+    Mat face;
+    projections.row(rng.uniform(0, numVectors)).convertTo(face, CV_64F);
+    row += face;
+  }
+}
+
+
+/**
+ * @param gallery Face gallery, without index.
+ * @param queries Projections of the faces to predict, one row per 
+ *        face, in "CV_64F".
+ * @param lists Number of lists of the index, "0" for about the square
+ *        root of the number of faces of the gallery.
+ * @param fn_index Path to save the index to and load it from again, 
+ *        or empty not to check that it persists.
+ *
+ * @brief
+ *    Build an inverted file index over a face gallery, and time the 
+ *    prediction of the faces through it with an increasing number 
+ *    of lists probed, against the exact scan of the whole gallery. 
+ *    Recall@1 is the fraction of the faces whose closest face found 
+ *    is the closest face of the exact scan.
+ */
+void reportGalleryIndex(FaceGallery& gallery, const Mat& queries, int lists, const string& fn_index)
+{
+  int numQueries = queries.rows;
+
+  // Time the exact scan as the reference
+  gallery.setIndexProbes(0);
+  vector<int> exactLabels;
+  vector<double> exactDistances;
+  int64 startTick = getTickCount();
+  gallery.predictProjections(queries, exactLabels, exactDistances);
+  double exactTime = elapsedMilliseconds(startTick) / numQueries;
+
+  // Build the index, and check that it persists
+  if (lists <= 0) lists = std::max(1, cvRound(std::sqrt((double)gallery.getSize())));
+  startTick = getTickCount();
+  gallery.buildIndex(lists);
+  double buildTime = elapsedMilliseconds(startTick);
+  string strLoad;
+  if (!fn_index.empty())
+  {
+    bool persisted = gallery.saveIndex(fn_index);
+    startTick = getTickCount();
+    persisted = persisted && gallery.loadIndex(fn_index);
+    double loadTime = elapsedMilliseconds(startTick);
+    remove(fn_index.c_str());
+    if (!persisted)
+    {
+      CV_Error(CV_StsError, "Cannot save and load the gallery index " + fn_index + ".");
+    }
+    strLoad = format(" and loaded in %.1f ms", loadTime);
+  }
+  cout << "[INFO] Gallery of " << gallery.getSize() << " faces in " << gallery.getDimensions() << " dimensions, index of " 
+       << gallery.getIndexLists() << " lists built in " << format("%.1f", buildTime) << " ms" << strLoad << "." << endl;
+  cout << "[INFO] Prediction time in ms per face over " << numQueries << " faces:" << endl;
+  cout << setw(8) << "probes" << setw(12) << "time" << setw(10) << "speedup" << setw(10) << "recall@1" << endl;
+  cout << setw(8) << "exact" << setw(12) << format("%.4f", exactTime) << setw(10) << "1.00" << setw(10) << "1.000" << endl;
+
+  // Time the search through the index with more and more lists probed
+  for (int probes=1; ; probes*=2)
+  {
+    probes = std::min(probes, gallery.getIndexLists());
+    gallery.setIndexProbes(probes);
+    vector<int> indexLabels;
+    vector<double> indexDistances;
+    startTick = getTickCount();
+    gallery.predictProjections(queries, indexLabels, indexDistances);
+    double indexTime = elapsedMilliseconds(startTick) / numQueries;
+
+    int found = 0;
+    for (int i=0; i<numQueries; ++i)
+    {
+      if (indexDistances[i] == exactDistances[i]) found++;
+    }
+    cout << setw(8) << probes << setw(12) << format("%.4f", indexTime) 
+         << setw(10) << format("%.2f", exactTime / std::max(indexTime, 1e-9)) 
+         << setw(10) << format("%.3f", (double)found / numQueries) << endl;
+
+    if (probes == gallery.getIndexLists()) break;
+  }
+}
+
+
+/**
+ * @param dir_data Path to the face database.
+ * @param lists Number of lists of the index, "0" for about the square
+ *        root of the number of faces of the gallery.
+ * @param numQueries Number of faces to predict.
+ * @return An int indicating the operation state.
+ *
+ * @brief
+ *    Benchmark the search of the face gallery of the face database 
+ *    through an inverted file index against the exact scan of the 
+ *    whole gallery. The index is built, saved and loaded again, and 
+ *    the faces are predicted with an increasing number of lists 
+ *    probed. The faces are synthesized from the face database with 
+ *    noise.
+ */
+int benchmarkGalleryIndex(const string& dir_data, int lists, int numQueries)
+{
+  numQueries = std::max(numQueries, 1);
+
+  // Load the face recognizer and synthesize the faces to predict
+  FaceRecConfig config;
+  loadFaceRecConfig(dir_data, config);
+  map<int, string> names;
+  Ptr<FaceRecognizer> model = loadFaceRecognizer(dir_data, config, names);
+  FaceGallery gallery(model);
+  if (gallery.empty())
+  {
+    CV_Error(CV_StsError, "The face recognizer of " + dir_data + " has no gallery.");
+  }
+  vector<Mat> images;
+  vector<int> imageLabels;
+  loadFaceData(dir_data, images, imageLabels, names, config.loaderThreads);
+  if (images.empty())
+  {
+    CV_Error(CV_StsError, "No face image in the face database " + dir_data + ".");
+  }
+  RNG rng(0x1d5);
+  vector<Mat> faces(numQueries);
+  for (int i=0; i<numQueries; ++i) faces[i] = synthesizeCapture(images, rng.uniform(0, (int)images.size()), rng);
+  Mat queries;
+  gallery.project(faces, queries);
+
+  reportGalleryIndex(gallery, queries, lists, format("%s/index.%d.bench.yml", dir_data.c_str(), (int)getpid()));
+  return 0;
+}
+
+
+/**
+ * @param numVectors Number of faces of the synthetic gallery.
+ * @param dimensions Number of dimensions of the subspace.
+ * @param lists Number of lists of the index, "0" for about the square
+ *        root of the number of faces of the gallery.
+ * @param numQueries Number of faces to predict.
+ * @return An int indicating the operation state.
+ *
+ * @brief
+ *    Benchmark the search of a synthetic face gallery, as large as 
+ *    the galleries an index is meant for, through an inverted file 
+ *    index against the exact scan of the whole gallery.
+ */
+int benchmarkSyntheticGalleryIndex(int numVectors, int dimensions, int lists, int numQueries)
+{
+  numVectors = std::max(numVectors, 1);
+  dimensions = std::max(dimensions, 1);
+  numQueries = std::max(numQueries, 1);
+
+  // Synthesize the gallery and the faces to predict
+  RNG rng(0x1d5);
+  Mat projections;
+  vector<int> labels;
+  Mat queries;
+  synthesizeGallery(numVectors, dimensions, numQueries, rng, projections, labels, queries);
+  FaceGallery gallery(projections, labels, DBL_MAX);
+
+  cout << "[INFO] Synthetic gallery, SIMD kernels up to " << getSimdLevelName(detectSimdLevel()) << "." << endl;
+  reportGalleryIndex(gallery, queries, lists, "");
+  return 0;
+}
+
+
+/**
+ * @param numVectors Number of faces of the synthetic gallery.
+ * @param dimensions Number of dimensions of the subspace.
+ * @param numQueries Number of faces to predict.
+ * @return An int indicating the operation state.
+ *
+ * @brief
+ *    Benchmark the quantized storages of the face gallery against the 
+ *    storage in single precision, with and without reranking, on a 
+ *    synthetic gallery of "synthesizeGallery()". The agreement is the fraction of the faces predicted the 
+ *    label of the storage in single precision, and the exact match 
+ *    the fraction of the faces predicted at the same distance, which 
+ *    only a reranked storage may reach, its distances being exact.
+ */
+int benchmarkQuantizedGallery(int numVectors, int dimensions, int numQueries)
+{
+  numVectors = std::max(numVectors, 1);
+  dimensions = std::max(dimensions, 1);
+  numQueries = std::max(numQueries, 1);
+
+  // Synthesize the gallery and the faces to predict
+  RNG rng(0x1d5);
+  Mat projections;
+  vector<int> labels;
+  Mat queries;
+  synthesizeGallery(numVectors, dimensions, numQueries, rng, projections, labels, queries);
+
+  cout << "[INFO] Prediction time in ms per face over " << numQueries << " faces, synthetic gallery of " << numVectors 
+       << " faces in " << dimensions << " dimensions, SIMD kernels up to " << getSimdLevelName(detectSimdLevel()) << ":" << endl;
+  cout << setw(10) << "storage" << setw(8) << "rerank" << setw(12) << "memory_mb" << setw(12) << "time" 
+       << setw(10) << "speedup" << setw(11) << "agreement" << setw(8) << "exact" << endl;
+
+  // Time the storage in single precision as the reference, and each 
+  // quantized storage without and with reranking
+  vector<int> exactLabels;
+  vector<double> exactDistances;
+  double exactTime = 0.0;
+  const int numSettings = 5;
+  const GalleryStorage storages[numSettings] = { GALLERY_STORAGE_FLOAT32, GALLERY_STORAGE_FLOAT16, GALLERY_STORAGE_FLOAT16, 
+                                                 GALLERY_STORAGE_INT8, GALLERY_STORAGE_INT8 };
+  const int reranks[numSettings] = { 0, 0, 16, 0, 16 };
+  for (int s=0; s<numSettings; ++s)
+  {
+    FaceGallery gallery(projections, labels, DBL_MAX);
+    gallery.quantize(storages[s], reranks[s]);
+
+    vector<int> predictedLabels;
+    vector<double> predictedDistances;
+    int64 startTick = getTickCount();
+    gallery.predictProjections(queries, predictedLabels, predictedDistances);
+    double time = elapsedMilliseconds(startTick) / numQueries;
+    if (s == 0)
+    {
+      exactLabels = predictedLabels;
+      exactDistances = predictedDistances;
+      exactTime = time;
+    }
+
+    int agreed = 0;
+    int matched = 0;
+    for (int i=0; i<numQueries; ++i)
+    {
+      if (predictedLabels[i] == exactLabels[i]) agreed++;
+      if (predictedDistances[i] == exactDistances[i]) matched++;
+    }
+    cout << setw(10) << getGalleryStorageName(gallery.getStorage()) << setw(8) << gallery.getRerank() 
+         << setw(12) << format("%.1f", gallery.getMemorySize() / 1048576.0) << setw(12) << format("%.4f", time) 
+         << setw(10) << format("%.2f", exactTime / std::max(time, 1e-9)) 
+         << setw(11) << format("%.4f", (double)agreed / numQueries) 
+         << setw(8) << format("%.4f", (double)matched / numQueries) << endl;
+  }
+
+  return 0;
+}
+
+
+/**
+ * @param dir_data Path to the face database.
+ * @param numHeldOut Largest number of faces held out in turn for the 
+ *        leave-one-out accuracy.
+ * @return An int indicating the operation state.
+ *
+ * @brief
+ *    Benchmark each face recognizer backend on the face database: the 
+ *    time to train on the whole face database, the time to predict a 
+ *    face one at a time, the size of the cached model, and the 
+ *    leave-one-out accuracy, each face held out in turn being 
+ *    predicted by a face recognizer trained on all the other faces. 
+ *    The faces held out are spread evenly over the face database.
+ */
+int benchmarkRecognizerBackends(const string& dir_data, int numHeldOut)
+{
+  // Load the face database
+  FaceRecConfig config;
+  loadFaceRecConfig(dir_data, config);
+  vector<Mat> images;
+  vector<int> labels;
+  map<int, string> names;
+  loadFaceData(dir_data, images, labels, names, config.loaderThreads);
+  if (images.size() < 2)
+  {
+    CV_Error(CV_StsError, "Too few face images in the face database " + dir_data + ".");
+  }
+  numHeldOut = std::max(1, std::min(numHeldOut, (int)images.size()));
+
+  cout << "[INFO] Face database of " << images.size() << " faces of " << names.size() << " persons, " 
+       << numHeldOut << " faces held out in turn:" << endl;
+  cout << setw(14) << "backend" << setw(12) << "train_ms" << setw(14) << "predict_ms" 
+       << setw(12) << "model_kb" << setw(10) << "accuracy" << endl;
+
+  const int numBackends = 3;
+  const char* backends[numBackends] = { "eigenfaces", "fisherfaces", "lbph" };
+  for (int b=0; b<numBackends; ++b)
+  {
+    // Time the training on the whole face database
+    int64 startTick = getTickCount();
+    Ptr<FaceRecognizer> model = createFaceRecognizer(backends[b]);
+    model->train(images, labels);
+    double trainTime = elapsedMilliseconds(startTick);
+
+    // Time the prediction of the faces one at a time
+    startTick = getTickCount();
+    for (int i=0; i<images.size(); ++i)
+    {
+      int prediction = -1;
+      double confidence = 0.0;
+      model->predict(images[i], prediction, confidence);
+    }
+    double predictTime = elapsedMilliseconds(startTick) / images.size();
+
+    // Measure the size of the model as cached
+    FileStorage fs(".yml", FileStorage::WRITE + FileStorage::MEMORY);
+    model->save(fs);
+    double modelSize = fs.releaseAndGetString().size() / 1024.0;
+
+    // Predict each face held out by a face recognizer trained on all 
+    // the other faces
+    int correct = 0;
+    for (int h=0; h<numHeldOut; ++h)
+    {
+      int heldOut = (int)((long long)h * images.size() / numHeldOut);
+      vector<Mat> trainImages;
+      vector<int> trainLabels;
+      for (int i=0; i<images.size(); ++i)
+      {
+        if (i == heldOut) continue;
+        trainImages.push_back(images[i]);
+        trainLabels.push_back(labels[i]);
+      }
+      Ptr<FaceRecognizer> heldOutModel = createFaceRecognizer(backends[b]);
+      heldOutModel->train(trainImages, trainLabels);
+      if (heldOutModel->predict(images[heldOut]) == labels[heldOut]) correct++;
+    }
+
+    cout << setw(14) << backends[b] << setw(12) << format("%.1f", trainTime) << setw(14) << format("%.4f", predictTime) 
+         << setw(12) << format("%.1f", modelSize) << setw(10) << format("%.3f", (double)correct / numHeldOut) << endl;
+  }
+
+  return 0;
+}
+
+
+/**
+ * @param a A rectangle.
+ * @param b Another rectangle.
+ * @return Area of the intersection over area of the union.
+ *
+ * @brief
+ *    Compute the overlap of two rectangles.
+ */
+double computeOverlap(const Rect& a, const Rect& b)
+{
+  Rect intersection = a & b;
+  double unionArea = (double)a.area() + b.area() - intersection.area();
+  return (unionArea > 0.0) ? intersection.area() / unionArea : 0.0;
+}
+
+
+/**
+ * @param reference Faces detected at full resolution.
+ * @param found Faces detected at a lower resolution.
+ * @return Fraction of the reference faces found.
+ *
+ * @brief
+ *    Compute the recall of a detection against the detection at 
+ *    full resolution. A reference face is found if a face overlaps 
+ *    it by at least a half, and each face is matched once.
+ */
+double computeDetectionRecall(const vector<Rect>& reference, const vector<Rect>& found)
+{
+  if (reference.empty()) return 1.0;
+  vector<bool> matched(found.size(), false);
+  int numFound = 0;
+  for (int i=0; i<reference.size(); ++i)
+  {
+    for (int j=0; j<found.size(); ++j)
+    {
+      if (!matched[j] && computeOverlap(reference[i], found[j]) >= 0.5)
+      {
+        matched[j] = true;
+        numFound++;
+        break;
+      }
+    }
+  }
+  return (double)numFound / reference.size();
+}
+
+
+/**
+ * @param fn_cascade Path to the face cascade.
+ * @param fn_image Path to the test image.
+ * @param numRuns Number of runs of each detection.
+ * @return An int indicating the operation state.
+ *
+ * @brief
+ *    Benchmark the detection speed against the detection recall for 
+ *    the detection resolution policies, on the test image and on its 
+ *    variant scaled up 4 times. The recall is measured against the 
+ *    detection at full resolution.
+ */
+int benchmarkDetectionScale(const string& fn_cascade, const string& fn_image, int numRuns)
+{
+  numRuns = std::max(numRuns, 1);
+
+  // Load the face detecter and the test image
+  FaceCascade haar_cascade;
+  if (!haar_cascade.load(fn_cascade))
+  {
+    CV_Error(CV_StsBadArg, "Cannot load the cascade " + fn_cascade + ".");
+  }
+  Mat original = imread(fn_image);
+  if (original.empty())
+  {
+    CV_Error(CV_StsBadArg, "Cannot read the test image " + fn_image + ".");
+  }
+  Size windowSize = obtainDetectionWindowSize(haar_cascade);
+
+  // List the detection resolution policies
+  vector<FaceRecConfig> policies;
+  vector<string> policyNames;
+  const int numMaxSides = 6;
+  const int maxSides[numMaxSides] = { 2048, 1280, 960, 640, 480, 320 };
+  const int numMinFaces = 3;
+  const int minFaces[numMinFaces] = { 40, 80, 120 };
+  policies.push_back(FaceRecConfig());
+  policyNames.push_back("full");
+  for (int k=0; k<numMaxSides; ++k)
+  {
+    policies.push_back(FaceRecConfig());
+    policies.back().detectMaxSide = maxSides[k];
+    policyNames.push_back(format("max_side %d", maxSides[k]));
+  }
+  for (int k=0; k<numMinFaces; ++k)
+  {
+    policies.push_back(FaceRecConfig());
+    policies.back().detectMinFace = minFaces[k];
+    policyNames.push_back(format("min_face %d", minFaces[k]));
+  }
+
+  cout << "[INFO] Detection time in ms over " << numRuns << " runs, and recall against full resolution:" << endl;
+  cout << setw(12) << "image" << setw(16) << "policy" << setw(12) << "detect" 
+       << setw(12) << "mean ms" << setw(12) << "p50 ms" << setw(8) << "faces" << setw(10) << "recall" << endl;
+
+  // Benchmark the test image and its scaled-up variant
+  const int numScales = 2;
+  const int scales[numScales] = { 1, 4 };
+  for (int s=0; s<numScales; ++s)
+  {
+    Mat frame;
+    cv::resize(original, frame, Size(original.cols * scales[s], original.rows * scales[s]), 0, 0, INTER_CUBIC);
+    Mat gray;
+    cvtColor(frame, gray, CV_BGR2GRAY);
+    string frameName = format("%dx%d", frame.cols, frame.rows);
+
+    vector<Rect> reference;
+    for (int p=0; p<policies.size(); ++p)
+    {
+      // Skip the policies not downscaling the image
+      double fscale = computeDetectionScale(gray.size(), windowSize, policies[p]);
+      if (p > 0 && fscale >= 1.0) continue;
+
+      // Detect the faces with the policy
+      vector<Rect> faces;
+      vector<double> samples;
+      for (int r=0; r<numRuns; ++r)
+      {
+        int64 startTick = getTickCount();
+        detectFaces(haar_cascade, gray, policies[p], faces);
+        samples.push_back(elapsedMilliseconds(startTick));
+      }
+      if (p == 0) reference = faces;
+
+      cout << setw(12) << frameName << setw(16) << policyNames[p] 
+           << setw(12) << format("%dx%d", cvRound(gray.cols * fscale), cvRound(gray.rows * fscale)) 
+           << setw(12) << format("%.3f", computeMean(samples)) 
+           << setw(12) << format("%.3f", computePercentile(samples, 0.50)) 
+           << setw(8) << faces.size() 
+           << setw(10) << format("%.2f", computeDetectionRecall(reference, faces)) << endl;
+    }
+  }
+
+  return 0;
+}
+
+
+/**
+ * @param a A rectangle.
+ * @param b Another rectangle.
+ * @return True if the first rectangle goes before the second one.
+ *
+ * @brief
+ *    Order the rectangles by position and then by size.
+ */
+bool compareRects(const Rect& a, const Rect& b)
+{
+  if (a.y != b.y) return a.y < b.y;
+  if (a.x != b.x) return a.x < b.x;
+  if (a.width != b.width) return a.width < b.width;
+  return a.height < b.height;
+}
+
+
+/**
+ * @param a Faces detected.
+ * @param b Other faces detected.
+ * @return True if the faces are the same regardless of the order.
+ *
+ * @brief
+ *    Compare two detections.
+ */
+bool isSameDetection(vector<Rect> a, vector<Rect> b)
+{
+  if (a.size() != b.size()) return false;
+  std::sort(a.begin(), a.end(), compareRects);
+  std::sort(b.begin(), b.end(), compareRects);
+  for (int i=0; i<a.size(); ++i)
+  {
+    if (a[i] != b[i]) return false;
+  }
+  return true;
+}
+
+
+/**
+ * @param fn_cascade Path to the face cascade.
+ * @param fn_image Path to the test image.
+ * @param maxThreads Largest number of detection threads.
+ * @param numRuns Number of runs of each detection.
+ * @return An int indicating the operation state.
+ *
+ * @brief
+ *    Benchmark the speedup of the parallel pyramid detection from 1 
+ *    to the largest number of threads, on the test image and on its 
+ *    variants scaled up 2 and 4 times, and check that the faces are 
+ *    the same as those of the serial detection.
+ */
+int benchmarkDetectionThreads(const string& fn_cascade, const string& fn_image, int maxThreads, int numRuns)
+{
+  numRuns = std::max(numRuns, 1);
+  maxThreads = std::max(maxThreads, 1);
+
+  // Load a face detecter per thread and the test image
+  vector< Ptr<FaceCascade> > detectors;
+  vector<CascadeClassifier*> cascades;
+  for (int t=0; t<maxThreads; ++t)
+  {
+    detectors.push_back(new FaceCascade());
+    if (!detectors.back()->load(fn_cascade))
+    {
+      CV_Error(CV_StsBadArg, "Cannot load the cascade " + fn_cascade + ".");
+    }
+    cascades.push_back(detectors.back());
+  }
+  Mat original = imread(fn_image);
+  if (original.empty())
+  {
+    CV_Error(CV_StsBadArg, "Cannot read the test image " + fn_image + ".");
+  }
+
+  cout << "[INFO] Detection time in ms over " << numRuns << " runs, and speedup over 1 thread:" << endl;
+  cout << setw(12) << "image" << setw(10) << "threads" << setw(12) << "mean ms" << setw(12) << "p50 ms" 
+       << setw(10) << "speedup" << setw(8) << "faces" << setw(8) << "same" << endl;
+
+  // Benchmark the test image and its scaled-up variants
+  FaceRecConfig config;
+  const int numScales = 3;
+  const int scales[numScales] = { 1, 2, 4 };
+  for (int s=0; s<numScales; ++s)
+  {
+    Mat frame;
+    cv::resize(original, frame, Size(original.cols * scales[s], original.rows * scales[s]), 0, 0, INTER_CUBIC);
+    Mat gray;
+    cvtColor(frame, gray, CV_BGR2GRAY);
+    string frameName = format("%dx%d", frame.cols, frame.rows);
+
+    // Detect serially as the reference
+    vector<Rect> reference;
+    detectFacesInScaledImage(*cascades[0], gray, 1.0, config, reference);
+
+    double serialTime = 0.0;
+    for (int t=1; t<=maxThreads; ++t)
+    {
+      vector<CascadeClassifier*> threadCascades(cascades.begin(), cascades.begin() + t);
+      vector<Rect> faces;
+      vector<double> samples;
+      for (int r=0; r<numRuns; ++r)
+      {
+        int64 startTick = getTickCount();
+        detectFacesInScaledImage(threadCascades, gray, 1.0, config, faces);
+        samples.push_back(elapsedMilliseconds(startTick));
+      }
+      double mean = computeMean(samples);
+      if (t == 1) serialTime = mean;
+
+      cout << setw(12) << frameName << setw(10) << t 
+           << setw(12) << format("%.3f", mean) 
+           << setw(12) << format("%.3f", computePercentile(samples, 0.50)) 
+           << setw(10) << format("%.2f", serialTime / std::max(mean, 1e-9)) 
+           << setw(8) << faces.size() 
+           << setw(8) << (isSameDetection(reference, faces) ? "yes" : "NO") << endl;
+    }
+  }
+
+  return 0;
+}
+
+
+/**
+ * @param fn_cascade Path to the face cascade.
+ * @param fn_image Path to the test image.
+ * @param numRuns Number of runs of each detection.
+ * @return An int indicating the operation state, nonzero if the 
+ *         compiled cascade detects other faces than the generic face 
+ *         detecter.
+ *
+ * @brief
+ *    Benchmark the cascade compiled into the binary, without SIMD 
+ *    kernels and with each of the SIMD kernels supported by the CPU, 
+ *    against the generic face detecter with the same cascade, on the 
+ *    test image and on its variants scaled up 2 and 4 times, and check 
+ *    that both the ungrouped candidates and the faces are identical.
+ */
+int benchmarkCompiledCascade(const string& fn_cascade, const string& fn_image, int numRuns)
+{
+  numRuns = std::max(numRuns, 1);
+
+  // Load the face detecter and the test image
+  FaceCascade haar_cascade;
+  if (!haar_cascade.load(fn_cascade))
+  {
+    CV_Error(CV_StsBadArg, "Cannot load the cascade " + fn_cascade + ".");
+  }
+  const CompiledCascade* compiled = haar_cascade.getCompiledCascade();
+  if (compiled == NULL)
+  {
+    CV_Error(CV_StsBadArg, "No cascade compiled into the binary matches the cascade " + fn_cascade + ".");
+  }
+  Mat original = imread(fn_image);
+  if (original.empty())
+  {
+    CV_Error(CV_StsBadArg, "Cannot read the test image " + fn_image + ".");
+  }
+
+  SimdLevel widest = detectSimdLevel();
+  cout << "[INFO] Detection time in ms over " << numRuns << " runs with the compiled cascade \"" << compiled->name 
+       << "\", SIMD kernels up to " << getSimdLevelName(widest) << ":" << endl;
+  cout << setw(12) << "image" << setw(12) << "detecter" << setw(12) << "time" << setw(10) << "speedup" 
+       << setw(12) << "candidates" << setw(8) << "faces" << setw(8) << "same" << endl;
+
+  // Benchmark the test image and its scaled-up variants
+  FaceRecConfig config;
+  bool allSame = true;
+  const int numScales = 3;
+  const int scales[numScales] = { 1, 2, 4 };
+  for (int s=0; s<numScales; ++s)
+  {
+    Mat frame;
+    cv::resize(original, frame, Size(original.cols * scales[s], original.rows * scales[s]), 0, 0, INTER_CUBIC);
+    Mat gray;
+    cvtColor(frame, gray, CV_BGR2GRAY);
+    string frameName = format("%dx%d", frame.cols, frame.rows);
+
+    // Time the generic face detecter as the reference
+    vector<Rect> genericCandidates;
+    vector<Rect> genericFaces;
+    vector<double> genericSamples;
+    haar_cascade.detectMultiScale(gray, genericCandidates, config.detectScaleFactor, 0, 0);
+    for (int r=0; r<numRuns; ++r)
+    {
+      int64 startTick = getTickCount();
+      haar_cascade.detectMultiScale(gray, genericFaces, config.detectScaleFactor, config.detectMinNeighbors, 0);
+      genericSamples.push_back(elapsedMilliseconds(startTick));
+    }
+    double genericTime = computeMean(genericSamples);
+    cout << setw(12) << frameName 
+         << setw(12) << "generic" 
+         << setw(12) << format("%.3f", genericTime) 
+         << setw(10) << "1.00" 
+         << setw(12) << genericCandidates.size() 
+         << setw(8) << genericFaces.size() 
+         << setw(8) << "-" << endl;
+
+    // Time the compiled cascade with each of the SIMD kernels
+    for (int level=SIMD_NONE; level<=widest; ++level)
+    {
+      SimdLevel simd = (SimdLevel)level;
+
+      // Compare the ungrouped candidates, which would hide no difference
+      vector<Rect> compiledCandidates;
+      detectCompiledCascade(*compiled, gray, compiledCandidates, config.detectScaleFactor, 0, Size(), Size(), simd);
+      bool same = isSameDetection(genericCandidates, compiledCandidates);
+
+      vector<Rect> compiledFaces;
+      vector<double> compiledSamples;
+      for (int r=0; r<numRuns; ++r)
+      {
+        int64 startTick = getTickCount();
+        detectCompiledCascade(*compiled, gray, compiledFaces, config.detectScaleFactor, config.detectMinNeighbors, Size(), Size(), simd);
+        compiledSamples.push_back(elapsedMilliseconds(startTick));
+      }
+      same = same && isSameDetection(genericFaces, compiledFaces);
+      allSame = allSame && same;
+
+      double compiledTime = computeMean(compiledSamples);
+      cout << setw(12) << frameName 
+           << setw(12) << getSimdLevelName(simd) 
+           << setw(12) << format("%.3f", compiledTime) 
+           << setw(10) << format("%.2f", genericTime / std::max(compiledTime, 1e-9)) 
+           << setw(12) << compiledCandidates.size() 
+           << setw(8) << compiledFaces.size() 
+           << setw(8) << (same ? "yes" : "NO") << endl;
+    }
+  }
+
+  if (!allSame)
+  {
+    cerr << "[ERROR] The compiled cascade detects other faces than the generic face detecter." << endl;
+    return 1;
+  }
+  return 0;
+}
+
+
+/**
+ * @param fn_cascade Path to the face cascade.
+ * @param fn_image Path to the test image.
+ * @param numFrames Number of frames to simulate.
+ * @param scanInterval Frames between two full-frame scans.
+ * @return An int indicating the operation state.
+ *
+ * @brief
+ *    Benchmark the face tracking of FaceCollection against the 
+ *    full-frame detection of every frame, on a video stream 
+ *    simulated by panning a 320x240 frame slowly over the test 
+ *    image, as the frames are detected in FaceCollection.
+ */
+int benchmarkTracking(const string& fn_cascade, const string& fn_image, int numFrames, int scanInterval)
+{
+  numFrames = std::max(numFrames, 1);
+
+  // Load the face detecter and the test image
+  FaceCascade haar_cascade;
+  if (!haar_cascade.load(fn_cascade))
+  {
+    CV_Error(CV_StsBadArg, "Cannot load the cascade " + fn_cascade + ".");
+  }
+  Mat original = imread(fn_image, 0);
+  if (original.empty())
+  {
+    CV_Error(CV_StsBadArg, "Cannot read the test image " + fn_image + ".");
+  }
+
+  // Fit the test image to a margin larger than a frame to pan over
+  const int panRange = 16;
+  Size frameSize(320, 240);
+  double fitScale = std::max((double)(frameSize.width + panRange) / original.cols, (double)(frameSize.height + panRange) / original.rows);
+  Mat scene;
+  cv::resize(original, scene, Size(cvCeil(original.cols * fitScale), cvCeil(original.rows * fitScale)), 0, 0, INTER_AREA);
+
+  // Detect every frame in full and with the tracking
+  FaceRecConfig config;
+  FaceTracker tracker(scanInterval, config.trackMargin);
+  vector<double> fullSamples;
+  vector<double> trackSamples;
+  double searchedFraction = 0.0;
+  int numFullFaces = 0;
+  int numTrackFaces = 0;
+  int numFullScans = 0;
+  for (int k=0; k<numFrames; ++k)
+  {
+    // Pan the frame back and forth by a pixel per frame
+    int offset = k % (2 * panRange);
+    if (offset >= panRange) offset = 2 * panRange - offset;
+    Mat frame = scene(Rect(offset, offset / 2, frameSize.width, frameSize.height));
+
+    vector<Rect> faces;
+    int64 startTick = getTickCount();
+    detectFacesInScaledImage(haar_cascade, frame, 1.0, config, faces);
+    fullSamples.push_back(elapsedMilliseconds(startTick));
+    numFullFaces += (int)faces.size();
+
+    startTick = getTickCount();
+    tracker.detect(haar_cascade, frame, 1.0, config, faces);
+    trackSamples.push_back(elapsedMilliseconds(startTick));
+    numTrackFaces += (int)faces.size();
+    searchedFraction += tracker.getSearchedFraction();
+    if (tracker.isFullScan()) numFullScans++;
+  }
+
+  // Report the detection cost per frame
+  double fullMean = computeMean(fullSamples);
+  double trackMean = computeMean(trackSamples);
+  cout << "[INFO] " << numFrames << " frames of " << frameSize.width << "x" << frameSize.height 
+       << ", full-frame scan every " << scanInterval << " frames when tracking:" << endl;
+  cout << setw(10) << "mode" << setw(12) << "mean ms" << setw(12) << "p50 ms" << setw(12) << "p99 ms" 
+       << setw(14) << "faces/frame" << setw(12) << "searched" << endl;
+  cout << setw(10) << "full" << setw(12) << format("%.3f", fullMean) 
+       << setw(12) << format("%.3f", computePercentile(fullSamples, 0.50)) 
+       << setw(12) << format("%.3f", computePercentile(fullSamples, 0.99)) 
+       << setw(14) << format("%.2f", (double)numFullFaces / numFrames) 
+       << setw(12) << "1.000" << endl;
+  cout << setw(10) << "track" << setw(12) << format("%.3f", trackMean) 
+       << setw(12) << format("%.3f", computePercentile(trackSamples, 0.50)) 
+       << setw(12) << format("%.3f", computePercentile(trackSamples, 0.99)) 
+       << setw(14) << format("%.2f", (double)numTrackFaces / numFrames) 
+       << setw(12) << format("%.3f", searchedFraction / numFrames) << endl;
+  cout << "[INFO] Tracking scanned " << numFullScans << " full frames and took " 
+       << format("%.2f", trackMean / std::max(fullMean, 1e-9)) << " of the full-frame detection time." << endl;
+
+  return 0;
+}
+
+
+/**
+ * @param fn_cascade Path to the face cascade.
+ * @param fn_image Path to the test image.
+ * @param numFrames Number of frames to simulate.
+ * @param threshold Difference of a changed pixel from the background.
+ * @return An int indicating the operation state.
+ *
+ * @brief
+ *    Benchmark the detection cost per frame of the motion gating 
+ *    against the full-frame detection of every frame, on a video 
+ *    stream from a static camera simulated from the test image. 
+ *    Periods of 50 frames of a still scene with sensor noise 
+ *    alternate with periods of 50 frames of motion, where a 320x240 
+ *    frame pans slowly over the test image.
+ */
+int benchmarkMotionGate(const string& fn_cascade, const string& fn_image, int numFrames, int threshold)
+{
+  numFrames = std::max(numFrames, 1);
+
+  // Load the face detecter and the test image
+  FaceCascade haar_cascade;
+  if (!haar_cascade.load(fn_cascade))
+  {
+    CV_Error(CV_StsBadArg, "Cannot load the cascade " + fn_cascade + ".");
+  }
+  Mat original = imread(fn_image, 0);
+  if (original.empty())
+  {
+    CV_Error(CV_StsBadArg, "Cannot read the test image " + fn_image + ".");
+  }
+
+  // Fit the test image to a margin larger than a frame to pan over
+  const int panRange = 16;
+  const int periodFrames = 50;
+  Size frameSize(320, 240);
+  double fitScale = std::max((double)(frameSize.width + panRange) / original.cols, (double)(frameSize.height + panRange) / original.rows);
+  Mat scene;
+  cv::resize(original, scene, Size(cvCeil(original.cols * fitScale), cvCeil(original.rows * fitScale)), 0, 0, INTER_AREA);
+
+  // Detect every frame in full and with the motion gating
+  FaceRecConfig config;
+  MotionGate motionGate(threshold, config.motionMinArea, config.motionScanInterval);
+  vector<double> fullSamples;
+  vector<double> gateSamples[2];
+  double searchedFraction = 0.0;
+  double recall = 0.0;
+  int numIdleFrames = 0;
+  int numFullScans = 0;
+  int offset = 0;
+  for (int k=0; k<numFrames; ++k)
+  {
+    // Pan the frame back and forth by a pixel per frame in the 
+    // periods of motion, and add sensor noise to every frame
+    bool moving = (k / periodFrames) % 2 == 1;
+    if (moving) offset = (offset + 1) % (2 * panRange);
+    int shift = (offset >= panRange) ? 2 * panRange - offset : offset;
+    Mat noise(frameSize, CV_16SC1);
+    randn(noise, Scalar(0), Scalar(2));
+    Mat frame;
+    scene(Rect(shift, shift / 2, frameSize.width, frameSize.height)).convertTo(frame, CV_16SC1);
+    frame += noise;
+    frame.convertTo(frame, CV_8UC1);
+
+    vector<Rect> fullFaces;
+    int64 startTick = getTickCount();
+    detectFacesInScaledImage(haar_cascade, frame, 1.0, config, fullFaces);
+    fullSamples.push_back(elapsedMilliseconds(startTick));
+
+    vector<Rect> gateFaces;
+    startTick = getTickCount();
+    motionGate.detect(haar_cascade, frame, 1.0, config, gateFaces);
+    gateSamples[moving ? 1 : 0].push_back(elapsedMilliseconds(startTick));
+    searchedFraction += motionGate.getSearchedFraction();
+    recall += computeDetectionRecall(fullFaces, gateFaces);
+    if (motionGate.isIdle()) numIdleFrames++;
+    if (motionGate.isFullScan()) numFullScans++;
+  }
+
+  // Report the detection cost per frame
+  double fullMean = computeMean(fullSamples);
+  cout << "[INFO] " << numFrames << " frames of " << frameSize.width << "x" << frameSize.height 
+       << ", motion threshold " << threshold << ":" << endl;
+  cout << setw(10) << "mode" << setw(12) << "mean ms" << setw(12) << "p50 ms" << setw(12) << "p99 ms" << endl;
+  cout << setw(10) << "full" << setw(12) << format("%.3f", fullMean) 
+       << setw(12) << format("%.3f", computePercentile(fullSamples, 0.50)) 
+       << setw(12) << format("%.3f", computePercentile(fullSamples, 0.99)) << endl;
+  const char* phaseNames[2] = { "still", "moving" };
+  for (int p=0; p<2; ++p)
+  {
+    if (gateSamples[p].empty()) continue;
+    cout << setw(10) << phaseNames[p] << setw(12) << format("%.3f", computeMean(gateSamples[p])) 
+         << setw(12) << format("%.3f", computePercentile(gateSamples[p], 0.50)) 
+         << setw(12) << format("%.3f", computePercentile(gateSamples[p], 0.99)) << endl;
+  }
+  cout << "[INFO] Motion gating reused the faces of " << numIdleFrames << " frames, scanned " << numFullScans 
+       << " full frames, searched " << format("%.3f", searchedFraction / numFrames) 
+       << " of a frame and found " << format("%.2f", recall / numFrames) << " of the faces of the full-frame detection." << endl;
+
+  return 0;
+}
+
+
+/**
+ * @param fn_cascade Path to the Haar cascade.
+ * @param fn_image Path to the test image.
+ * @param numRuns Number of runs of each detection.
+ * @return An int indicating the operation state.
+ *
+ * @brief
+ *    Benchmark the detection backends against each other, on the test 
+ *    image and on its variants scaled up 2 and 4 times. The LBP 
+ *    cascade is found next to the Haar cascade as the applications 
+ *    find it. The agreement is the fraction of the faces of each 
+ *    backend also found by the other one.
+ */
+int benchmarkDetectionBackends(const string& fn_cascade, const string& fn_image, int numRuns)
+{
+  numRuns = std::max(numRuns, 1);
+
+  // Load the face detecters of both backends and the test image
+  const int numBackends = 2;
+  const char* backends[numBackends] = { "haar", "lbp" };
+  FaceRecConfig configs[numBackends];
+  FaceCascade cascades[numBackends];
+  for (int b=0; b<numBackends; ++b)
+  {
+    configs[b].detectBackend = backends[b];
+    if (!loadDetectionCascade(cascades[b], fn_cascade, configs[b]))
+    {
+      CV_Error(CV_StsBadArg, "Cannot load the cascade " + obtainDetectionCascadePath(fn_cascade, configs[b]) + ".");
+    }
+  }
+  Mat original = imread(fn_image);
+  if (original.empty())
+  {
+    CV_Error(CV_StsBadArg, "Cannot read the test image " + fn_image + ".");
+  }
+
+  cout << "[INFO] Detection time in ms over " << numRuns << " runs, and agreement between the backends:" << endl;
+  cout << setw(12) << "image" << setw(10) << "backend" << setw(12) << "mean ms" << setw(12) << "p50 ms" 
+       << setw(10) << "speedup" << setw(8) << "faces" << setw(10) << "agreed" << endl;
+
+  // Benchmark the test image and its scaled-up variants
+  const int numScales = 3;
+  const int scales[numScales] = { 1, 2, 4 };
+  for (int s=0; s<numScales; ++s)
+  {
+    Mat frame;
+    cv::resize(original, frame, Size(original.cols * scales[s], original.rows * scales[s]), 0, 0, INTER_CUBIC);
+    Mat gray;
+    cvtColor(frame, gray, CV_BGR2GRAY);
+    string frameName = format("%dx%d", frame.cols, frame.rows);
+
+    // Detect the faces with each backend
+    vector<Rect> faces[numBackends];
+    vector<double> samples[numBackends];
+    for (int b=0; b<numBackends; ++b)
+    {
+      for (int r=0; r<numRuns; ++r)
+      {
+        int64 startTick = getTickCount();
+        detectFaces(cascades[b], gray, configs[b], faces[b]);
+        samples[b].push_back(elapsedMilliseconds(startTick));
+      }
+    }
+
+    // Compare each backend with the other one
+    double haarTime = computeMean(samples[0]);
+    for (int b=0; b<numBackends; ++b)
+    {
+      double time = computeMean(samples[b]);
+      cout << setw(12) << frameName << setw(10) << backends[b] 
+           << setw(12) << format("%.3f", time) 
+           << setw(12) << format("%.3f", computePercentile(samples[b], 0.50)) 
+           << setw(10) << format("%.2f", haarTime / std::max(time, 1e-9)) 
+           << setw(8) << faces[b].size() 
+           << setw(10) << format("%.2f", computeDetectionRecall(faces[b], faces[1 - b])) << endl;
+    }
+  }
+
+  return 0;
+}
+
+
+/**
+ * @param filename Path to the sample list.
+ * @param imagePaths Array to store the paths to the sample images.
+ * @param labelledFaces Array to store the faces labelled in each 
+ *        sample image.
+ * @return True if the sample list is read, and false otherwise.
+ *
+ * @brief
+ *    Load a labelled sample set for face detection. Each line of the 
+ *    sample list is the path to an image, relative to the sample 
+ *    list, followed by "<x> <y> <width> <height>" for each face in 
+ *    the image.
+ */
+bool loadDetectionSamples(const string& filename, vector<string>& imagePaths, vector< vector<Rect> >& labelledFaces)
+{
+  ifstream ifs(filename.c_str());
+  if (!ifs.is_open()) return false;
+
+  size_t pos = filename.find_last_of('/');
+  string dirpath = (pos == string::npos) ? string(".") : filename.substr(0, pos);
+
+  string line;
+  while (getline(ifs, line))
+  {
+    stringstream ssLine(line);
+    string imagePath;
+    if (!(ssLine >> imagePath) || imagePath[0] == '#') continue;
+    if (imagePath[0] != '/') imagePath = dirpath + "/" + imagePath;
+
+    vector<Rect> faces;
+    Rect face;
+    while (ssLine >> face.x >> face.y >> face.width >> face.height) faces.push_back(face);
+
+    imagePaths.push_back(imagePath);
+    labelledFaces.push_back(faces);
+  }
+
+  return !imagePaths.empty();
+}
+
+
+/**
+ * @param haar_cascade Face detecter.
+ * @param grays Sample images in grayscale.
+ * @param labelledFaces Faces labelled in each sample image.
+ * @param config Configuration with the detection parameters.
+ * @param recall Variable to store the recall over all the samples.
+ * @return Mean milliseconds to detect the faces in a sample image.
+ *
+ * @brief
+ *    Measure the detection time and recall of the detection 
+ *    parameters on a labelled sample set.
+ */
+double measureDetection(CascadeClassifier& haar_cascade, const vector<Mat>& grays, const vector< vector<Rect> >& labelledFaces, const FaceRecConfig& config, double& recall)
+{
+  int numLabelled = 0;
+  double numFound = 0.0;
+  int64 startTick = getTickCount();
+  for (int i=0; i<grays.size(); ++i)
+  {
+    vector<Rect> faces;
+    detectFaces(haar_cascade, grays[i], config, faces);
+    numFound += computeDetectionRecall(labelledFaces[i], faces) * labelledFaces[i].size();
+    numLabelled += (int)labelledFaces[i].size();
+  }
+  double milliseconds = elapsedMilliseconds(startTick) / std::max((int)grays.size(), 1);
+  recall = (numLabelled > 0) ? numFound / numLabelled : 1.0;
+  return milliseconds;
+}
+
+
+/**
+ * @param fn_cascade Path to the face cascade.
+ * @param dir_data Path to the face database with the configuration 
+ *        to tune.
+ * @param fn_samples Path to the labelled sample list.
+ * @param tolerance Recall that may be lost against the configured 
+ *        detection parameters.
+ * @return An int indicating the operation state.
+ *
+ * @brief
+ *    Tune the detection parameters on a labelled sample set. The 
+ *    scale factor and the face size bounds are swept, with the 
+ *    bounds derived from the sizes of the labelled faces, and the 
+ *    fastest setting whose recall is within the tolerance of the 
+ *    configured one is suggested for "config.yml".
+ */
+int tuneDetection(const string& fn_cascade, const string& dir_data, const string& fn_samples, double tolerance)
+{
+  FaceRecConfig config;
+  loadFaceRecConfig(dir_data, config);
+
+  // Load the face detecter and the labelled sample set
+  FaceCascade haar_cascade;
+  if (!haar_cascade.load(fn_cascade))
+  {
+    CV_Error(CV_StsBadArg, "Cannot load the cascade " + fn_cascade + ".");
+  }
+  vector<string> imagePaths;
+  vector< vector<Rect> > labelledFaces;
+  if (!loadDetectionSamples(fn_samples, imagePaths, labelledFaces))
+  {
+    CV_Error(CV_StsBadArg, "Cannot read the samples from " + fn_samples + ".");
+  }
+  vector<Mat> grays(imagePaths.size());
+  int smallestFace = INT_MAX;
+  int largestFace = 0;
+  for (int i=0; i<imagePaths.size(); ++i)
+  {
+    Mat original = imread(imagePaths[i]);
+    if (original.empty()) CV_Error(CV_StsBadArg, "Cannot read the sample image " + imagePaths[i] + ".");
+    cvtColor(original, grays[i], CV_BGR2GRAY);
+    for (int j=0; j<labelledFaces[i].size(); ++j)
+    {
+      int size = std::max(labelledFaces[i][j].width, labelledFaces[i][j].height);
+      smallestFace = std::min(smallestFace, size);
+      largestFace = std::max(largestFace, size);
+    }
+  }
+  if (largestFace == 0)
+  {
+    CV_Error(CV_StsBadArg, "No face is labelled in " + fn_samples + ".");
+  }
+  cout << "[INFO] " << imagePaths.size() << " sample images with faces from " 
+       << smallestFace << " to " << largestFace << " pixels." << endl;
+
+  // Measure the configured detection parameters
+  double baseRecall = 0.0;
+  double baseTime = measureDetection(haar_cascade, grays, labelledFaces, config, baseRecall);
+  cout << "[INFO] Configured parameters take " << format("%.3f", baseTime) << " ms per image with recall " 
+       << format("%.3f", baseRecall) << "." << endl;
+
+  // List the settings to sweep
+  const int numScaleFactors = 5;
+  const double scaleFactors[numScaleFactors] = { 1.05, 1.1, 1.15, 1.2, 1.3 };
+  const int numBounds = 3;
+  const int minSizes[numBounds] = { 0, smallestFace / 2, smallestFace * 4 / 5 };
+  const int maxSizes[numBounds] = { 0, largestFace * 2, largestFace * 5 / 4 };
+
+  // Sweep the settings and keep the fastest one within the tolerance
+  FaceRecConfig best = config;
+  double bestTime = baseTime;
+  double bestRecall = baseRecall;
+  cout << setw(14) << "scale_factor" << setw(10) << "min_size" << setw(10) << "max_size" 
+       << setw(12) << "ms/image" << setw(10) << "recall" << endl;
+  for (int f=0; f<numScaleFactors; ++f)
+  {
+    for (int a=0; a<numBounds; ++a)
+    {
+      for (int b=0; b<numBounds; ++b)
+      {
+        FaceRecConfig candidate = config;
+        candidate.detectScaleFactor = scaleFactors[f];
+        candidate.detectMinSize = minSizes[a];
+        candidate.detectMaxSize = maxSizes[b];
+
+        double recall = 0.0;
+        double milliseconds = measureDetection(haar_cascade, grays, labelledFaces, candidate, recall);
+        cout << setw(14) << scaleFactors[f] << setw(10) << minSizes[a] << setw(10) << maxSizes[b] 
+             << setw(12) << format("%.3f", milliseconds) << setw(10) << format("%.3f", recall) << endl;
+
+        if (recall >= baseRecall - tolerance && milliseconds < bestTime)
+        {
+          best = candidate;
+          bestTime = milliseconds;
+          bestRecall = recall;
+        }
+      }
+    }
+  }
+
+  // Suggest the best setting
+  cout << "[INFO] Fastest setting within recall tolerance " << tolerance << ": " 
+       << format("%.3f", bestTime) << " ms per image with recall " << format("%.3f", bestRecall) << "." << endl;
+  cout << "[INFO] Add the following entries to \"" << dir_data << "/config.yml\":" << endl;
+  cout << "detect_scale_factor: " << best.detectScaleFactor << endl;
+  cout << "detect_min_size: " << best.detectMinSize << endl;
+  cout << "detect_max_size: " << best.detectMaxSize << endl;
+
+  return 0;
+}
+
+
+/**
+ * @param argv0 Name of the program.
+ *
+ * @brief
+ *    Print the usage of the application.
+ */
+void printUsage(const char* argv0)
+{
+  cout << "usage: " << argv0 << " <command> [<args>]" << endl;
+  cout << "\t enroll <data_path> [<captures>]" << endl;
+  cout << "\t\t -- Cost per captured face of enrolling new faces into the face database." << endl;
+  cout << "\t stages <cascade> <data_path> <image> [<runs>] [<out_json>]" << endl;
+  cout << "\t\t -- Mean, p50, p99 and throughput of each stage of the face recognition." << endl;
+  cout << "\t predict-batch <data_path> [<runs>]" << endl;
+  cout << "\t\t -- Batch prediction through the face gallery with each of the SIMD kernels against one face at a time, and whether the labels are identical." << endl;
+  cout << "\t predict-index <data_path> [<lists>] [<queries>]" << endl;
+  cout << "\t\t -- Search of the face gallery through an inverted file index against the exact scan, with Recall@1 for each number of lists probed." << endl;
+  cout << "\t predict-index-synthetic [<vectors>] [<dimensions>] [<lists>] [<queries>]" << endl;
+  cout << "\t\t -- The same on a synthetic face gallery of <vectors> faces." << endl;
+  cout << "\t predict-quantized [<vectors>] [<dimensions>] [<queries>]" << endl;
+  cout << "\t\t -- Half precision and 8-bit storages of a synthetic face gallery against single precision, with and without reranking." << endl;
+  cout << "\t recognizers <data_path> [<held_out>]" << endl;
+  cout << "\t\t -- Train time, predict time, model size and leave-one-out accuracy of each face recognizer backend." << endl;
+  cout << "\t detect-scale <cascade> <image> [<runs>]" << endl;
+  cout << "\t\t -- Detection speed against recall for the detection resolution policies." << endl;
+  cout << "\t detect-threads <cascade> <image> [<max_threads>] [<runs>]" << endl;
+  cout << "\t\t -- Speedup of the parallel pyramid detection from 1 to <max_threads> threads." << endl;
+  cout << "\t compiled <cascade> <image> [<runs>]" << endl;
+  cout << "\t\t -- Compiled cascade with each of the SIMD kernels against the generic face detecter, and whether the faces are identical." << endl;
+  cout << "\t track <cascade> <image> [<frames>] [<interval>]" << endl;
+  cout << "\t\t -- Detection cost per frame of the face tracking against full-frame detection." << endl;
+  cout << "\t motion <cascade> <image> [<frames>] [<threshold>]" << endl;
+  cout << "\t\t -- Detection cost per frame of the motion gating against full-frame detection." << endl;
+  cout << "\t backends <cascade> <image> [<runs>]" << endl;
+  cout << "\t\t -- Haar against LBP detection backend, with the agreement of the faces detected." << endl;
+  cout << "\t tune-detect <cascade> <data_path> <samples> [<tolerance>]" << endl;
+  cout << "\t\t -- Fastest detection parameters within a recall tolerance on labelled samples." << endl;
+}
+
+
+/**
+ * @brief
+ *    Program entry of the application.
+ */
+int main(int argc, const char *argv[])
+{
+  // Check for valid command line arguments
+  if (argc < 2)
+  {
+    printUsage(argv[0]);
+    exit(1);
+  }
+  string command = string(argv[1]);
+
+  try
+  {
+    // Benchmark the enrollment of captured faces
+    if (command == "enroll" && argc >= 3)
+    {
+      string dir_data = string(argv[2]);
+      int numCaptures = (argc > 3) ? atoi(argv[3]) : 100;
+      FaceRecConfig config;
+      loadFaceRecConfig(dir_data, config);
+      return benchmarkEnrollment(dir_data, numCaptures, config);
+    }
+
+    // Benchmark each stage of the face recognition
+    if (command == "stages" && argc >= 5)
+    {
+      string dir_data = string(argv[3]);
+      int numRuns = (argc > 5) ? atoi(argv[5]) : 20;
+      string fn_json = (argc > 6) ? string(argv[6]) : string("");
+      return benchmarkStages(string(argv[2]), dir_data, string(argv[4]), numRuns, fn_json);
+    }
+
+    // Benchmark the batch prediction
+    if (command == "predict-batch" && argc >= 3)
+    {
+      int numRuns = (argc > 3) ? atoi(argv[3]) : 20;
+      return benchmarkBatchPrediction(string(argv[2]), numRuns);
+    }
+
+    // Benchmark the gallery index
+    if (command == "predict-index" && argc >= 3)
+    {
+      int lists = (argc > 3) ? atoi(argv[3]) : 0;
+      int numQueries = (argc > 4) ? atoi(argv[4]) : 1000;
+      return benchmarkGalleryIndex(string(argv[2]), lists, numQueries);
+    }
+
+    // Benchmark the gallery index on a synthetic gallery
+    if (command == "predict-index-synthetic")
+    {
+      int numVectors = (argc > 2) ? atoi(argv[2]) : 100000;
+      int dimensions = (argc > 3) ? atoi(argv[3]) : 64;
+      int lists = (argc > 4) ? atoi(argv[4]) : 0;
+      int numQueries = (argc > 5) ? atoi(argv[5]) : 200;
+      return benchmarkSyntheticGalleryIndex(numVectors, dimensions, lists, numQueries);
+    }
+
+    // Benchmark the quantized gallery storages
+    if (command == "predict-quantized")
+    {
+      int numVectors = (argc > 2) ? atoi(argv[2]) : 1000000;
+      int dimensions = (argc > 3) ? atoi(argv[3]) : 64;
+      int numQueries = (argc > 4) ? atoi(argv[4]) : 200;
+      return benchmarkQuantizedGallery(numVectors, dimensions, numQueries);
+    }
+
+    // Benchmark the face recognizer backends
+    if (command == "recognizers" && argc >= 3)
+    {
+      int numHeldOut = (argc > 3) ? atoi(argv[3]) : 100;
+      return benchmarkRecognizerBackends(string(argv[2]), numHeldOut);
+    }
+
+    // Benchmark the detection resolution policies
+    if (command == "detect-scale" && argc >= 4)
+    {
+      int numRuns = (argc > 4) ? atoi(argv[4]) : 10;
+      return benchmarkDetectionScale(string(argv[2]), string(argv[3]), numRuns);
+    }
+
+    // Benchmark the parallel pyramid detection
+    if (command == "detect-threads" && argc >= 4)
+    {
+      int maxThreads = (argc > 4) ? atoi(argv[4]) : getNumberOfCPUs();
+      int numRuns = (argc > 5) ? atoi(argv[5]) : 10;
+      return benchmarkDetectionThreads(string(argv[2]), string(argv[3]), maxThreads, numRuns);
+    }
+
+    // Benchmark the compiled cascade
+    if (command == "compiled" && argc >= 4)
+    {
+      int numRuns = (argc > 4) ? atoi(argv[4]) : 10;
+      return benchmarkCompiledCascade(string(argv[2]), string(argv[3]), numRuns);
+    }
+
+    // Benchmark the face tracking
+    if (command == "track" && argc >= 4)
+    {
+      int numFrames = (argc > 4) ? atoi(argv[4]) : 300;
+      int scanInterval = (argc > 5) ? atoi(argv[5]) : 30;
+      return benchmarkTracking(string(argv[2]), string(argv[3]), numFrames, scanInterval);
+    }
+
+    // Benchmark the motion gating
+    if (command == "motion" && argc >= 4)
+    {
+      int numFrames = (argc > 4) ? atoi(argv[4]) : 300;
+      int threshold = (argc > 5) ? atoi(argv[5]) : 15;
+      return benchmarkMotionGate(string(argv[2]), string(argv[3]), numFrames, threshold);
+    }
+
+    // Benchmark the detection backends
+    if (command == "backends" && argc >= 4)
+    {
+      int numRuns = (argc > 4) ? atoi(argv[4]) : 10;
+      return benchmarkDetectionBackends(string(argv[2]), string(argv[3]), numRuns);
+    }
+
+    // Tune the detection parameters
+    if (command == "tune-detect" && argc >= 5)
+    {
+      double tolerance = (argc > 5) ? atof(argv[5]) : 0.02;
+      return tuneDetection(string(argv[2]), string(argv[3]), string(argv[4]), tolerance);
+    }
+  }
+  catch (cv::Exception& e)
+  {
+    cerr << "[ERROR] Benchmark failed. Reason: " << e.msg << endl;
+    exit(1);
+  }
+
+  printUsage(argv[0]);
+  return 1;
+}
@@ -18,6 +18,10 @@
 #include "opencv2/imgproc/imgproc.hpp"
 #include "opencv2/objdetect/objdetect.hpp"
 
+#include "FaceDatabase.hpp"
+#include "FaceRecConfig.hpp"
+#include "FaceRecEngine.hpp"
+
 #include <iostream>
 #include <fstream>
 #include <sstream>
@@ -27,166 +31,946 @@
 #include <sys/stat.h>
 #include <unistd.h>
 #include <cstdio>
+#include <cstring>
+#include <cerrno>
+#include <csignal>
+#include <climits>
+#include <algorithm>
+#include <iterator>
+#include <pthread.h>
+#include <sys/socket.h>
+#include <sys/time.h>
+#include <sys/un.h>
 using namespace cv;
 using namespace std;
 
 
 const int STD_PROTRAIT_SIZE       = 256;
-const int STD_FACE_REC_SIZE       = 64;
 const int STD_DETECT_FRAME_WIDTH  = 320;
 const int STD_DETECT_FRAME_HEIGHT = 240;
+const size_t MAX_REQUEST_IMAGE_SIZE = 1 << 30;
+const int SERVER_IO_TIMEOUT_SECONDS = 30;
+
+
+/**
+ * @param original Input image to process, in BGR color, or in 
+ *        grayscale if the faces are not tagged. The faces are tagged 
+ *        on it if required.
+ * @param engine Face recognition engine.
+ * @param annotate Whether to tag the faces on the input image.
+ * @param verbose Whether to inform each face recognized.
+ * @return The face recognition result in JSON format.
+ *
+ * @brief
+ *    Detect and recognize all the faces in an image.
+ */
+string recognizeImage(Mat& original, FaceRecEngine& engine, bool annotate, bool verbose)
+{
+  // Detect and recognize the faces in the original image
+  vector<FaceResult> faces;
+  engine.recognize(original, faces);
+  if (verbose) cout << "[INFO] " << faces.size() << " faces detected. Faces are:" << ((faces.size())?(""):(" (NO DATA).")) << endl;
+
+  // Output all the faces recognized
+  stringstream ssInfo;
+  for(int i = 0; i < faces.size(); i++)
+  {
+    // Obtain the current face to process
+    Rect face_i = faces[i].position;
+    const string& strName = faces[i].name;
+    double confidence = faces[i].confidence;
+     
+    // Check if has output image
+    if (annotate)
+    {
+      // Tag the face with a rectangle
+      rectangle(original, face_i, CV_RGB(0, 255,0), 1);
+      
+      // Put the prediction information above the rectangle
+      int pos_x = std::max(face_i.tl().x - 10, 0);
+      int pos_y = std::max(face_i.tl().y - 10, 0);
+      string box_text = format("%s [%.2lf]", strName.c_str(), confidence);
+      putText(original, box_text, Point(pos_x, pos_y), FONT_HERSHEY_PLAIN, 1.0, CV_RGB(0,255,0), 2.0);
+    }
+
+    // Output the recognition information
+    if (i>0) ssInfo << ",";
+    ssInfo << "{"
+           << "\"prediction\":\"" << strName << "\","
+           << "\"confidence\":" << confidence << ","
+           << "\"position\":" << "{"
+                              << "\"x\":" << face_i.tl().x << ","
+                              << "\"y\":" << face_i.tl().y
+                              << "},"
+           << "\"size\":" << "{"
+                          << "\"width\":" << face_i.size().width << ","
+                          << "\"height\":" << face_i.size().height
+                          << "}"
+           << "}";
+
+    // Inform the face recognition result
+    if (verbose) cout << "\t- " << strName << " [" << confidence << "]" << endl;
+  }
+
+  // Wrap the recognition information as a JSON array
+  string strInfo;
+  ssInfo >> strInfo;
+  return "[" + strInfo + "]";
+}
+
+
+/**
+ * @param config Deployment configuration.
+ * @param annotate Whether to tag the faces on the input image.
+ * @return Flags to read the input image with.
+ *
+ * @brief
+ *    Obtain the flags to read the input image. With the tiled 
+ *    detection, an input image not to be tagged is read in 
+ *    grayscale, which takes a third of the memory of the color 
+ *    image and saves the conversion.
+ */
+int obtainImageReadFlags(const FaceRecConfig& config, bool annotate)
+{
+  bool tiled = (config.detectTileSize > 0 || config.detectMemoryMB > 0);
+  return (tiled && !annotate) ? 0 : 1;
+}
+
+
+/**
+ * @param fd File descriptor to write to.
+ * @param data Data to write.
+ * @param size Size of the data in bytes.
+ * @return True if all the data is written, and false otherwise.
+ *
+ * @brief
+ *    Write all the data to a socket.
+ */
+bool writeAll(int fd, const void* data, size_t size)
+{
+  const char* ptr = (const char*)data;
+  while (size > 0)
+  {
+    ssize_t n = write(fd, ptr, size);
+    if (n < 0 && errno == EINTR) continue;
+    if (n <= 0) return false;
+    ptr += n;
+    size -= n;
+  }
+  return true;
+}
+
+
+/**
+ * @param fd File descriptor to read from.
+ * @param data Buffer to store the data.
+ * @param size Size of the data in bytes.
+ * @return True if all the data is read, and false otherwise.
+ *
+ * @brief
+ *    Read exactly the given size of data from a socket.
+ */
+bool readAll(int fd, void* data, size_t size)
+{
+  char* ptr = (char*)data;
+  while (size > 0)
+  {
+    ssize_t n = read(fd, ptr, size);
+    if (n < 0 && errno == EINTR) continue;
+    if (n <= 0) return false;
+    ptr += n;
+    size -= n;
+  }
+  return true;
+}
+
+
+/**
+ * @param fd File descriptor to read from.
+ * @param line String to store the line, without the line break.
+ * @return True if a line is read, and false otherwise.
+ *
+ * @brief
+ *    Read a line from a socket. Lines longer than 64KB are 
+ *    rejected.
+ */
+bool readLine(int fd, string& line)
+{
+  line.clear();
+  char c;
+  while (readAll(fd, &c, 1))
+  {
+    if (c == '\n') return true;
+    line.push_back(c);
+    if (line.size() > 65536) return false;
+  }
+  return false;
+}
+
+
+/**
+ * @param path A path to a file, which may not exist yet.
+ * @return The absolute path.
+ *
+ * @brief
+ *    Obtain the absolute path of a file relative to the current 
+ *    working directory, so that it can be passed to the server.
+ */
+string obtainAbsolutePath(const string& path)
+{
+  if (!path.empty() && path[0] == '/') return path;
+  char cwd[PATH_MAX];
+  if (getcwd(cwd, sizeof(cwd)) == NULL) return path;
+  return string(cwd) + "/" + path;
+}
 
 
 /**
+ * @param dir_data Path to the face database.
+ * @param config Deployment configuration.
+ * @return Path to the Unix domain socket of the server.
+ *
  * @brief
- *   Type of directory item.
- */ 
-enum DirectoryItemType
+ *    Obtain the path to the socket of the recognition server.
+ */
+string obtainServerSocketPath(const string& dir_data, const FaceRecConfig& config)
 {
-  DIRITEM_OTHER = 0,  // Other directory item type
-  DIRITEM_FILE = 1,   // Normal file
-  DIRITEM_DIR = 2     // Directory item
+  if (!config.serverSocket.empty()) return config.serverSocket;
+  return dir_data + "/server.sock";
+}
+
+
+/**
+ * @param dir_data Path to the face database.
+ * @return A hexadecimal string identifying the content of the 
+ *         configuration file, or "none" if there is no such file.
+ *
+ * @brief
+ *    Compute the fingerprint of "<dir_data>/config.yml", so that the 
+ *    server notices the changes of the configuration.
+ */
+string computeConfigFingerprint(const string& dir_data)
+{
+  ifstream ifsConfig((dir_data + "/config.yml").c_str(), ios::binary);
+  if (!ifsConfig.is_open()) return "none";
+  string content((istreambuf_iterator<char>(ifsConfig)), istreambuf_iterator<char>());
+  return format("%016llx", (unsigned long long)hashFNV1a(content.data(), content.size()));
+}
+
+
+/**
+ * @brief
+ *   Shared state of the worker threads of the recognition server.
+ */
+struct RecognitionServer
+{
+  int listenFd;                   // Listening socket
+  string fn_cascade;              // Path to the face cascade, as given to the server
+  string cascadePath;             // Absolute path to the face cascade
+  string dataPath;                // Path to the face database
+  Ptr<FaceRecEngine> engine;      // Face recognition engine, shared by the workers
+  pthread_mutex_t mutex;          // Mutex guarding the engine
+  double checkSeconds;            // Interval between the checks for changes
+  string dataFingerprint;         // Fingerprint of the face database last checked
+  string configFingerprint;       // Fingerprint of the configuration last checked
+  pthread_t watcher;              // Thread checking for changes
 };
 
 
 /**
- * @param dirpath Path to the directory.
- * @param items Item names from the directory
- * @param types Directory types of corresponding items.
- * @return An int indicating the operation state. "0" indicates 
- *         success and negative numbers indicate failure.
+ * @brief
+ *   State of a worker thread of the recognition server.
+ */
+struct RecognitionServerWorker
+{
+  RecognitionServer* server;      // Shared state of the server
+  pthread_t thread;               // Thread of the worker
+};
+
+
+/**
+ * @param arg Pointer to the RecognitionServer.
+ * @return NULL.
  *
  * @brief
- *    Traverse a directory and obtain all the items. Hidden files 
- *    will be ignored.
+ *    Check the face database and the configuration for changes at 
+ *    the interval of the server, and reload the face recognition 
+ *    engine when they changed. The requests are served by the 
+ *    previous engine until the new one is loaded, and the requests 
+ *    in progress keep the engine they took.
  */
-int traverseDirectory(string dirpath, vector<string>& items, vector<DirectoryItemType>& types)
+void* runRecognitionServerWatcher(void* arg)
 {
-  DIR* dp;
-  struct dirent* dirp;
-  struct stat st;
+  RecognitionServer* server = (RecognitionServer*)arg;
+  struct timespec interval;
+  interval.tv_sec = (time_t)server->checkSeconds;
+  interval.tv_nsec = (long)((server->checkSeconds - interval.tv_sec) * 1e9);
+
+  for (;;)
+  {
+    nanosleep(&interval, NULL);
+
+    // Check the face database and the configuration
+    string dataFingerprint = computeFaceDataFingerprint(server->dataPath);
+    string configFingerprint = computeConfigFingerprint(server->dataPath);
+    if (dataFingerprint == server->dataFingerprint && configFingerprint == server->configFingerprint) continue;
+    server->dataFingerprint = dataFingerprint;
+    server->configFingerprint = configFingerprint;
+
+    // Reload the engine, keeping the previous one if it fails until 
+    // the next change
+    try
+    {
+      FaceRecConfig config;
+      loadFaceRecConfig(server->dataPath, config);
+      Ptr<FaceRecEngine> engine = new FaceRecEngine(server->fn_cascade, server->dataPath, config);
+      pthread_mutex_lock(&server->mutex);
+      server->engine = engine;
+      pthread_mutex_unlock(&server->mutex);
+      cout << "[INFO] Face recognizer reloaded for the changes of the face database." << endl;
+    }
+    catch (cv::Exception& e)
+    {
+      cerr << "[ERROR] Cannot reload the face recognizer, the previous one is kept. Reason: " << e.msg << endl;
+    }
+  }
+
+  return NULL;
+}
 
-  // Clear the vectors
-  items.clear();
-  types.clear();
 
-  // Open dirent directory
-  if ((dp = opendir(dirpath.c_str())) == NULL)
+/**
+ * @param server Shared state of the server.
+ * @param fd Socket connected to the client.
+ *
+ * @brief
+ *    Serve a request of a client. The request is a header of 
+ *    "<key>: <value>" lines ended by an empty line, with the keys 
+ *    "cascade", "length" and "annotate", 
+ *    followed by "length" bytes of encoded image. The response is 
+ *    "OK <length>" and the JSON face recognition result of that 
+ *    length, or "ERROR <message>", in one line. With "annotate", the 
+ *    extension of the image format to tag the faces on, the response 
+ *    is "OK <length> <image_length>" and the result is followed by 
+ *    the tagged image encoded in that format.
+ */
+void serveRecognitionRequest(RecognitionServer* server, int fd)
+{
+  // Read the request header
+  map<string, string> header;
+  string line;
+  while (readLine(fd, line) && !line.empty())
   {
-    cerr << "[ERROR] traverseDirectory(string, vector<string>&, vector<DirectoryItemType>&): " 
-         << "Cannot open the directory " << dirpath << "." << endl;
-    return -1;
+    size_t pos = line.find(": ");
+    if (pos != string::npos) header[line.substr(0, pos)] = line.substr(pos + 2);
   }
 
-  // Read all files in this dir
-  while ((dirp = readdir(dp)) != NULL)
+  // Check the face cascade requested
+  string response;
+  if (header.count("cascade") && header["cascade"] != server->cascadePath)
   {
-    // Ignore hidden files
-    if (dirp->d_name[0] == '.') continue;
+    response = "ERROR The server uses the cascade " + server->cascadePath + ".\n";
+    writeAll(fd, response.c_str(), response.size());
+    return;
+  }
+
+  // Take the current face recognizer
+  pthread_mutex_lock(&server->mutex);
+  Ptr<FaceRecEngine> engine = server->engine;
+  pthread_mutex_unlock(&server->mutex);
 
-    // Obtain the full name of the item
-    string fullname = dirpath + string("/") + string(dirp->d_name);
+  // Load the input image from the request, never from a path, so 
+  // that a client only reads the files it can read itself
+  Mat original;
+  string annotateExt = header.count("annotate") ? header["annotate"] : string("");
+  bool annotate = !annotateExt.empty();
+  int flags = obtainImageReadFlags(engine->getConfig(), annotate);
+  if (header.count("length"))
+  {
+    size_t length = (size_t)atol(header["length"].c_str());
+    if (length == 0 || length > MAX_REQUEST_IMAGE_SIZE) return;
+    vector<uchar> content(length);
+    if (!readAll(fd, &content[0], length)) return;
+    original = imdecode(Mat(content), flags);
+  }
+  if (original.empty())
+  {
+    response = "ERROR Cannot read the input image.\n";
+    writeAll(fd, response.c_str(), response.size());
+    return;
+  }
 
-    // Obtain the item status
-    if (stat(fullname.c_str(), &st) == -1)
+  // Recognize the faces and encode the tagged image if required, 
+  // for the client to write it itself
+  string strInfo;
+  vector<uchar> outImage;
+  try
+  {
+    strInfo = recognizeImage(original, *engine, annotate, false);
+    if (annotate && !imencode(annotateExt, original, outImage))
     {
-      cerr << "[ERROR] traverseDirectory(string, vector<string>&, vector<DirectoryItemType>&): " 
-           << "Cannot obtain the status of the item " << fullname << "." << endl;
-      return -1;
+      CV_Error(CV_StsBadArg, "Cannot encode the output image as " + annotateExt + ".");
     }
+  }
+  catch (cv::Exception& e)
+  {
+    response = "ERROR " + e.msg + "\n";
+    writeAll(fd, response.c_str(), response.size());
+    return;
+  }
 
-    // Obtain the item type
-    DirectoryItemType itemType = DIRITEM_OTHER;
-    if (S_ISREG(st.st_mode)) itemType = DIRITEM_FILE;
-    if (S_ISDIR(st.st_mode)) itemType = DIRITEM_DIR;
-    
-    // Push to the vectors
-    items.push_back(dirp->d_name);
-    types.push_back(itemType);
+  // Send the response
+  if (annotate) response = format("OK %d %d\n", (int)strInfo.size(), (int)outImage.size()) + strInfo;
+  else response = format("OK %d\n", (int)strInfo.size()) + strInfo;
+  if (writeAll(fd, response.c_str(), response.size()) && !outImage.empty())
+  {
+    writeAll(fd, &outImage[0], outImage.size());
   }
+}
 
-  return 0;
+
+/**
+ * @param arg Pointer to the RecognitionServerWorker.
+ * @return NULL.
+ *
+ * @brief
+ *    Accept and serve the clients one after another.
+ */
+void* runRecognitionServerWorker(void* arg)
+{
+  RecognitionServerWorker* worker = (RecognitionServerWorker*)arg;
+  for (;;)
+  {
+    int fd = accept(worker->server->listenFd, NULL, NULL);
+    if (fd < 0)
+    {
+      if (errno == EINTR || errno == ECONNABORTED) continue;
+      cerr << "[ERROR] Cannot accept the client. Reason: " << strerror(errno) << endl;
+      break;
+    }
+
+    // Bound the time a client may hold the worker without sending 
+    // or receiving
+    struct timeval timeout;
+    timeout.tv_sec = SERVER_IO_TIMEOUT_SECONDS;
+    timeout.tv_usec = 0;
+    setsockopt(fd, SOL_SOCKET, SO_RCVTIMEO, &timeout, sizeof(timeout));
+    setsockopt(fd, SOL_SOCKET, SO_SNDTIMEO, &timeout, sizeof(timeout));
+
+    serveRecognitionRequest(worker->server, fd);
+    close(fd);
+  }
+  return NULL;
 }
 
 
 /**
- * @param datapath Path to face database directory.
- * @param images Array to store face image data.
- * @param labels Array to store corresponding labels for face images.
- * @param names Mapping from label to name of the face.
+ * @brief
+ *   Path to the socket of the running server, to be removed when 
+ *   the server is terminated.
+ */
+static char g_serverSocketPath[sizeof(((struct sockaddr_un*)0)->sun_path)] = "";
+
+
+/**
+ * @param signum Signal number.
  *
  * @brief
- *    Load face data from face database directory.
+ *    Remove the server socket and terminate the server.
  */
-void loadFaceData(const string& datapath, vector<Mat>& images, vector<int>& labels, map<int, string>& names)
+void terminateRecognitionServer(int signum)
 {
-  vector<string> items_data;
-  vector<DirectoryItemType> types_data;
-  vector<string> items_face;
-  vector<DirectoryItemType> types_face;
-  
-  // Clear the result containers
-  images.clear();
-  labels.clear();
-  names.clear();
+  unlink(g_serverSocketPath);
+  _exit(0);
+}
 
-  // Obtain the face data path
-  string faceDataPath = datapath + "/faces";
 
-  // Traverse the data directory
-  if (traverseDirectory(faceDataPath, items_data, types_data) < 0)
+/**
+ * @param fn_cascade Path to the face cascade.
+ * @param dir_data Path to the face database.
+ * @param config Deployment configuration.
+ * @return An int indicating the operation state.
+ *
+ * @brief
+ *    Run the recognition server. The face recognizer and the face 
+ *    cascade are loaded once, and the requests are served by a 
+ *    pool of worker threads on a Unix domain socket.
+ */
+int runRecognitionServer(const string& fn_cascade, const string& dir_data, const FaceRecConfig& config)
+{
+  RecognitionServer server;
+  server.fn_cascade = fn_cascade;
+  server.cascadePath = obtainAbsolutePath(fn_cascade);
+  server.dataPath = dir_data;
+
+  // Load the face recognizer and the face detecter, taking the 
+  // fingerprints first so that a change during the load is reloaded
+  server.checkSeconds = config.serverCheckSeconds;
+  server.dataFingerprint = computeFaceDataFingerprint(dir_data);
+  server.configFingerprint = computeConfigFingerprint(dir_data);
+  try
+  {
+    server.engine = new FaceRecEngine(fn_cascade, dir_data, config);
+  }
+  catch (cv::Exception& e)
   {
-    string error_message = "Cannot read the face database directory " + faceDataPath + ".";
-    cerr << "[ERROR] loadFaceData(const string&, vector<Mat>&, vector<int>&, map<int, string>&): "
-         << error_message << endl;
-    CV_Error(CV_StsBadArg, error_message);
+    cerr << "[Error] Failed to load the face data. Reason: " << e.msg << endl;
+    return 1;
   }
+  pthread_mutex_init(&server.mutex, NULL);
+  cout << "[INFO] Face Haar-Like cascade trained." << endl;
 
-  // Inform the loading state
-  cout << "[INFO] Open face data directory \"" << faceDataPath << "\". Now loading: " << endl;
-  
-  // Traverse each face directory
-  for (int i=0; i<items_data.size(); ++i)
+  // Prepare the workers
+  int numThreads = (config.serverThreads > 0) ? config.serverThreads : getNumberOfCPUs();
+  vector<RecognitionServerWorker> workers(numThreads);
+  for (int i=0; i<numThreads; ++i) workers[i].server = &server;
+
+  // Bind the server socket
+  string socketPath = obtainServerSocketPath(dir_data, config);
+  struct sockaddr_un addr;
+  memset(&addr, 0, sizeof(addr));
+  addr.sun_family = AF_UNIX;
+  if (socketPath.size() >= sizeof(addr.sun_path))
+  {
+    cerr << "[ERROR] The socket path \"" << socketPath << "\" is too long." << endl;
+    return 1;
+  }
+  strncpy(addr.sun_path, socketPath.c_str(), sizeof(addr.sun_path) - 1);
+
+  // Refuse to replace the socket of a server still answering, and 
+  // remove the socket left by a server no longer running
+  int probeFd = socket(AF_UNIX, SOCK_STREAM, 0);
+  bool running = probeFd >= 0 && 
+                 connect(probeFd, (struct sockaddr*)&addr, sizeof(addr)) == 0;
+  if (probeFd >= 0) close(probeFd);
+  if (running)
+  {
+    cerr << "[ERROR] A recognition server is already running on \"" << socketPath << "\"." << endl;
+    return 1;
+  }
+  server.listenFd = socket(AF_UNIX, SOCK_STREAM, 0);
+  unlink(socketPath.c_str());
+
+  // Create the socket accessible to its owner only, since a client 
+  // is served with the faces of the database
+  mode_t mask = umask(0177);
+  bool bound = server.listenFd >= 0 && 
+               bind(server.listenFd, (struct sockaddr*)&addr, sizeof(addr)) == 0;
+  umask(mask);
+  if (!bound || chmod(socketPath.c_str(), 0600) != 0 || 
+      listen(server.listenFd, SOMAXCONN) != 0)
+  {
+    cerr << "[ERROR] Cannot listen on the socket \"" << socketPath << "\". Reason: " << strerror(errno) << endl;
+    return 1;
+  }
+
+  // Remove the socket when the server is terminated
+  strncpy(g_serverSocketPath, socketPath.c_str(), sizeof(g_serverSocketPath) - 1);
+  signal(SIGINT, terminateRecognitionServer);
+  signal(SIGTERM, terminateRecognitionServer);
+  signal(SIGPIPE, SIG_IGN);
+
+  // Check for changes of the face database in the background
+  if (server.checkSeconds > 0 && 
+      pthread_create(&server.watcher, NULL, runRecognitionServerWatcher, &server) != 0)
+  {
+    cerr << "[WARNING] Cannot start the thread checking the face database for changes." << endl;
+  }
+
+  // Serve the requests by the worker threads
+  cout << "[INFO] Serving on \"" << socketPath << "\" with " << numThreads << " threads." << endl;
+  for (int i=0; i<numThreads; ++i)
+  {
+    if (pthread_create(&workers[i].thread, NULL, runRecognitionServerWorker, &workers[i]) != 0)
+    {
+      cerr << "[ERROR] Cannot start the server threads." << endl;
+      return 1;
+    }
+  }
+  for (int i=0; i<numThreads; ++i) pthread_join(workers[i].thread, NULL);
+
+  unlink(socketPath.c_str());
+  return 1;
+}
+
+
+/**
+ * @param socketPath Path to the socket of the recognition server.
+ * @param fn_cascade Path to the face cascade.
+ * @param fn_inimage Path to the input image.
+ * @param fn_outimage Path to the output image, or empty if no 
+ *        output image is required.
+ * @param strInfo String to store the face recognition result.
+ * @return True if the request is served, and false if no server is 
+ *         running or the server cannot serve it.
+ *
+ * @brief
+ *    Request the recognition server to recognize an image file.
+ */
+bool requestRecognitionServer(const string& socketPath, const string& fn_cascade, const string& fn_inimage, const string& fn_outimage, string& strInfo)
+{
+  // Connect to the server
+  struct sockaddr_un addr;
+  memset(&addr, 0, sizeof(addr));
+  addr.sun_family = AF_UNIX;
+  if (socketPath.size() >= sizeof(addr.sun_path)) return false;
+  if ( !(access(socketPath.c_str(), 0)==0) ) return false;
+  strncpy(addr.sun_path, socketPath.c_str(), sizeof(addr.sun_path) - 1);
+  int fd = socket(AF_UNIX, SOCK_STREAM, 0);
+  if (fd < 0) return false;
+  if (connect(fd, (struct sockaddr*)&addr, sizeof(addr)) != 0)
+  {
+    close(fd);
+    return false;
+  }
+  signal(SIGPIPE, SIG_IGN);
+
+  // Read the input image, which the server is sent rather than opens
+  ifstream ifsImage(fn_inimage.c_str(), ios::binary);
+  string content((istreambuf_iterator<char>(ifsImage)), istreambuf_iterator<char>());
+  if (content.empty())
   {
-    // Check if the current item is a directory
-    if ( !(types_data[i]==DIRITEM_DIR) ) continue;
+    close(fd);
+    return false;
+  }
 
-    // Obtain the face image directory path
-    string faceImagePath = faceDataPath + "/" + items_data[i];
+  // Send the request, asking for the tagged image in the format of 
+  // the output image
+  string request = "cascade: " + obtainAbsolutePath(fn_cascade) + "\n"
+                 + format("length: %d\n", (int)content.size());
+  if (!fn_outimage.empty())
+  {
+    size_t pos = fn_outimage.find_last_of("./");
+    bool hasExt = (pos != string::npos && fn_outimage[pos] == '.');
+    request += "annotate: " + (hasExt ? fn_outimage.substr(pos) : string(".jpg")) + "\n";
+  }
+  request += "\n";
 
-    // Traverse the face image directory
-    if (traverseDirectory(faceImagePath, items_face, types_face) < 0)
+  // Receive the response, and write the tagged image
+  string status;
+  bool success = writeAll(fd, request.c_str(), request.size()) && 
+                 writeAll(fd, content.data(), content.size()) && readLine(fd, status);
+  if (success && status.compare(0, 3, "OK ") == 0)
+  {
+    int length = 0;
+    int imageLength = 0;
+    int fields = sscanf(status.c_str() + 3, "%d %d", &length, &imageLength);
+    strInfo.assign(std::max(length, 0), ' ');
+    success = (length <= 0) || readAll(fd, &strInfo[0], length);
+    if (success && !fn_outimage.empty())
     {
-      string error_message = "Cannot read the face image directory " + faceImagePath + ".";
-      cerr << "[ERROR] loadFaceData(const string&, vector<Mat>&, map<int, string>&): "
-           << error_message << endl;
-      CV_Error(CV_StsBadArg, error_message);
+      vector<char> outImage(std::max(imageLength, 0));
+      success = (fields == 2) && imageLength > 0 && readAll(fd, &outImage[0], imageLength);
+      if (success)
+      {
+        ofstream ofsImage(fn_outimage.c_str(), ios::binary);
+        success = ofsImage.write(&outImage[0], imageLength).good();
+      }
+      if (success) cout << "[INFO] Output the processed image as \"" << fn_outimage << "\"" << endl;
     }
+  }
+  else
+  {
+    if (success) cerr << "[WARNING] The server cannot serve the request. Reason: " << status << endl;
+    success = false;
+  }
+  close(fd);
+
+  return success;
+}
+
+
+/**
+ * @param str A string.
+ * @return The string quoted and escaped as a JSON string.
+ *
+ * @brief
+ *    Quote a string for the JSON output.
+ */
+string quoteJSON(const string& str)
+{
+  string quoted = "\"";
+  for (size_t i=0; i<str.size(); ++i)
+  {
+    char c = str[i];
+    if (c == '"' || c == '\\') quoted += string("\\") + c;
+    else if ((unsigned char)c < 0x20) quoted += format("\\u%04x", (int)(unsigned char)c);
+    else quoted += c;
+  }
+  return quoted + "\"";
+}
+
 
-    // Inform the loading state
-    cout << "\t- " << items_data[i] << " [" << i + 1 << "/" << items_data.size() << "]" << endl;
+/**
+ * @param in_images Directory of the input images, or a file listing 
+ *        the paths to the input images line by line.
+ * @param imagePaths Array to store the paths to the input images.
+ * @return True if the input images are listed, and false otherwise.
+ *
+ * @brief
+ *    List the input images of a batch. The files of a directory are 
+ *    listed in the order of their names.
+ */
+bool listBatchImages(const string& in_images, vector<string>& imagePaths)
+{
+  struct stat st;
+  imagePaths.clear();
+  if (stat(in_images.c_str(), &st) == -1) return false;
 
-    // Push data to result containers
-    for (int j=0; j<items_face.size(); ++j)
+  // List the files of the directory
+  if (S_ISDIR(st.st_mode))
+  {
+    vector<string> items;
+    vector<DirectoryItemType> types;
+    if (traverseDirectory(in_images, items, types) < 0) return false;
+    for (int i=0; i<items.size(); ++i)
     {
-      // Check if the current item is a normal file
-      if ( !(types_face[j]==DIRITEM_FILE) ) continue;
+      if (types[i] == DIRITEM_FILE) imagePaths.push_back(in_images + "/" + items[i]);
+    }
+    std::sort(imagePaths.begin(), imagePaths.end());
+    return true;
+  }
 
-      // Obtain the image path
-      string imagePath = faceImagePath + "/" + items_face[j];
-      
-      // Read the image and push to the result containers
-      Mat img_original = imread(imagePath, 0);
-      Mat img_resized;
-      cv::resize(img_original, img_resized, Size(STD_FACE_REC_SIZE, STD_FACE_REC_SIZE), 1.0, 1.0, INTER_CUBIC);
-      images.push_back(img_resized);
-      labels.push_back(i);
-      names.insert( pair<int, string>(i, items_data[i]) );
-      
-      // Inform the loading state
-      cout << "\t\t- " << items_face[j] << endl;
+  // Read the paths from the list file
+  ifstream ifsList(in_images.c_str());
+  if (!ifsList.is_open()) return false;
+  string line;
+  while (getline(ifsList, line))
+  {
+    if (!line.empty() && line[line.size() - 1] == '\r') line.erase(line.size() - 1);
+    if (!line.empty()) imagePaths.push_back(line);
+  }
+  return true;
+}
+
+
+/**
+ * @param path Path to a directory.
+ * @return True if the directory exists or is created, and false 
+ *         otherwise.
+ *
+ * @brief
+ *    Create a directory together with its missing parents.
+ */
+bool makeDirectory(const string& path)
+{
+  struct stat st;
+  for (size_t pos = path.find('/', 1); ; pos = path.find('/', pos + 1))
+  {
+    string subpath = path.substr(0, pos);
+    if (mkdir(subpath.c_str(), 0777) != 0 && errno != EEXIST) return false;
+    if (pos == string::npos) break;
+  }
+  return stat(path.c_str(), &st) == 0 && S_ISDIR(st.st_mode);
+}
+
+
+/**
+ * @param imagePath Path to an input image of a batch.
+ * @param index Index of the input image in the batch.
+ * @return File name of the processed image.
+ *
+ * @brief
+ *    Obtain the file name of a processed image of a batch, prefixed 
+ *    with the index of the input image, so that the input images of 
+ *    the same name in different directories never overwrite each 
+ *    other.
+ */
+string obtainBatchImageName(const string& imagePath, int index)
+{
+  size_t pos = imagePath.find_last_of('/');
+  string basename = (pos == string::npos) ? imagePath : imagePath.substr(pos + 1);
+  return format("%06d_", index) + basename;
+}
+
+
+/**
+ * @brief
+ *   Shared state of the worker threads of a batch recognition. Each 
+ *   worker takes the next input image by an atomic increment and 
+ *   appends its result to the output file under the mutex.
+ */
+struct BatchRecognition
+{
+  const vector<string>* imagePaths;   // Paths to the input images
+  string outImageDir;                 // Directory of the output images, or empty
+  FaceRecEngine* engine;              // Face recognition engine, shared by the workers
+  int nextIndex;                      // Index of the next input image
+  pthread_mutex_t mutex;              // Mutex guarding the output below
+  ofstream* ofsInfo;                  // Output file of the results
+  int doneCount;                      // Number of input images processed
+  int failedCount;                    // Number of input images failed
+};
+
+
+/**
+ * @brief
+ *   State of a worker thread of a batch recognition.
+ */
+struct BatchRecognitionWorker
+{
+  BatchRecognition* batch;        // Shared state of the batch
+  pthread_t thread;               // Thread of the worker
+};
+
+
+/**
+ * @param arg Pointer to the BatchRecognitionWorker.
+ * @return NULL.
+ *
+ * @brief
+ *    Recognize the input images until none remains.
+ */
+void* runBatchRecognitionWorker(void* arg)
+{
+  BatchRecognitionWorker* worker = (BatchRecognitionWorker*)arg;
+  BatchRecognition* batch = worker->batch;
+  int count = (int)batch->imagePaths->size();
+
+  for (;;)
+  {
+    // Take the next input image
+    int index = CV_XADD(&batch->nextIndex, 1);
+    if (index >= count) break;
+    const string& imagePath = (*batch->imagePaths)[index];
+
+    // Recognize the faces in the image
+    string line = "{\"image\":" + quoteJSON(imagePath) + ",";
+    bool failed = false;
+    try
+    {
+      bool annotate = !batch->outImageDir.empty();
+      Mat original = imread(imagePath, obtainImageReadFlags(batch->engine->getConfig(), annotate));
+      if (original.empty())
+      {
+        line += "\"error\":\"Cannot read the input image.\"}";
+        failed = true;
+      }
+      else
+      {
+        string strFaces = recognizeImage(original, *batch->engine, annotate, false);
+        if (annotate)
+        {
+          string outImagePath = batch->outImageDir + "/" + obtainBatchImageName(imagePath, index);
+          if (!imwrite(outImagePath, original))
+          {
+            CV_Error(CV_StsError, "Cannot write the output image " + outImagePath + ".");
+          }
+          line += "\"out_image\":" + quoteJSON(outImagePath) + ",";
+        }
+        line += "\"faces\":" + strFaces + "}";
+      }
+    }
+    catch (cv::Exception& e)
+    {
+      line += "\"error\":" + quoteJSON(e.msg) + "}";
+      failed = true;
     }
+
+    // Output the result
+    pthread_mutex_lock(&batch->mutex);
+    *batch->ofsInfo << line << "\n";
+    batch->doneCount++;
+    if (failed) batch->failedCount++;
+    if (batch->doneCount % 100 == 0) cout << "[INFO] " << batch->doneCount << "/" << count << " images processed." << endl;
+    pthread_mutex_unlock(&batch->mutex);
+  }
+
+  return NULL;
+}
+
+
+/**
+ * @param fn_cascade Path to the face cascade.
+ * @param dir_data Path to the face database.
+ * @param in_images Directory of the input images, or a file listing 
+ *        the paths to the input images line by line.
+ * @param fn_outinfo Path to output the results, one JSON object per 
+ *        line and per input image.
+ * @param dir_outimages Directory to output the processed images, or 
+ *        empty if no output image is required.
+ * @param config Deployment configuration.
+ * @return An int indicating the operation state.
+ *
+ * @brief
+ *    Recognize the faces in a batch of images, with one face 
+ *    recognizer and a pool of worker threads.
+ */
+int runBatchRecognition(const string& fn_cascade, const string& dir_data, const string& in_images, const string& fn_outinfo, const string& dir_outimages, const FaceRecConfig& config)
+{
+  BatchRecognition batch;
+
+  // List the input images
+  vector<string> imagePaths;
+  if (!listBatchImages(in_images, imagePaths))
+  {
+    cerr << "[ERROR] Cannot list the input images from \"" << in_images << "\"." << endl;
+    return 1;
+  }
+  cout << "[INFO] " << imagePaths.size() << " input images to process." << endl;
+
+  // Load the face recognizer and the face detecter
+  Ptr<FaceRecEngine> engine;
+  try
+  {
+    engine = new FaceRecEngine(fn_cascade, dir_data, config);
+  }
+  catch (cv::Exception& e)
+  {
+    cerr << "[Error] Failed to load the face data. Reason: " << e.msg << endl;
+    return 1;
   }
+  batch.engine = engine;
+  cout << "[INFO] Face Haar-Like cascade trained." << endl;
+
+  // Prepare the workers
+  int numThreads = (config.batchThreads > 0) ? config.batchThreads : getNumberOfCPUs();
+  numThreads = std::max(1, std::min(numThreads, (int)imagePaths.size()));
+  vector<BatchRecognitionWorker> workers(numThreads);
+  for (int i=0; i<numThreads; ++i) workers[i].batch = &batch;
+
+  // Open the output file
+  ofstream ofsInfo(fn_outinfo.c_str());
+  if (!ofsInfo.is_open())
+  {
+    cerr << "[ERROR] Cannot open the file \"" << fn_outinfo << "\"." << endl;
+    return 1;
+  }
+  if (!dir_outimages.empty() && !makeDirectory(dir_outimages))
+  {
+    cerr << "[ERROR] Cannot create the directory \"" << dir_outimages << "\". Reason: " << strerror(errno) << endl;
+    return 1;
+  }
+
+  // Recognize the input images by the worker threads
+  batch.imagePaths = &imagePaths;
+  batch.outImageDir = dir_outimages;
+  batch.nextIndex = 0;
+  batch.ofsInfo = &ofsInfo;
+  batch.doneCount = 0;
+  batch.failedCount = 0;
+  pthread_mutex_init(&batch.mutex, NULL);
+  int64 startTick = getTickCount();
+  vector<bool> started(numThreads, false);
+  for (int i=0; i<numThreads; ++i)
+  {
+    started[i] = (pthread_create(&workers[i].thread, NULL, runBatchRecognitionWorker, &workers[i]) == 0);
+    if (!started[i]) runBatchRecognitionWorker(&workers[i]);
+  }
+  for (int i=0; i<numThreads; ++i)
+  {
+    if (started[i]) pthread_join(workers[i].thread, NULL);
+  }
+  double seconds = (double)(getTickCount() - startTick) / getTickFrequency();
+  pthread_mutex_destroy(&batch.mutex);
+  ofsInfo.close();
+
+  // Inform the batch result
+  cout << "[INFO] " << batch.doneCount << " images processed by " << numThreads << " threads in " << seconds 
+       << " s (" << batch.doneCount / std::max(seconds, 1e-9) << " images/s), " << batch.failedCount << " failed." << endl;
+  cout << "[INFO] Output the information file as \"" << fn_outinfo << "\"" << endl;
+
+  return (batch.failedCount == 0) ? 0 : 1;
 }
 
 
@@ -196,27 +980,39 @@ void loadFaceData(const string& datapath, vector<Mat>& images, vector<int>& labe
  */
 int main(int argc, const char *argv[])
 {
-  // Check for valid command line arguments
-  if (argc < 5)
+  // Check for valid command line arguments, an argument starting 
+  // with "--" always selecting a mode rather than a cascade
+  string mode = (argc > 1) ? string(argv[1]) : string("");
+  bool serveMode = (mode == "--serve" && argc == 4);
+  bool batchMode = (mode == "--batch" && (argc == 6 || argc == 7));
+  bool singleMode = (mode.compare(0, 2, "--") != 0 && argc >= 5);
+  if (!serveMode && !batchMode && !singleMode)
   {
     cout << "usage: " << argv[0] << " <cascade> <data_path> <in_image> <out_info> [<out_image>]" << endl;
-    cout << "\t <cascade>   -- Path to the Haar Cascade for face detection." << endl;
-    cout << "\t <data_path> -- Path to the face database." << endl;
-    cout << "\t <in_image>  -- Input image to process face recognition." << endl;
-    cout << "\t <out_info>  -- Output information of the face recognition result." << endl;
-    cout << "\t <out_image> -- Output image of the face recognition result. (optional)" << endl;
+    cout << "       " << argv[0] << " --serve <cascade> <data_path>" << endl;
+    cout << "       " << argv[0] << " --batch <cascade> <data_path> <in_images> <out_info> [<out_images>]" << endl;
+    cout << "\t <cascade>    -- Path to the Haar Cascade for face detection." << endl;
+    cout << "\t <data_path>  -- Path to the face database." << endl;
+    cout << "\t <in_image>   -- Input image to process face recognition." << endl;
+    cout << "\t <out_info>   -- Output information of the face recognition result." << endl;
+    cout << "\t <out_image>  -- Output image of the face recognition result. (optional)" << endl;
+    cout << "\t --serve      -- Run as the recognition server of the face database." << endl;
+    cout << "\t --batch      -- Process a batch of input images." << endl;
+    cout << "\t <in_images>  -- Directory of input images, or file listing input image paths." << endl;
+    cout << "\t <out_images> -- Directory of output images. (optional)" << endl;
     exit(1);
   }
 
   // Read the program arguments
-  string fn_cascade = string(argv[1]);
-  string dir_data = string(argv[2]);
-  string fn_inimage = string(argv[3]);
-  string fn_outinfo = string(argv[4]);
+  int argi = (serveMode || batchMode) ? 2 : 1;
+  string fn_cascade = string(argv[argi]);
+  string dir_data = string(argv[argi + 1]);
+  string fn_inimage = serveMode ? "" : string(argv[argi + 2]);
+  string fn_outinfo = serveMode ? "" : string(argv[argi + 3]);
   string fn_outimage = "";
   bool has_outimage = false;
-  if (argc > 5) {
-    fn_outimage = string(argv[5]);
+  if (argc > argi + 4) {
+    fn_outimage = string(argv[argi + 4]);
     has_outimage = true;
   }
 
@@ -228,99 +1024,68 @@ int main(int argc, const char *argv[])
     exit(1);
   }
   
-  // Load the face database
-  vector<Mat> images;
-  vector<int> labels;
-  map<int, string> names;
-  try
+  // Load the deployment configuration
+  FaceRecConfig config;
+  if (loadFaceRecConfig(dir_data, config))
   {
-    loadFaceData(dir_data, images, labels, names);
+    cout << "[INFO] Configuration loaded from \"" << dir_data << "/config.yml\"." << endl;
   }
-  catch (cv::Exception& e)
+
+  // Run as the recognition server
+  if (serveMode)
   {
-    cerr << "[Error] Failed to load the face data. Reason: " << e.msg << endl;
-    exit(1);
+    return runRecognitionServer(fn_cascade, dir_data, config);
   }
-  cout << "[INFO] Face database loaded." << endl;
-
-  // Get the standard face image size
-  int im_width = images[0].cols;
-  int im_height = images[0].rows;
-  cout << "[INFO] Standard face image size is " << im_width << "*" << im_height << endl;
-
-  // Create and train a face recognizer
-  Ptr<FaceRecognizer> model = createFisherFaceRecognizer();
-  model->train(images, labels);
-  cout << "[INFO] Face recognizer trained." << endl;
-
-  // Create and train a face detecter
-  CascadeClassifier haar_cascade;
-  haar_cascade.load(fn_cascade);
-  cout << "[INFO] Face Haar-Like cascade trained." << endl;
 
-  // Load the input image from file
-  Mat original = imread(fn_inimage);
-  cout << "[INFO] Load input image to process." << endl;
-
-  // Convert the original image to grayscale:
-  Mat gray;
-  cvtColor(original, gray, CV_BGR2GRAY);
-
-  // Find the faces from the original image
-  vector< Rect_<int> > faces;
-  haar_cascade.detectMultiScale(gray, faces);
-  cout << "[INFO] " << faces.size() << " faces detected. Faces are:" << ((faces.size())?(""):(" (NO DATA).")) << endl;
+  // Process a batch of input images
+  if (batchMode)
+  {
+    return runBatchRecognition(fn_cascade, dir_data, fn_inimage, fn_outinfo, fn_outimage, config);
+  }
 
-  // Recognize all the faces found
-  stringstream ssInfo;
-  for(int i = 0; i < faces.size(); i++)
+  // Request the recognition server if it is running, or recognize 
+  // the faces in this process
+  string strInfo;
+  string socketPath = obtainServerSocketPath(dir_data, config);
+  if (requestRecognitionServer(socketPath, fn_cascade, fn_inimage, fn_outimage, strInfo))
   {
-    // Obtain the current face to process
-    Rect face_i = faces[i];
+    cout << "[INFO] Face recognition served by \"" << socketPath << "\"." << endl;
+  }
+  else
+  {
+    // Load the cached face recognizer or train a new one, and 
+    // create and train a face detecter
+    Ptr<FaceRecEngine> engine;
+    try
+    {
+      engine = new FaceRecEngine(fn_cascade, dir_data, config);
+    }
+    catch (cv::Exception& e)
+    {
+      cerr << "[Error] Failed to load the face data. Reason: " << e.msg << endl;
+      exit(1);
+    }
+    cout << "[INFO] Standard face image size is " << STD_FACE_REC_SIZE << "*" << STD_FACE_REC_SIZE << endl;
+    cout << "[INFO] Face Haar-Like cascade trained." << endl;
 
-    // Crop the face from the image
-    Mat face = gray(face_i);
+    // Load the input image from file
+    Mat original = imread(fn_inimage, obtainImageReadFlags(config, has_outimage));
+    if (original.empty())
+    {
+      cerr << "[ERROR] Cannot read the input image \"" << fn_inimage << "\"." << endl;
+      exit(1);
+    }
+    cout << "[INFO] Load input image to process." << endl;
 
-    // Resizing the face image for recognition
-    Mat face_resized;
-    cv::resize(face, face_resized, Size(im_width, im_height), 1.0, 1.0, INTER_CUBIC);
+    // Recognize all the faces found
+    strInfo = recognizeImage(original, *engine, has_outimage, true);
 
-    // Perform the recognition prediction
-    double confidence = 0.0;
-    int prediction = -1;
-    model->predict(face_resized, prediction, confidence);
-    string strName = names[prediction];
-     
-    // Check if has output image
+    // Ouput the recognition result image
     if (has_outimage)
     {
-      // Tag the face with a rectangle
-      rectangle(original, face_i, CV_RGB(0, 255,0), 1);
-      
-      // Put the prediction information above the rectangle
-      int pos_x = std::max(face_i.tl().x - 10, 0);
-      int pos_y = std::max(face_i.tl().y - 10, 0);
-      string box_text = format("%s [%.2lf]", strName.c_str(), confidence);
-      putText(original, box_text, Point(pos_x, pos_y), FONT_HERSHEY_PLAIN, 1.0, CV_RGB(0,255,0), 2.0);
+      imwrite(fn_outimage.c_str(), original);
+      cout << "[INFO] Output the processed image as \"" << fn_outimage << "\"" << endl;
     }
-
-    // Output the recognition information
-    if (i>0) ssInfo << ",";
-    ssInfo << "{"
-           << "\"prediction\":\"" << strName << "\","
-           << "\"confidence\":" << confidence << ","
-           << "\"position\":" << "{"
-                              << "\"x\":" << face_i.tl().x << ","
-                              << "\"y\":" << face_i.tl().y
-                              << "},"
-           << "\"size\":" << "{"
-                          << "\"width\":" << face_i.size().width << ","
-                          << "\"height\":" << face_i.size().height
-                          << "}"
-           << "}";
-
-    // Inform the face recognition result
-    cout << "\t- " << strName << " [" << confidence << "]" << endl;
   }
 
   // Output the recognition result as file
@@ -328,9 +1093,7 @@ int main(int argc, const char *argv[])
   ofsInfo.open(fn_outinfo.c_str());
   if (ofsInfo.is_open())
   {
-    string strInfo;
-    ssInfo >> strInfo;
-    ofsInfo << "[" << strInfo << "]" << endl;
+    ofsInfo << strInfo << endl;
     ofsInfo.close();
     cout << "[INFO] Output the information file as \"" << fn_outinfo << "\"" << endl;
   }
@@ -340,13 +1103,5 @@ int main(int argc, const char *argv[])
     exit(1);
   }
 
-  // Ouput the recognition result image
-  if (has_outimage)
-  {
-    imwrite(fn_outimage.c_str(), original);
-    cout << "[INFO] Output the processed image as \"" << fn_outimage << "\"" << endl;
-  }
-
   return 0;
 }
-
@@ -0,0 +1,263 @@
+/**
+ * Cascade code generator. This build tool turns Haar cascades in the
+ * old format into the C++ source of the compiled cascades linked
+ * into the "facerec" library, with the features in constant tables
+ * and the evaluation unrolled stage by stage and stump by stump.
+ *
+ * It is run by the build for the cascades bundled in "release/",
+ * and the source generated must not be edited.
+ *
+ * Author:  David Qiu.
+ * Email:   david@davidqiu.com
+ * Email:   dicong.qiu@intel.com
+ * Website: http://www.davidqiu.com/
+ *
+ * Copyright (C) 2014, David Qiu. All rights reserved.
+ */
+
+#include "opencv2/core/core.hpp"
+#include "opencv2/objdetect/objdetect.hpp"
+
+#include "CompiledCascade.hpp"
+#include "FaceCascade.hpp"
+
+#include <iostream>
+#include <fstream>
+#include <sstream>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <cfloat>
+#include <cmath>
+using namespace cv;
+using namespace std;
+
+
+/**
+ * @brief
+ *   The generator itself is built before any cascade is compiled.
+ */
+const CompiledCascade* const COMPILED_CASCADES[] = { NULL };
+const int COMPILED_CASCADE_COUNT = 0;
+
+
+/**
+ * @param value A float value.
+ * @return C++ float literal of exactly the value.
+ */
+string formatFloat(float value)
+{
+  char buffer[64];
+  snprintf(buffer, sizeof(buffer), "%.9g", value);
+  string literal(buffer);
+  if (literal.find_first_of(".e") == string::npos) literal += ".0";
+  return literal + "f";
+}
+
+
+/**
+ * @param path Path to a file.
+ * @return Name of the file without the directory.
+ */
+string obtainFileName(const string& path)
+{
+  size_t pos = path.find_last_of('/');
+  return (pos == string::npos) ? path : path.substr(pos + 1);
+}
+
+
+/**
+ * @param feature Haar feature of the cascade.
+ * @return True if the third rectangle of the feature is used, as the
+ *         generic face detecter decides it.
+ */
+bool hasThirdRect(const CvHaarFeature& feature)
+{
+  return !(fabs(feature.rect[2].weight) < DBL_EPSILON || feature.rect[2].r.width == 0 || feature.rect[2].r.height == 0);
+}
+
+
+/**
+ * @param stage Stage of the cascade.
+ * @return True if all the features of the stage have two rectangles, 
+ *         which the generic face detecter sums in single precision.
+ */
+bool isTwoRectStage(const CvHaarStageClassifier& stage)
+{
+  for (int j=0; j<stage.count; ++j)
+  {
+    if (hasThirdRect(stage.classifier[j].haar_feature[0])) return false;
+  }
+  return true;
+}
+
+
+/**
+ * @param out Stream of the generated source.
+ * @param cascade Cascade in the old Haar format.
+ * @param index Index of the cascade in the generated source.
+ * @param name Name of the cascade file.
+ *
+ * @brief
+ *    Generate the feature tables, the unrolled evaluation and the
+ *    description of a compiled cascade.
+ */
+void generateCascade(ostream& out, const CvHaarClassifierCascade* cascade, int index, const string& name)
+{
+  int featureCount = 0;
+  for (int i=0; i<cascade->count; ++i) featureCount += cascade->stage_classifier[i].count;
+
+  // Feature table, in the order of evaluation
+  out << "// " << name << endl;
+  out << "static const CompiledHaarFeature FEATURES_" << index << "[" << featureCount << "] = {" << endl;
+  for (int i=0; i<cascade->count; ++i)
+  {
+    const CvHaarStageClassifier& stage = cascade->stage_classifier[i];
+    for (int j=0; j<stage.count; ++j)
+    {
+      const CvHaarFeature& feature = stage.classifier[j].haar_feature[0];
+      out << "  {{";
+      for (int k=0; k<3; ++k)
+      {
+        bool used = (k < 2 || hasThirdRect(feature));
+        const CvRect& r = feature.rect[k].r;
+        if (k > 0) out << ", ";
+        if (used) out << "{" << r.x << ", " << r.y << ", " << r.width << ", " << r.height << ", " << formatFloat(feature.rect[k].weight) << "}";
+        else out << "{0, 0, 0, 0, 0.0f}";
+      }
+      out << "}}," << endl;
+    }
+  }
+  out << "};" << endl << endl;
+
+  // Stump and stage tables, for the evaluation of several windows at 
+  // once by the SIMD kernels
+  out << "static const CompiledHaarStump STUMPS_" << index << "[" << featureCount << "] = {" << endl;
+  for (int i=0; i<cascade->count; ++i)
+  {
+    const CvHaarStageClassifier& stage = cascade->stage_classifier[i];
+    bool twoRects = isTwoRectStage(stage);
+    for (int j=0; j<stage.count; ++j)
+    {
+      const CvHaarClassifier& classifier = stage.classifier[j];
+      const char* kind = twoRects ? "COMPILED_STUMP_F2" :
+                         (hasThirdRect(classifier.haar_feature[0]) ? "COMPILED_STUMP_D3" : "COMPILED_STUMP_D2");
+      out << "  {" << formatFloat(classifier.threshold[0]) << ", " << formatFloat(classifier.alpha[0]) << ", " 
+          << formatFloat(classifier.alpha[1]) << ", " << kind << "}," << endl;
+    }
+  }
+  out << "};" << endl << endl;
+  out << "static const CompiledHaarStage STAGES_" << index << "[" << cascade->count << "] = {" << endl;
+  for (int i=0; i<cascade->count; ++i)
+  {
+    const CvHaarStageClassifier& stage = cascade->stage_classifier[i];
+    float threshold = stage.threshold - COMPILED_STAGE_THRESHOLD_BIAS;
+    out << "  {" << stage.count << ", " << formatFloat(threshold) << "}," << endl;
+  }
+  out << "};" << endl << endl;
+
+  // Unrolled evaluation, with the thresholds and the leaf values as
+  // constants and the features at fixed offsets into the tables of
+  // the current scale
+  out << "static int evaluateCascade" << index << "(const int* p, const int* o, const float* w, double nf)" << endl;
+  out << "{" << endl;
+  out << "  double stage_sum;" << endl;
+  int f = 0;
+  for (int i=0; i<cascade->count; ++i)
+  {
+    const CvHaarStageClassifier& stage = cascade->stage_classifier[i];
+    bool twoRects = isTwoRectStage(stage);
+
+    out << endl << "  // Stage " << i << endl;
+    out << "  stage_sum = 0.0;" << endl;
+    for (int j=0; j<stage.count; ++j, ++f)
+    {
+      const CvHaarClassifier& classifier = stage.classifier[j];
+      const char* stump = twoRects ? "evaluateCompiledStumpF2" :
+                          (hasThirdRect(classifier.haar_feature[0]) ? "evaluateCompiledStumpD3" : "evaluateCompiledStumpD2");
+      out << "  stage_sum += " << stump << "(p, o + " << f * COMPILED_FEATURE_OFFSETS << ", w + " << f * COMPILED_FEATURE_WEIGHTS
+          << ", nf, " << formatFloat(classifier.threshold[0]) << ", " << formatFloat(classifier.alpha[0])
+          << ", " << formatFloat(classifier.alpha[1]) << ");" << endl;
+    }
+    float threshold = stage.threshold - COMPILED_STAGE_THRESHOLD_BIAS;
+    out << "  if (stage_sum < " << formatFloat(threshold) << ") return " << -i << ";" << endl;
+  }
+  out << endl << "  return 1;" << endl;
+  out << "}" << endl << endl;
+
+  // Description of the compiled cascade
+  char hash[32];
+  snprintf(hash, sizeof(hash), "0x%016llxULL", (unsigned long long)hashHaarCascade(cascade));
+  out << "static const CompiledCascade CASCADE_" << index << " = {" << endl;
+  out << "  \"" << name << "\", " << hash << ", " << cascade->orig_window_size.width << ", "
+      << cascade->orig_window_size.height << ", " << featureCount << ", FEATURES_" << index
+      << ", STUMPS_" << index << ", " << cascade->count << ", STAGES_" << index
+      << ", evaluateCascade" << index << endl;
+  out << "};" << endl << endl << endl;
+}
+
+
+/**
+ * @brief
+ *    Program entry of the application.
+ */
+int main(int argc, const char *argv[])
+{
+  // Check the arguments
+  if (argc < 2)
+  {
+    cout << "usage: " << argv[0] << " <out_source> [<cascade>...]" << endl;
+    cout << "\t <out_source> -- Path to the C++ source to generate." << endl;
+    cout << "\t <cascade> -- Path to a Haar cascade in the old format to compile." << endl;
+    exit(1);
+  }
+
+  // Get the arguments
+  string fn_source = string(argv[1]);
+
+  // Generate the compiled cascades
+  stringstream out;
+  out << "/**" << endl;
+  out << " * Compiled cascades. Generated by \"tools/CascadeCodegen.cpp\" at " << endl;
+  out << " * build time. Do not edit." << endl;
+  out << " */" << endl << endl;
+  out << "#include \"CompiledCascade.hpp\"" << endl << endl << endl;
+  vector<int> indices;
+  for (int a=2; a<argc; ++a)
+  {
+    string fn_cascade = string(argv[a]);
+    FaceCascade cascade;
+    if (!cascade.loadXML(fn_cascade) || cascade.getHaarCascade() == NULL)
+    {
+      cerr << "[ERROR] Cannot load the cascade \"" << fn_cascade << "\" in the old Haar format." << endl;
+      return 1;
+    }
+    if (!isCompilableHaarCascade(cascade.getHaarCascade()))
+    {
+      cerr << "[ERROR] Cannot compile the cascade \"" << fn_cascade << "\", only stumps on upright features in a sequence of stages are supported." << endl;
+      return 1;
+    }
+    generateCascade(out, cascade.getHaarCascade(), a - 2, obtainFileName(fn_cascade));
+    indices.push_back(a - 2);
+    cout << "[INFO] Cascade \"" << fn_cascade << "\" compiled." << endl;
+  }
+
+  // Register the compiled cascades
+  out << "const CompiledCascade* const COMPILED_CASCADES[] = {" << endl;
+  for (int i=0; i<indices.size(); ++i) out << "  &CASCADE_" << indices[i] << "," << endl;
+  if (indices.empty()) out << "  NULL" << endl;
+  out << "};" << endl << endl;
+  out << "const int COMPILED_CASCADE_COUNT = " << indices.size() << ";" << endl;
+
+  // Write the generated source
+  ofstream file(fn_source.c_str());
+  file << out.str();
+  file.close();
+  if (!file)
+  {
+    cerr << "[ERROR] Cannot write the source \"" << fn_source << "\"." << endl;
+    return 1;
+  }
+
+  return 0;
+}